@@ -0,0 +1,26 @@
+#include "ProcessMemory.h"
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+qint64 ProcessMemory::peakRss() {
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return -1;
+    return qint64(pmc.PeakWorkingSetSize);
+#elif defined(Q_OS_UNIX)
+    rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return -1;
+#if defined(Q_OS_DARWIN)
+    return qint64(ru.ru_maxrss);          // bytes
+#else
+    return qint64(ru.ru_maxrss) * 1024;   // KiB
+#endif
+#else
+    return -1;
+#endif
+}
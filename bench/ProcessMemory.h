@@ -0,0 +1,11 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Resident memory of the current process, in bytes; -1 where the platform
+// does not report it.
+class ProcessMemory {
+public:
+    // High-water mark since the process started.
+    static qint64 peakRss();
+};
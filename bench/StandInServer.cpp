@@ -0,0 +1,255 @@
+#include "StandInServer.h"
+
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPointer>
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QXmlStreamReader>
+#include <QtNetwork/QTcpSocket>
+#include <memory>
+
+StandInServer::StandInServer(QObject *parent)
+    : QTcpServer(parent)
+{
+}
+
+bool StandInServer::start() {
+    return listen(QHostAddress::LocalHost);
+}
+
+QString StandInServer::baseUrl() const {
+    return QStringLiteral("http://127.0.0.1:%1").arg(serverPort());
+}
+
+void StandInServer::addFile(const QString &name, const QByteArray &bytes, const QString &mime) {
+    _files.insert(name, { bytes, mime.toLatin1() });
+}
+
+void StandInServer::setFaults(const Faults &faults) {
+    _faults = faults;
+    _random.seed(faults.seed);
+}
+
+void StandInServer::incomingConnection(qintptr socketDescriptor) {
+    auto *socket = new QTcpSocket(this);
+    socket->setSocketDescriptor(socketDescriptor);
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { readFrom(socket); });
+    connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+        _connections.remove(socket);
+        socket->deleteLater();
+    });
+}
+
+void StandInServer::readFrom(QTcpSocket *socket) {
+    Connection &c = _connections[socket];
+    const QByteArray data = socket->readAll();
+    _stats.bytesIn += data.size();
+    c.buffer += data;
+
+    // Several requests can arrive back to back on a kept-alive connection
+    for (;;) {
+        if (c.bodyLeft < 0) {
+            const qsizetype headerEnd = c.buffer.indexOf("\r\n\r\n");
+            if (headerEnd < 0) return;
+
+            const QList<QByteArray> lines = c.buffer.left(headerEnd).split('\n');
+            const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+            if (requestLine.size() < 2) {
+                socket->disconnectFromHost();
+                return;
+            }
+            c.request = Request();
+            c.request.method = requestLine[0];
+            c.request.path = requestLine[1];
+            c.bodyLeft = 0;
+            for (qsizetype i = 1; i < lines.size(); ++i) {
+                const qsizetype colon = lines[i].indexOf(':');
+                if (colon > 0 && lines[i].left(colon).trimmed().toLower() == "content-length")
+                    c.bodyLeft = lines[i].mid(colon + 1).trimmed().toLongLong();
+            }
+            c.request.length = c.bodyLeft;
+            // Upload bodies are only counted; the part list of a
+            // multipart completion is small and needed
+            c.keepBody = !c.request.path.startsWith("/upload")
+                      || (c.request.method == "POST" && c.request.path.contains("uploadId="));
+            c.buffer.remove(0, headerEnd + 4);
+        }
+
+        const qsizetype n = qMin<qint64>(c.bodyLeft, c.buffer.size());
+        if (c.keepBody)
+            c.request.body += c.buffer.left(n);
+        c.buffer.remove(0, n);
+        c.bodyLeft -= n;
+        if (c.bodyLeft > 0) return;
+
+        c.bodyLeft = -1;
+        ++_stats.requests;
+        handle(socket, c.request);
+    }
+}
+
+void StandInServer::handle(QTcpSocket *socket, const Request &req) {
+    if (req.path.startsWith("/upload") && (_faults.errorRate > 0 || _faults.dropRate > 0)) {
+        const double roll = _random.generateDouble();
+        if (roll < _faults.dropRate) {
+            ++_stats.faults;
+            // Later: readFrom() is still using this connection's state
+            QMetaObject::invokeMethod(socket, &QTcpSocket::abort, Qt::QueuedConnection);
+            return;
+        }
+        if (roll < _faults.dropRate + _faults.errorRate) {
+            ++_stats.faults;
+            respond(socket, 503, "text/plain", "injected fault", "Retry-After: 0\r\n");
+            return;
+        }
+    }
+
+    if (req.method == "GET" && req.path.startsWith("/sts")) {
+        QJsonObject data;
+        data["accessKeyId"] = "STS.standin";
+        data["accessKeySecret"] = "standin-secret";
+        data["securityToken"] = "standin-token";
+        data["expiration"] = QDateTime::currentDateTimeUtc().addSecs(3600).toString(Qt::ISODate);
+        QJsonObject root;
+        root["data"] = data;
+        respond(socket, 200, "application/json", QJsonDocument(root).toJson(QJsonDocument::Compact));
+    } else if (req.path.startsWith("/upload/")) {
+        handleObject(socket, req);
+    } else if (req.method == "POST" && req.path.startsWith("/upload")) {
+        respond(socket, 200, "text/plain", QByteArray());
+    } else if (req.method == "GET" && req.path.startsWith("/img/")) {
+        // Ignore the query; callers vary it to defeat client caches
+        QByteArray name = req.path.mid(5);
+        const qsizetype q = name.indexOf('?');
+        if (q >= 0) name.truncate(q);
+        const auto it = _files.constFind(QString::fromUtf8(name));
+        if (it == _files.constEnd())
+            respond(socket, 404, "text/plain", "not found");
+        else if (_fileRate > 0)
+            respondSlowly(socket, it->mime, it->bytes);
+        else
+            respond(socket, 200, it->mime, it->bytes);
+    } else {
+        respond(socket, 404, "text/plain", "not found");
+    }
+}
+
+// Signatures are not checked; the stand-in only follows the protocol.
+void StandInServer::handleObject(QTcpSocket *socket, const Request &req) {
+    const QUrl url(QString::fromUtf8("http://localhost" + req.path));
+    const QString object = url.path().mid(8);  // after "/upload/"
+    const QUrlQuery query(url);
+    const QString uploadId = query.queryItemValue("uploadId");
+    static const QByteArray NoSuchUpload = "<Error><Code>NoSuchUpload</Code></Error>";
+
+    if (req.method == "PUT" && query.isEmpty()) {
+        _objects.insert(object, req.length);
+        respond(socket, 200, "text/plain", QByteArray(),
+                "ETag: \"" + QByteArray::number(qHash(object), 16) + "\"\r\n");
+        return;
+    }
+
+    if (req.method == "POST" && query.hasQueryItem("uploads")) {
+        const QString id = QString("standin-%1").arg(_nextUploadId++);
+        _multiparts.insert(id, { object, {} });
+        respond(socket, 200, "application/xml",
+                "<InitiateMultipartUploadResult><Key>" + object.toUtf8() + "</Key><UploadId>"
+                + id.toUtf8() + "</UploadId></InitiateMultipartUploadResult>");
+        return;
+    }
+    const auto it = _multiparts.find(uploadId);
+    if (it == _multiparts.end() || it->object != object) {
+        respond(socket, 404, "application/xml", NoSuchUpload);
+        return;
+    }
+    if (req.method == "PUT") {
+        const int part = query.queryItemValue("partNumber").toInt();
+        const QByteArray etag = "\"" + QByteArray::number(qHash(uploadId) ^ part, 16)
+                              + "-" + QByteArray::number(req.length) + "\"";
+        it->parts.insert(part, { etag, req.length });
+        ++_stats.parts;
+        respond(socket, 200, "text/plain", QByteArray(), "ETag: " + etag + "\r\n");
+        return;
+    }
+    if (req.method == "POST") {
+        // Every listed part must be one that arrived, with its ETag
+        qint64 size = 0;
+        int listed = 0;
+        bool valid = true;
+        QXmlStreamReader xml(req.body);
+        int part = 0;
+        while (!xml.atEnd()) {
+            if (xml.readNext() != QXmlStreamReader::StartElement) continue;
+            if (xml.name() == u"PartNumber") {
+                part = xml.readElementText().toInt();
+            } else if (xml.name() == u"ETag") {
+                const auto p = it->parts.constFind(part);
+                valid = valid && p != it->parts.constEnd() && p->first == xml.readElementText().toUtf8();
+                if (valid) size += p->second;
+                ++listed;
+            }
+        }
+        if (!valid || listed != it->parts.size()) {
+            respond(socket, 400, "application/xml", "<Error><Code>InvalidPart</Code></Error>");
+            return;
+        }
+        _objects.insert(object, size);
+        _multiparts.erase(it);
+        respond(socket, 200, "application/xml", "<CompleteMultipartUploadResult/>");
+        return;
+    }
+    respond(socket, 404, "text/plain", "not found");
+}
+
+void StandInServer::respond(QTcpSocket *socket, int status, const QByteArray &type, const QByteArray &body,
+                            const QByteArray &headers) {
+    QByteArray out = "HTTP/1.1 " + QByteArray::number(status)
+                   + (status == 200 ? " OK" : " Error") + "\r\n"
+                   + "Content-Type: " + type + "\r\n"
+                   + headers
+                   + "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                   + "Cache-Control: no-store\r\n"
+                   + "Connection: keep-alive\r\n\r\n";
+    out += body;
+
+    auto send = [this, socket = QPointer<QTcpSocket>(socket), out]() {
+        if (!socket) return;
+        _stats.bytesOut += out.size();
+        socket->write(out);
+    };
+    if (_latencyMs > 0)
+        QTimer::singleShot(_latencyMs, this, send);
+    else
+        send();
+}
+
+// The headers after the latency like any response, then the body in slices
+// every 10 ms.
+void StandInServer::respondSlowly(QTcpSocket *socket, const QByteArray &type, const QByteArray &body) {
+    const QByteArray head = "HTTP/1.1 200 OK\r\n"
+                            "Content-Type: " + type + "\r\n"
+                            "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                            "Cache-Control: no-store\r\n"
+                            "Connection: keep-alive\r\n\r\n";
+    const qint64 slice = qMax<qint64>(1, _fileRate / 100);
+    auto *timer = new QTimer(socket);
+    auto sent = std::make_shared<qint64>(0);
+    connect(timer, &QTimer::timeout, this, [this, socket, timer, body, slice, sent]() {
+        const QByteArray chunk = body.mid(*sent, slice);
+        *sent += chunk.size();
+        _stats.bytesOut += chunk.size();
+        socket->write(chunk);
+        if (*sent >= body.size()) {
+            timer->stop();
+            timer->deleteLater();
+        }
+    });
+    QTimer::singleShot(_latencyMs, timer, [this, socket, timer, head]() {
+        _stats.bytesOut += head.size();
+        socket->write(head);
+        timer->start(10);
+    });
+}
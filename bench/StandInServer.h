@@ -0,0 +1,113 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+#include <QObject>
+#include <QRandomGenerator>
+#include <QString>
+#include <QtNetwork/QTcpServer>
+
+class QTcpSocket;
+
+// A minimal HTTP/1.1 server on localhost that stands in for the STS
+// endpoint, the OSS bucket and remote image hosts, so the network stages
+// can be measured without the real services:
+//
+//   GET  /sts         STS credentials in the shape StsCache expects
+//   POST /upload      accepts an OSS form upload, discarding the body as it
+//                     arrives so the server adds nothing to peak memory
+//   /upload/<object>  a whole object in one PUT, or the OSS multipart API:
+//                     POST ?uploads, PUT ?partNumber=&uploadId= (bodies
+//                     discarded the same way) and POST ?uploadId= with the
+//                     part list
+//   GET  /img/<name>  bytes registered with addFile()
+//
+// Connections are kept alive; every response can be delayed by a fixed
+// latency to model the round trip, and files can be sent at a limited rate
+// per connection to model a slow image host. Upload requests can be made to fail at
+// random, with a 503 or by closing the connection without an answer.
+class StandInServer : public QTcpServer {
+    Q_OBJECT
+public:
+    struct Stats {
+        int    requests = 0;
+        qint64 bytesIn = 0;
+        qint64 bytesOut = 0;
+        int    parts = 0;    // multipart parts accepted
+        int    faults = 0;   // requests failed on purpose
+    };
+
+    // Shares of upload requests answered with 503 and dropped; the same
+    // seed fails the same requests.
+    struct Faults {
+        double  errorRate = 0;
+        double  dropRate = 0;
+        quint32 seed = 1;
+    };
+
+    explicit StandInServer(QObject *parent = nullptr);
+
+    bool start();
+    QString baseUrl() const;
+
+    void setLatencyMs(int ms) { _latencyMs = ms; }
+    // Bytes per second of each /img/ response body; 0 sends it at once.
+    void setFileRate(qint64 bytesPerSec) { _fileRate = bytesPerSec; }
+    void addFile(const QString &name, const QByteArray &bytes, const QString &mime);
+    void setFaults(const Faults &faults);
+
+    // Size of an object that was PUT or put together by a multipart upload,
+    // -1 if none.
+    qint64 objectSize(const QString &object) const { return _objects.value(object, -1); }
+
+    const Stats &stats() const { return _stats; }
+    void resetStats() { _stats = Stats(); }
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    struct Request {
+        QByteArray method;
+        QByteArray path;
+        QByteArray body;
+        qint64     length = 0;
+    };
+
+    // Parse state of one kept-alive connection
+    struct Connection {
+        QByteArray buffer;
+        Request    request;
+        qint64     bodyLeft = -1;  // -1 while reading headers
+        bool       keepBody = true;
+    };
+
+    struct File {
+        QByteArray bytes;
+        QByteArray mime;
+    };
+
+    struct Multipart {
+        QString object;
+        QMap<int, QPair<QByteArray, qint64>> parts;  // ETag and size
+    };
+
+    void readFrom(QTcpSocket *socket);
+    void handle(QTcpSocket *socket, const Request &req);
+    void handleObject(QTcpSocket *socket, const Request &req);
+    void respond(QTcpSocket *socket, int status, const QByteArray &type, const QByteArray &body,
+                 const QByteArray &headers = QByteArray());
+    void respondSlowly(QTcpSocket *socket, const QByteArray &type, const QByteArray &body);
+
+    QHash<QTcpSocket *, Connection> _connections;
+    QHash<QString, File>            _files;
+    QHash<QString, Multipart>       _multiparts;  // by upload ID
+    QHash<QString, qint64>          _objects;
+    Faults           _faults;
+    QRandomGenerator _random;
+    Stats _stats;
+    int   _latencyMs = 0;
+    qint64 _fileRate = 0;
+    int   _nextUploadId = 1;
+};
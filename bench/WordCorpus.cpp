@@ -0,0 +1,237 @@
+#include "WordCorpus.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QUrl>
+#include <iterator>
+
+static const char *const Words[] = {
+    "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+    "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore",
+    "magna", "aliqua", "enim", "ad", "minim", "veniam", "quis", "nostrud",
+};
+
+static QString sentence(QRandomGenerator &rng, int words) {
+    QString s;
+    for (int i = 0; i < words; ++i) {
+        if (i) s += u' ';
+        s += QLatin1String(Words[rng.bounded(int(std::size(Words)))]);
+    }
+    s[0] = s[0].toUpper();
+    return s + u'.';
+}
+
+static QString head() {
+    return QStringLiteral(
+        "<html xmlns:v=\"urn:schemas-microsoft-com:vml\"\n"
+        "xmlns:o=\"urn:schemas-microsoft-com:office:office\"\n"
+        "xmlns:w=\"urn:schemas-microsoft-com:office:word\"\n"
+        "xmlns:m=\"http://schemas.microsoft.com/office/2004/12/omml\"\n"
+        "xmlns=\"http://www.w3.org/TR/REC-html40\">\n"
+        "<head>\n"
+        "<meta http-equiv=Content-Type content=\"text/html; charset=utf-8\">\n"
+        "<meta name=ProgId content=Word.Document>\n"
+        "<meta name=Generator content=\"Microsoft Word 15\">\n"
+        "<meta name=Originator content=\"Microsoft Word 15\">\n"
+        "<link rel=File-List href=\"file:///C:/Users/user/AppData/Local/Temp/msohtmlclip1/01/clip_filelist.xml\">\n"
+        "<!--[if gte mso 9]><xml>\n"
+        " <o:OfficeDocumentSettings>\n"
+        "  <o:AllowPNG/>\n"
+        " </o:OfficeDocumentSettings>\n"
+        "</xml><![endif]-->\n"
+        "<!--[if gte mso 9]><xml>\n"
+        " <w:WordDocument>\n"
+        "  <w:View>Normal</w:View>\n"
+        "  <w:Zoom>0</w:Zoom>\n"
+        "  <w:TrackMoves/>\n"
+        "  <w:TrackFormatting/>\n"
+        "  <w:PunctuationKerning/>\n"
+        "  <w:ValidateAgainstSchemas/>\n"
+        "  <w:BrowserLevel>MicrosoftInternetExplorer4</w:BrowserLevel>\n"
+        " </w:WordDocument>\n"
+        "</xml><![endif]-->\n"
+        "<style>\n"
+        "<!--\n"
+        " /* Font Definitions */\n"
+        " @font-face\n"
+        "\t{font-family:\"Cambria Math\";\n"
+        "\tpanose-1:2 4 5 3 5 4 6 3 2 4;\n"
+        "\tmso-font-charset:0;\n"
+        "\tmso-generic-font-family:roman;\n"
+        "\tmso-font-pitch:variable;\n"
+        "\tmso-font-signature:-536869121 1107305727 33554432 0 415 0;}\n"
+        " /* Style Definitions */\n"
+        " p.MsoNormal, li.MsoNormal, div.MsoNormal\n"
+        "\t{mso-style-unhide:no;\n"
+        "\tmso-style-qformat:yes;\n"
+        "\tmso-style-parent:\"\";\n"
+        "\tmargin:0in;\n"
+        "\tmso-pagination:widow-orphan;\n"
+        "\tfont-size:12.0pt;\n"
+        "\tfont-family:\"Calibri\",sans-serif;\n"
+        "\tmso-fareast-font-family:\"Times New Roman\";}\n"
+        "h2\n"
+        "\t{mso-style-priority:9;\n"
+        "\tmso-style-link:\"Heading 2 Char\";\n"
+        "\tmso-margin-top-alt:auto;\n"
+        "\tmso-outline-level:2;\n"
+        "\tfont-size:18.0pt;\n"
+        "\tfont-weight:bold;}\n"
+        ".MsoChpDefault\n"
+        "\t{mso-style-type:export-only;\n"
+        "\tmso-default-props:yes;}\n"
+        "@page WordSection1\n"
+        "\t{size:8.5in 11.0in;\n"
+        "\tmargin:1.0in 1.0in 1.0in 1.0in;\n"
+        "\tmso-header-margin:.5in;\n"
+        "\tmso-footer-margin:.5in;\n"
+        "\tmso-paper-source:0;}\n"
+        "div.WordSection1\n"
+        "\t{page:WordSection1;}\n"
+        "-->\n"
+        "</style>\n"
+        "<!--[if gte mso 10]>\n"
+        "<style>\n"
+        " /* Style Definitions */\n"
+        " table.MsoNormalTable\n"
+        "\t{mso-style-name:\"Table Normal\";\n"
+        "\tmso-tstyle-rowband-size:0;\n"
+        "\tmso-style-noshow:yes;}\n"
+        "</style>\n"
+        "<![endif]-->\n"
+        "</head>\n\n"
+        "<body lang=EN-US style='tab-interval:.5in;word-wrap:break-word'>\n"
+        "<!--StartFragment-->\n");
+}
+
+static QString paragraph(QRandomGenerator &rng) {
+    QString p = QStringLiteral("<p class=MsoNormal><span lang=EN-US style='mso-bidi-font-family:"
+                               "Calibri;mso-bidi-theme-font:minor-latin'>");
+    const int sentences = 2 + rng.bounded(4);
+    for (int i = 0; i < sentences; ++i) {
+        if (i) p += u' ';
+        QString s = sentence(rng, 6 + rng.bounded(10));
+        if (rng.bounded(4) == 0)
+            s = QStringLiteral("<b style='mso-bidi-font-weight:normal'>") + s + QStringLiteral("</b>");
+        p += s;
+    }
+    p += QStringLiteral("<o:p></o:p></span></p>\n");
+    return p;
+}
+
+static QString table(QRandomGenerator &rng) {
+    QString t = QStringLiteral(
+        "<table class=MsoTableGrid border=1 cellspacing=0 cellpadding=0\n"
+        " style='border-collapse:collapse;border:none;mso-border-alt:solid windowtext .5pt;\n"
+        " mso-yfti-tbllook:1184;mso-padding-alt:0in 5.4pt 0in 5.4pt'>\n");
+    for (int r = 0; r < 3; ++r) {
+        t += QStringLiteral(" <tr style='mso-yfti-irow:%1'>\n").arg(r);
+        for (int c = 0; c < 3; ++c) {
+            t += QStringLiteral("  <td width=208 valign=top style='width:155.8pt;border:solid "
+                                "windowtext 1.0pt;mso-border-alt:solid windowtext .5pt;padding:0in "
+                                "5.4pt 0in 5.4pt'>\n  <p class=MsoNormal><span lang=EN-US>%1<o:p>"
+                                "</o:p></span></p>\n  </td>\n").arg(sentence(rng, 2 + rng.bounded(3)));
+        }
+        t += QStringLiteral(" </tr>\n");
+    }
+    return t + QStringLiteral("</table>\n");
+}
+
+static QString picture(int index, const QString &src, const QSize &size) {
+    const int w = size.width();
+    const int h = size.height();
+    const QString id = QStringLiteral("Picture_x0020_%1").arg(index + 1);
+    return QStringLiteral(
+        "<p class=MsoNormal><span lang=EN-US style='mso-no-proof:yes'><!--[if gte vml 1]><v:shape\n"
+        " id=\"%1\" o:spid=\"_x0000_i%2\" type=\"#_x0000_t75\" style='width:%3pt;\n"
+        " height:%4pt;visibility:visible;mso-wrap-style:square'>\n"
+        " <v:imagedata src=\"%5\" o:title=\"\"/>\n"
+        "</v:shape><![endif]--><![if !vml]><img width=%6 height=%7\n"
+        "src=\"%5\" v:shapes=\"%1\"><![endif]></span><span lang=EN-US><o:p></o:p></span></p>\n")
+        .arg(id).arg(1025 + index).arg(w * 3 / 4).arg(h * 3 / 4).arg(src).arg(w).arg(h);
+}
+
+WordCorpus::Image WordCorpus::image(int index, quint32 seed) {
+    QRandomGenerator rng(seed * 7919u + quint32(index));
+
+    // Mostly small screenshots, occasionally a large photo
+    static const QSize Sizes[] = { { 96, 72 }, { 320, 240 }, { 640, 480 }, { 1280, 960 } };
+    const int r = rng.bounded(10);
+    const QSize size = Sizes[r < 3 ? 0 : r < 7 ? 1 : r < 9 ? 2 : 3];
+    const bool photo = rng.bounded(3) == 0;
+
+    QImage img(size, QImage::Format_RGB32);
+    const QRgb a = rng.generate() | 0xff000000u;
+    const QRgb b = rng.generate() | 0xff000000u;
+    for (int y = 0; y < size.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(img.scanLine(y));
+        const int t = y * 255 / size.height();
+        const QRgb base = qRgb((qRed(a) * (255 - t) + qRed(b) * t) / 255,
+                               (qGreen(a) * (255 - t) + qGreen(b) * t) / 255,
+                               (qBlue(a) * (255 - t) + qBlue(b) * t) / 255);
+        for (int x = 0; x < size.width(); ++x) {
+            if (!photo) { line[x] = base; continue; }
+            const int n = int(rng.bounded(32)) - 16;
+            line[x] = qRgb(qBound(0, qRed(base) + n, 255), qBound(0, qGreen(base) + n, 255),
+                           qBound(0, qBlue(base) + n, 255));
+        }
+    }
+    QPainter p(&img);
+    for (int i = 0, n = 4 + rng.bounded(12); i < n; ++i) {
+        p.setBrush(QColor::fromRgb(rng.generate() | 0xff000000u));
+        const QRect rect(rng.bounded(size.width()), rng.bounded(size.height()),
+                         8 + rng.bounded(size.width() / 2), 8 + rng.bounded(size.height() / 2));
+        if (i % 2) p.drawEllipse(rect);
+        else p.drawRect(rect);
+    }
+    p.end();
+
+    Image out;
+    out.size = size;
+    const char *format = photo ? "JPEG" : "PNG";
+    out.name = QStringLiteral("clip_image%1.%2").arg(index + 1, 3, 10, QChar('0'))
+                                               .arg(photo ? "jpg" : "png");
+    out.mime = photo ? QStringLiteral("image/jpeg") : QStringLiteral("image/png");
+    QBuffer buf(&out.bytes);
+    buf.open(QIODevice::WriteOnly);
+    img.save(&buf, format, photo ? 85 : -1);
+    return out;
+}
+
+WordCorpus::Corpus WordCorpus::generate(const Options &opt) {
+    QRandomGenerator rng(opt.seed);
+    Corpus c;
+    c.html = head();
+    c.html += QStringLiteral("<div class=WordSection1>\n");
+    c.html += QStringLiteral("<h2><span lang=EN-US>%1<o:p></o:p></span></h2>\n").arg(sentence(rng, 4));
+
+    const QDir dir(opt.imageDir);
+    for (int i = 0; i < opt.images; ++i) {
+        for (int k = 0; k < opt.paragraphsPerImage; ++k)
+            c.html += paragraph(rng);
+        if (i % 10 == 9)
+            c.html += table(rng);
+
+        Image img = image(i, opt.seed);
+        QString src;
+        if (!opt.remoteBase.isEmpty()) {
+            src = QStringLiteral("%1/img/%2").arg(opt.remoteBase, img.name);
+        } else {
+            const QString path = dir.filePath(img.name);
+            QFile f(path);
+            if (f.open(QIODevice::WriteOnly))
+                f.write(img.bytes);
+            src = QUrl::fromLocalFile(path).toString();
+        }
+        c.html += picture(i, src, img.size);
+        c.imageBytes += img.bytes.size();
+        c.images << std::move(img);
+    }
+    c.html += paragraph(rng);
+    c.html += QStringLiteral("</div>\n<!--EndFragment-->\n</body>\n\n</html>\n");
+    return c;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QSize>
+#include <QString>
+
+// Synthetic clipboard HTML in the shape Word produces: mso-* styles, VML
+// conditional comments, o:p elements and clip_imageNNN files next to the
+// document. The same seed always gives the same document and images.
+class WordCorpus {
+public:
+    struct Options {
+        int     images = 10;
+        int     paragraphsPerImage = 3;
+        quint32 seed = 1;
+        // Local images are written to imageDir and linked as file:// URLs.
+        // With remoteBase set, srcs point at remoteBase + "/img/N.ext"
+        // instead and the images are only returned.
+        QString imageDir;
+        QString remoteBase;
+    };
+
+    struct Image {
+        QString    name;   // clip_image001.png
+        QString    mime;
+        QByteArray bytes;
+        QSize      size;
+    };
+
+    struct Corpus {
+        QString      html;
+        QList<Image> images;
+        qint64       imageBytes = 0;
+    };
+
+    static Corpus generate(const Options &opt);
+
+    // PNG or JPEG between thumbnail and full-screen size, with enough
+    // detail that it does not compress to nothing.
+    static Image image(int index, quint32 seed);
+};
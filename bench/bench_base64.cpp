@@ -0,0 +1,104 @@
+// Checks every Base64 kernel this CPU supports against QByteArray, then
+// compares their throughput with QByteArray::toBase64/fromBase64.
+//
+//   bench_base64 [MiB]          (default: 16)
+//
+// The check covers every input length up to 1 KiB, all 256 byte values at
+// every alignment, and decoding with stray characters mixed in (line
+// breaks, padding, non-ASCII). Any mismatch exits with status 1.
+
+#include "Base64.h"
+
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+static QByteArray randomBytes(QRandomGenerator &rng, qsizetype n) {
+    QByteArray b(n, Qt::Uninitialized);
+    for (qsizetype i = 0; i < n; ++i) b[i] = char(rng.bounded(256));
+    return b;
+}
+
+static bool check(Base64::Kernel k) {
+    QRandomGenerator rng(12345);
+    int failures = 0;
+    auto expect = [&](bool ok, const char *what, qsizetype n) {
+        if (ok) return;
+        if (++failures <= 10)
+            std::fprintf(stderr, "%s: %s mismatch at length %lld\n", Base64::name(k), what, qint64(n));
+    };
+
+    for (qsizetype n = 0; n <= 1024; ++n) {
+        const QByteArray data = randomBytes(rng, n);
+        const QByteArray enc = Base64::encode(data, k);
+        expect(enc == data.toBase64(), "encode", n);
+        expect(Base64::decode(enc, k) == data, "round trip", n);
+
+        // Stray characters, as in wrapped or hand-edited data URIs
+        QByteArray noisy = enc;
+        for (int i = 0, m = rng.bounded(4); i < m && !noisy.isEmpty(); ++i) {
+            static const char Stray[] = "\r\n =-_%\x80\xff";
+            noisy.insert(rng.bounded(noisy.size() + 1), Stray[rng.bounded(int(sizeof(Stray) - 1))]);
+        }
+        expect(Base64::decode(noisy, k) == QByteArray::fromBase64(noisy), "lenient decode", n);
+    }
+
+    // Every byte value in every lane position, and every character as input
+    QByteArray all;
+    for (int i = 0; i < 256 * 3; ++i) all += char(i % 256);
+    for (int shift = 0; shift < 64; ++shift) {
+        const QByteArray data = all.mid(shift);
+        expect(Base64::encode(data, k) == data.toBase64(), "encode all bytes", data.size());
+        expect(Base64::decode(data, k) == QByteArray::fromBase64(data), "decode all chars", data.size());
+    }
+    return failures == 0;
+}
+
+static double mibPerSec(qsizetype bytes, qint64 ns) {
+    return ns ? bytes / (1024.0 * 1024.0) / (ns / 1e9) : 0;
+}
+
+int main(int argc, char **argv) {
+    const qsizetype size = qsizetype(argc > 1 ? std::atoi(argv[1]) : 16) * 1024 * 1024;
+    const QList<Base64::Kernel> kernels = Base64::supported();
+
+    bool ok = true;
+    for (Base64::Kernel k : kernels) {
+        const bool passed = check(k);
+        std::printf("%-8s %s\n", Base64::name(k), passed ? "matches QByteArray" : "MISMATCH");
+        ok = ok && passed;
+    }
+    if (!ok) return 1;
+
+    QRandomGenerator rng(1);
+    const QByteArray data = randomBytes(rng, size);
+    const QByteArray text = data.toBase64();
+    const int runs = 5;
+    qsizetype sink = 0;  // keeps the results alive
+
+    auto best = [&](auto fn) {
+        qint64 ns = std::numeric_limits<qint64>::max();
+        for (int r = 0; r < runs; ++r) {
+            QElapsedTimer t;
+            t.start();
+            fn();
+            ns = qMin(ns, t.nsecsElapsed());
+        }
+        return ns;
+    };
+
+    std::printf("\n%-10s %14s %14s   (%lld MiB, best of %d)\n", "kernel", "encode MiB/s",
+                "decode MiB/s", qint64(size >> 20), runs);
+    const qint64 qtEnc = best([&] { sink += data.toBase64().size(); });
+    const qint64 qtDec = best([&] { sink += QByteArray::fromBase64(text).size(); });
+    std::printf("%-10s %14.0f %14.0f\n", "QByteArray", mibPerSec(size, qtEnc), mibPerSec(size, qtDec));
+    for (Base64::Kernel k : kernels) {
+        const qint64 enc = best([&] { sink += Base64::encode(data, k).size(); });
+        const qint64 dec = best([&] { sink += Base64::decode(text, k).size(); });
+        std::printf("%-10s %14.0f %14.0f%s\n", Base64::name(k), mibPerSec(size, enc), mibPerSec(size, dec),
+                    k == Base64::best() ? "   (used)" : "");
+    }
+    return sink ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+// WordCleaner: golden checks on real Word fragments, then the size and
+// setHtml() time of synthetic Word documents before and after cleaning.
+//
+//   bench_clean [--update] [images ...]      (default: 10 100 1000)
+//
+// Each golden/NAME.html is cleaned and compared with golden/NAME.clean.html;
+// any difference exits with status 1. --update rewrites the expected files
+// instead, to be reviewed in the diff.
+
+#include "WordCleaner.h"
+#include "WordCorpus.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QTextDocument>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static QString readText(const QString &path) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return {};
+    return QString::fromUtf8(f.readAll());
+}
+
+static bool checkGolden(bool update) {
+    const QDir dir(QStringLiteral(CONVERTRT_GOLDEN_DIR));
+    int failures = 0, files = 0;
+    for (const QString &name : dir.entryList({ "*.html" }, QDir::Files, QDir::Name)) {
+        if (name.endsWith(".clean.html")) continue;
+        ++files;
+        const QString cleaned = WordCleaner::clean(readText(dir.filePath(name)));
+        const QString expectedPath = dir.filePath(name.chopped(5) + ".clean.html");
+        if (update) {
+            QFile out(expectedPath);
+            if (out.open(QIODevice::WriteOnly | QIODevice::Truncate)) out.write(cleaned.toUtf8());
+            continue;
+        }
+        const QString expected = readText(expectedPath);
+        if (cleaned == expected) continue;
+        ++failures;
+        qsizetype at = 0;
+        while (at < cleaned.size() && at < expected.size() && cleaned[at] == expected[at]) ++at;
+        std::fprintf(stderr, "%s: differs from %s at offset %lld\n  got:      %s\n  expected: %s\n",
+                     qPrintable(name), qPrintable(QFileInfo(expectedPath).fileName()), qint64(at),
+                     qPrintable(cleaned.mid(at, 60).replace('\n', "\\n")),
+                     qPrintable(expected.mid(at, 60).replace('\n', "\\n")));
+    }
+    if (files == 0) {
+        std::fprintf(stderr, "No golden files in %s\n", CONVERTRT_GOLDEN_DIR);
+        return false;
+    }
+    std::printf("golden: %d files, %s\n", files,
+                update ? "expected output rewritten" : failures ? "FAILED" : "ok");
+    return failures == 0;
+}
+
+static double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+static double setHtmlMs(const QString &html) {
+    std::vector<double> ms;
+    for (int run = 0; run < 5; ++run) {
+        QTextDocument doc;
+        doc.setTextWidth(800);
+        QElapsedTimer t;
+        t.start();
+        doc.setHtml(html);
+        doc.documentLayout()->documentSize();
+        ms.push_back(t.nsecsElapsed() / 1e6);
+    }
+    return median(ms);
+}
+
+int main(int argc, char **argv) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    bool update = false;
+    std::vector<int> counts;
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--update") == 0) update = true;
+        else counts.push_back(std::atoi(argv[i]));
+    }
+    if (counts.empty()) counts = { 10, 100, 1000 };
+
+    if (!checkGolden(update)) return 1;
+
+    std::printf("\n%8s %12s %12s %8s %10s %14s %14s\n",
+                "images", "raw KiB", "clean KiB", "saved", "clean ms", "setHtml raw", "setHtml clean");
+    for (int images : counts) {
+        WordCorpus::Options opt;
+        opt.images = images;
+        // Images are not fetched here, so the srcs need not resolve
+        opt.remoteBase = QStringLiteral("http://127.0.0.1:9");
+        const QString raw = WordCorpus::generate(opt).html;
+
+        std::vector<double> cleanMs;
+        QString cleaned;
+        for (int run = 0; run < 5; ++run) {
+            QElapsedTimer t;
+            t.start();
+            cleaned = WordCleaner::clean(raw);
+            cleanMs.push_back(t.nsecsElapsed() / 1e6);
+        }
+
+        const double rawKiB = raw.toUtf8().size() / 1024.0;
+        const double cleanKiB = cleaned.toUtf8().size() / 1024.0;
+        std::printf("%8d %12.1f %12.1f %7.1f%% %10.2f %14.2f %14.2f\n", images, rawKiB, cleanKiB,
+                    100.0 * (1.0 - cleanKiB / rawKiB), median(cleanMs), setHtmlMs(raw),
+                    setHtmlMs(cleaned));
+    }
+    return 0;
+}
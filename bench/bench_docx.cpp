@@ -0,0 +1,194 @@
+// Opening a .docx: DocxReader on a generated handout of a few hundred pages
+// with images, then the same inline and mask step a paste goes through.
+//
+//   bench_docx [pages ...]      (default: 30 300)
+//
+// The package is written with qCompress() output stripped to raw DEFLATE,
+// so the in-tree inflater is checked against zlib on the way. Every
+// paragraph and image must come out; a mismatch exits with status 1.
+
+#include "Converter.h"
+#include "DocxReader.h"
+#include "ImageStore.h"
+#include "WordCorpus.h"
+#include "ZipReader.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QTemporaryDir>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Stored-or-deflated ZIP writer, just enough for the test package
+class ZipWriter {
+public:
+    explicit ZipWriter(QFile *out) : _out(out) {}
+
+    void add(const QString &name, const QByteArray &data) {
+        // qCompress: 4-byte size, 2-byte zlib header, DEFLATE, 4-byte Adler-32
+        const QByteArray z = qCompress(data, 6);
+        const QByteArray deflated = z.mid(6, z.size() - 10);
+        const QByteArray n = name.toUtf8();
+        Entry e{ n, quint32(_out->pos()), ZipReader::crc32(data), quint32(deflated.size()),
+                 quint32(data.size()) };
+        QByteArray h;
+        put32(h, 0x04034b50);
+        put16(h, 20); put16(h, 0); put16(h, 8); put16(h, 0); put16(h, 0);
+        put32(h, e.crc); put32(h, e.compressed); put32(h, e.size);
+        put16(h, quint16(n.size())); put16(h, 0);
+        _out->write(h + n);
+        _out->write(deflated);
+        _entries.push_back(e);
+    }
+
+    void finish() {
+        const quint32 start = quint32(_out->pos());
+        for (const Entry &e : _entries) {
+            QByteArray h;
+            put32(h, 0x02014b50);
+            put16(h, 20); put16(h, 20); put16(h, 0); put16(h, 8); put16(h, 0); put16(h, 0);
+            put32(h, e.crc); put32(h, e.compressed); put32(h, e.size);
+            put16(h, quint16(e.name.size())); put16(h, 0); put16(h, 0); put16(h, 0); put16(h, 0);
+            put32(h, 0); put32(h, e.offset);
+            _out->write(h + e.name);
+        }
+        const quint32 size = quint32(_out->pos()) - start;
+        QByteArray h;
+        put32(h, 0x06054b50);
+        put16(h, 0); put16(h, 0);
+        put16(h, quint16(_entries.size())); put16(h, quint16(_entries.size()));
+        put32(h, size); put32(h, start); put16(h, 0);
+        _out->write(h);
+    }
+
+private:
+    struct Entry {
+        QByteArray name;
+        quint32    offset, crc, compressed, size;
+    };
+    static void put16(QByteArray &b, quint16 v) { b.append(char(v & 0xff)).append(char(v >> 8)); }
+    static void put32(QByteArray &b, quint32 v) { put16(b, quint16(v)); put16(b, quint16(v >> 16)); }
+
+    QFile *_out;
+    std::vector<Entry> _entries;
+};
+
+struct Handout {
+    int paragraphs = 0;
+    int images = 0;
+    qint64 bytes = 0;
+};
+
+// About 12 paragraphs a page, a heading every 4 pages, a bulleted list and
+// a table every 10, an image every 3
+static Handout writeHandout(const QString &path, int pages) {
+    Handout h;
+    QFile file(path);
+    file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    ZipWriter zip(&file);
+
+    QByteArray doc = "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+                     "<w:document xmlns:w=\"http://schemas.openxmlformats.org/wordprocessingml/2006/main\" "
+                     "xmlns:r=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships\" "
+                     "xmlns:wp=\"http://schemas.openxmlformats.org/drawingml/2006/wordprocessingDrawing\" "
+                     "xmlns:a=\"http://schemas.openxmlformats.org/drawingml/2006/main\"><w:body>";
+    QByteArray rels = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<Relationships "
+                      "xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+                      "<Relationship Id=\"rIdNum\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/numbering\" Target=\"numbering.xml\"/>";
+    for (int page = 0; page < pages; ++page) {
+        if (page % 4 == 0) {
+            doc += "<w:p><w:pPr><w:pStyle w:val=\"Heading1\"/></w:pPr><w:r><w:t>Chapter "
+                 + QByteArray::number(page / 4 + 1) + "</w:t></w:r></w:p>";
+            ++h.paragraphs;
+        }
+        for (int i = 0; i < 12; ++i) {
+            doc += "<w:p><w:r><w:rPr><w:b/></w:rPr><w:t xml:space=\"preserve\">Point "
+                 + QByteArray::number(page * 12 + i) + ". </w:t></w:r><w:r><w:t>Lorem ipsum dolor "
+                 "sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut "
+                 "labore et dolore magna aliqua &amp; more.</w:t></w:r></w:p>";
+            ++h.paragraphs;
+        }
+        if (page % 10 == 5) {
+            for (int i = 0; i < 3; ++i) {
+                doc += "<w:p><w:pPr><w:numPr><w:ilvl w:val=\"0\"/><w:numId w:val=\"1\"/></w:numPr></w:pPr>"
+                       "<w:r><w:t>Bullet</w:t></w:r></w:p>";
+                ++h.paragraphs;
+            }
+            doc += "<w:tbl><w:tr><w:tc><w:p><w:r><w:t>a</w:t></w:r></w:p></w:tc>"
+                   "<w:tc><w:p><w:r><w:t>b</w:t></w:r></w:p></w:tc></w:tr></w:tbl>";
+            h.paragraphs += 2;
+        }
+        if (page % 3 == 0) {
+            const WordCorpus::Image img = WordCorpus::image(h.images, 7);
+            const QByteArray id = "rIdImg" + QByteArray::number(h.images);
+            const QByteArray media = "media/image" + QByteArray::number(h.images + 1)
+                                   + (img.mime == "image/png" ? ".png" : ".jpeg");
+            zip.add("word/" + QString::fromLatin1(media), img.bytes);
+            rels += "<Relationship Id=\"" + id + "\" Type=\"http://schemas.openxmlformats.org/"
+                    "officeDocument/2006/relationships/image\" Target=\"" + media + "\"/>";
+            doc += "<w:p><w:r><w:drawing><wp:inline><wp:extent cx=\"" + QByteArray::number(img.size.width() * 9525)
+                 + "\" cy=\"" + QByteArray::number(img.size.height() * 9525) + "\"/><wp:docPr id=\"1\" "
+                   "descr=\"figure\"/><a:graphic><a:graphicData><a:blip r:embed=\"" + id
+                 + "\"/></a:graphicData></a:graphic></wp:inline></w:drawing></w:r></w:p>";
+            ++h.paragraphs;
+            ++h.images;
+        }
+    }
+    doc += "<w:sectPr/></w:body></w:document>";
+    rels += "</Relationships>";
+
+    zip.add("[Content_Types].xml", "<?xml version=\"1.0\"?><Types/>");
+    zip.add("_rels/.rels",
+            "<?xml version=\"1.0\"?><Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+            "<Relationship Id=\"rId1\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/"
+            "relationships/officeDocument\" Target=\"word/document.xml\"/></Relationships>");
+    zip.add("word/document.xml", doc);
+    zip.add("word/_rels/document.xml.rels", rels);
+    zip.add("word/numbering.xml",
+            "<?xml version=\"1.0\"?><w:numbering xmlns:w=\"http://schemas.openxmlformats.org/wordprocessingml/2006/main\">"
+            "<w:abstractNum w:abstractNumId=\"0\"><w:lvl w:ilvl=\"0\"><w:numFmt w:val=\"bullet\"/></w:lvl>"
+            "</w:abstractNum><w:num w:numId=\"1\"><w:abstractNumId w:val=\"0\"/></w:num></w:numbering>");
+    zip.finish();
+    h.bytes = file.size();
+    return h;
+}
+
+int main(int argc, char **argv) {
+    QGuiApplication app(argc, argv);  // WordCorpus paints its images
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::atoi(argv[i]));
+    if (sizes.empty()) sizes = { 30, 300 };
+
+    bool ok = true;
+    std::printf("%8s %10s %10s %10s %10s %10s %10s\n",
+                "pages", "MiB", "images", "paras", "read ms", "inline ms", "html MiB");
+    for (int pages : sizes) {
+        QTemporaryDir dir;
+        const QString path = dir.filePath("handout.docx");
+        const Handout h = writeHandout(path, pages);
+
+        ImageStore store;
+        QElapsedTimer t;
+        t.start();
+        const DocxReader::Result docx = DocxReader::read(path, store);
+        const double readMs = t.nsecsElapsed() / 1e6;
+        t.restart();
+        const Converter::Document doc = Converter::inlineAndMask(docx.html, store);
+        const double inlineMs = t.nsecsElapsed() / 1e6;
+
+        const int paragraphs = int(docx.html.count(QLatin1String("<p")) + docx.html.count(QLatin1String("<h1"))
+                                   + docx.html.count(QLatin1String("<li")));
+        if (!docx.error.isEmpty() || docx.images != h.images || doc.images != h.images
+            || paragraphs != h.paragraphs || store.count() != h.images) {
+            std::fprintf(stderr, "%d pages: %s; %d of %d images, %d of %d paragraphs\n", pages,
+                         qPrintable(docx.error.isEmpty() ? QStringLiteral("mismatch") : docx.error),
+                         doc.images, h.images, paragraphs, h.paragraphs);
+            ok = false;
+        }
+        std::printf("%8d %10.1f %10d %10d %10.1f %10.1f %10.1f\n", pages, h.bytes / (1024.0 * 1024.0),
+                    doc.images, paragraphs, readMs, inlineMs, docx.html.size() * 2 / (1024.0 * 1024.0));
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+// Compares the single-pass ImgScanner::inlineAndMask against the previous
+// regex-and-replace loop on documents with 1 to 1000 images.
+//
+//   bench_inline [image-kib]
+//
+// Each image is replaced by a data URI of image-kib KiB (default 64), which
+// is what the loop spends its time shifting around.
+
+#include "ImgScanner.h"
+
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <QStringList>
+#include <cstdio>
+#include <cstdlib>
+
+static QString makeDocument(int images) {
+    QString html = QStringLiteral("<html><body>");
+    for (int i = 0; i < images; ++i) {
+        html += QStringLiteral("<p class=MsoNormal>Paragraph %1 with some running text "
+                               "around the picture.</p>").arg(i);
+        html += QStringLiteral("<p><img width=320 height=240 src=\"file:///C:/Temp/msohtmlclip1/"
+                               "01/clip_image%1.png\" alt=\"figure\"></p>").arg(i, 3, 10, QChar('0'));
+    }
+    html += QStringLiteral("</body></html>");
+    return html;
+}
+
+// The loop ImgScanner replaced: one regex match and one in-place replace
+// per image, then a second regex pass to build the masked text.
+static std::pair<QString, QString> legacyInlineAndMask(const QString &html, const QString &uri) {
+    QString inl = html;
+    QRegularExpression reImg(R"(<img\b[^>]+src=['"]([^'"]+)['"][^>]*>)",
+                             QRegularExpression::CaseInsensitiveOption);
+    int pos = 0;
+    QRegularExpressionMatch m;
+    while ((m = reImg.match(inl, pos)).hasMatch()) {
+        QString tag = m.captured(0);
+        tag.replace(m.captured(1), uri);
+        inl.replace(m.capturedStart(), m.capturedLength(), tag);
+        pos = m.capturedStart() + tag.length();
+    }
+
+    QString masked;
+    int count = 0;
+    QRegularExpression reAll(R"(<img\b[^>]*>)",
+                             QRegularExpression::CaseInsensitiveOption);
+    pos = 0;
+    while ((m = reAll.match(inl, pos)).hasMatch()) {
+        masked += inl.mid(pos, m.capturedStart() - pos);
+        masked += QString("\n[Image omitted #%1]\n").arg(++count);
+        pos = m.capturedEnd();
+    }
+    masked += inl.mid(pos);
+    return { inl, masked };
+}
+
+int main(int argc, char **argv) {
+    const int kib = argc > 1 ? std::atoi(argv[1]) : 64;
+    const QString uri = QStringLiteral("data:image/png;base64,") + QString(kib * 1024, QChar('A'));
+
+    std::printf("%8s %14s %14s %14s %14s\n",
+                "images", "legacy ms", "scanner ms", "legacy us/img", "scanner us/img");
+    for (int images : { 1, 10, 100, 250, 500, 1000 }) {
+        const QString html = makeDocument(images);
+
+        QElapsedTimer t;
+        t.start();
+        auto legacy = legacyInlineAndMask(html, uri);
+        const qint64 legacyNs = t.nsecsElapsed();
+
+        t.restart();
+        auto r = ImgScanner::inlineAndMask(html, [&](QStringView) { return uri; });
+        const qint64 scanNs = t.nsecsElapsed();
+
+        if (r.html != legacy.first || r.masked != legacy.second) {
+            std::fprintf(stderr, "output mismatch at %d images\n", images);
+            return 1;
+        }
+
+        std::printf("%8d %14.2f %14.2f %14.2f %14.2f\n", images,
+                    legacyNs / 1e6, scanNs / 1e6,
+                    legacyNs / 1e3 / images, scanNs / 1e3 / images);
+    }
+    return 0;
+}
@@ -0,0 +1,344 @@
+// Times each stage of the conversion pipeline on synthetic Word HTML with
+// 1 to 1000 images:
+//
+//   inline     Converter::inlineAndMask (paste, local images into the store)
+//   render     first preview render of the inlined document
+//   keystroke  re-render after one edit in the middle (syncFromSource)
+//   rerender   the same document in a new QTextDocument (setHtml after a
+//              sync), images from the warm decoded-image cache
+//   copy_html  handles back to data URIs (copyHtml)
+//   sts        one cold credential fetch
+//   upload     every image through UploadQueue (confirmAndUpload)
+//   link_urls  uploaded URLs into the document and the HTML out again
+//              (uploadsFinished)
+//   fetch      the same images as remote URLs through ExternalImageLoader
+//
+// The network stages talk to StandInServer on localhost.
+//
+//   bench_pipeline [--images 1,10,100,1000] [--runs 3] [--latency ms]
+//                  [--seed n] [--json results.json]
+//
+// The JSON file holds one entry per stage and image count, so results from
+// two releases can be diffed or plotted.
+
+#include "Config.h"
+#include "Converter.h"
+#include "DecodedImageCache.h"
+#include "ExternalImageLoader.h"
+#include "HtmlDocument.h"
+#include "ImageStore.h"
+#include "PreviewRenderer.h"
+#include "StandInServer.h"
+#include "StsCache.h"
+#include "UploadQueue.h"
+#include "WordCorpus.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QTextDocument>
+#include <QThread>
+#include <QTimer>
+#include <QtNetwork/QNetworkAccessManager>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+// Resolves img: handles the way PreviewBrowser does, so the render stages
+// include decoding the images.
+class StoreDocument : public QTextDocument {
+public:
+    StoreDocument(const ImageStore &store, DecodedImageCache &cache) : _store(store), _cache(cache) {}
+
+protected:
+    QVariant loadResource(int type, const QUrl &name) override {
+        if (type == ImageResource && ImageStore::isHandle(name.toString())) {
+            const QImage img = _cache.image(_store, name.toString());
+            if (!img.isNull()) return img;
+        }
+        return QTextDocument::loadResource(type, name);
+    }
+
+private:
+    const ImageStore  &_store;
+    DecodedImageCache &_cache;
+};
+
+struct Sample {
+    QString stage;
+    int     images = 0;
+    std::vector<double> ms;
+    qint64  bytes = 0;   // data the stage moved, for MiB/s
+    int     failures = 0;
+};
+
+static double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+static double timeMs(const std::function<void()> &fn) {
+    QElapsedTimer t;
+    t.start();
+    fn();
+    return t.nsecsElapsed() / 1e6;
+}
+
+// Runs the event loop until done() holds or the timeout passes.
+static bool waitFor(const std::function<bool()> &done, int timeoutMs = 120000) {
+    QElapsedTimer t;
+    t.start();
+    while (!done()) {
+        if (t.elapsed() > timeoutMs) return false;
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 50);
+    }
+    return true;
+}
+
+static QString insertKeystroke(const QString &html) {
+    const QString anchor = QStringLiteral("<p class=MsoNormal><span");
+    qsizetype at = html.indexOf(anchor, html.size() / 2);
+    if (at < 0) at = html.indexOf(anchor);
+    if (at < 0) return html;
+    at = html.indexOf(u'>', html.indexOf(u'>', at) + 1) + 1;
+    QString edited = html;
+    edited.insert(at, u'x');
+    return edited;
+}
+
+static void layout(QTextDocument &doc) {
+    doc.documentLayout()->documentSize();
+}
+
+int main(int argc, char **argv) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName("bench_pipeline");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption imagesOpt("images", "Comma-separated image counts.", "list", "1,10,100,1000");
+    QCommandLineOption runsOpt("runs", "Runs per stage; the median is reported.", "n", "3");
+    QCommandLineOption latencyOpt("latency", "Stand-in server latency per response.", "ms", "0");
+    QCommandLineOption seedOpt("seed", "Corpus seed.", "n", "1");
+    QCommandLineOption jsonOpt("json", "Write results to this file.", "file");
+    parser.addOptions({ imagesOpt, runsOpt, latencyOpt, seedOpt, jsonOpt });
+    parser.process(app);
+
+    QList<int> counts;
+    for (const QString &s : parser.value(imagesOpt).split(',', Qt::SkipEmptyParts))
+        counts << qMax(1, s.toInt());
+    const int runs = qMax(1, parser.value(runsOpt).toInt());
+    const int latency = qMax(0, parser.value(latencyOpt).toInt());
+    const quint32 seed = parser.value(seedOpt).toUInt();
+    const QString jsonPath = parser.isSet(jsonOpt) ? QFileInfo(parser.value(jsonOpt)).absoluteFilePath()
+                                                   : QString();
+
+    // Config reads config.ini from the working directory; point it at the
+    // stand-in server without touching the user's file.
+    QTemporaryDir work;
+    if (!work.isValid() || !QDir::setCurrent(work.path())) {
+        std::fprintf(stderr, "cannot create a working directory\n");
+        return 1;
+    }
+    StandInServer server;
+    server.setLatencyMs(latency);
+    if (!server.start()) {
+        std::fprintf(stderr, "cannot listen: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+    QSettings &cfg = Config::settings();
+    cfg.setValue("oss/sts_url", server.baseUrl() + "/sts");
+    cfg.setValue("oss/oss_upload_url", server.baseUrl() + "/upload");
+    cfg.setValue("oss/oss_base_url", server.baseUrl() + "/oss");
+    cfg.sync();
+
+    QNetworkAccessManager network;
+    std::vector<Sample> samples;
+
+    std::printf("%-10s %7s %12s %12s %10s\n", "stage", "images", "median ms", "min ms", "MiB/s");
+    auto record = [&](Sample s) {
+        const double med = median(s.ms);
+        const double mibs = s.bytes && med > 0 ? s.bytes / (1024.0 * 1024.0) / (med / 1000.0) : 0;
+        std::printf("%-10s %7d %12.2f %12.2f %10.1f%s\n", qPrintable(s.stage), s.images, med,
+                    *std::min_element(s.ms.begin(), s.ms.end()), mibs,
+                    s.failures ? qPrintable(QStringLiteral("  (%1 failed)").arg(s.failures)) : "");
+        std::fflush(stdout);
+        samples.push_back(std::move(s));
+    };
+
+    for (int images : counts) {
+        QTemporaryDir dir;
+        WordCorpus::Options opt;
+        opt.images = images;
+        opt.seed = seed;
+        opt.imageDir = dir.path();
+        const WordCorpus::Corpus corpus = WordCorpus::generate(opt);
+        for (const WordCorpus::Image &img : corpus.images)
+            server.addFile(img.name, img.bytes, img.mime);
+
+        // inline: a fresh store each run, as on every paste
+        Sample inl{ "inline", images };
+        inl.bytes = corpus.html.size() * 2 + corpus.imageBytes;
+        ImageStore store;
+        Converter::Document doc;
+        for (int r = 0; r < runs; ++r) {
+            store.clear();
+            inl.ms.push_back(timeMs([&] { doc = Converter::inlineAndMask(corpus.html, store, dir.path()); }));
+        }
+        inl.failures = images - store.count();
+        record(inl);
+
+        Sample render{ "render", images };
+        Sample key{ "keystroke", images };
+        Sample rerender{ "rerender", images };
+        render.bytes = key.bytes = rerender.bytes = doc.html.size() * 2;
+        const QString edited = insertKeystroke(doc.html);
+        DecodedImageCache::Stats cacheStats;
+        for (int r = 0; r < runs; ++r) {
+            // Cold: nothing decoded yet, as on a paste
+            DecodedImageCache cache(Config::previewImageCacheMb() * 1024 * 1024);
+            StoreDocument preview(store, cache);
+            PreviewRenderer renderer(&preview);
+            render.ms.push_back(timeMs([&] { renderer.render(doc.html); layout(preview); }));
+            key.ms.push_back(timeMs([&] { renderer.render(edited); layout(preview); }));
+            StoreDocument again(store, cache);
+            PreviewRenderer rerenderer(&again);
+            rerender.ms.push_back(timeMs([&] { rerenderer.render(edited); layout(again); }));
+            cacheStats = cache.stats();
+        }
+        record(render);
+        record(key);
+        record(rerender);
+        std::printf("%-10s %7d images decoded, %.1f MiB, %.0f%% hits\n", "  cache", cacheStats.images,
+                    cacheStats.bytes / (1024.0 * 1024.0), cacheStats.hitRate() * 100);
+
+        Sample copy{ "copy_html", images };
+        for (int r = 0; r < runs; ++r) {
+            QString out;
+            copy.ms.push_back(timeMs([&] { out = store.toDataUris(doc.html); }));
+            copy.bytes = out.size() * 2;
+        }
+        record(copy);
+
+        Sample sts{ "sts", images };
+        for (int r = 0; r < runs; ++r) {
+            StsCache cache(&network);
+            bool done = false;
+            sts.ms.push_back(timeMs([&] {
+                cache.acquire(&cache, [&](const StsCredentials &, const QString &error) {
+                    if (!error.isEmpty()) ++sts.failures;
+                    done = true;
+                });
+                waitFor([&] { return done; });
+            }));
+        }
+        record(sts);
+
+        // upload: credentials are warm, as they are after the first batch
+        Sample up{ "upload", images };
+        up.bytes = corpus.imageBytes;
+        {
+            StsCache cache(&network);
+            UploadQueue queue(&network, &cache);
+            const QStringList handles = Converter::imageHandles(doc.html);
+            for (int r = 0; r < runs; ++r) {
+                bool done = false;
+                auto c = QObject::connect(&queue, &UploadQueue::finished, [&](int succeeded, int total) {
+                    up.failures = total - succeeded;
+                    done = true;
+                });
+                up.ms.push_back(timeMs([&] {
+                    queue.start(handles, store);
+                    waitFor([&] { return done; });
+                }));
+                QObject::disconnect(c);
+            }
+        }
+        record(up);
+
+        Sample link{ "link_urls", images };
+        link.bytes = doc.html.size() * 2;
+        for (int r = 0; r < runs; ++r) {
+            HtmlDocument working(doc.html);
+            const QList<int> used = working.usedImages();
+            link.ms.push_back(timeMs([&] {
+                for (int image : used)
+                    working.setSrc(image, QStringLiteral("https://cdn.example.com/pc/course/dev/%1.png").arg(image));
+                working = HtmlDocument(working.html());
+            }));
+        }
+        record(link);
+
+        // fetch: a new loader and a new query per run keep every fetch cold
+        Sample fetch{ "fetch", images };
+        fetch.bytes = corpus.imageBytes;
+        for (int r = 0; r < runs; ++r) {
+            ExternalImageLoader loader;
+            const QString run = QString::number(QDateTime::currentMSecsSinceEpoch()) + "-" + QString::number(r);
+            int loaded = 0;
+            QObject::connect(&loader, &ExternalImageLoader::imageLoaded, [&] { ++loaded; });
+            fetch.ms.push_back(timeMs([&] {
+                for (const WordCorpus::Image &img : corpus.images)
+                    loader.image(QUrl(server.baseUrl() + "/img/" + img.name + "?run=" + run));
+                // Failed fetches are not signalled; they show up as a timeout
+                if (!waitFor([&] { return loaded >= images; }, 60000))
+                    fetch.failures = images - loaded;
+            }));
+        }
+        record(fetch);
+    }
+
+    if (!jsonPath.isEmpty()) {
+        QJsonArray results;
+        for (const Sample &s : samples) {
+            QJsonArray ms;
+            for (double v : s.ms) ms << v;
+            QJsonObject o;
+            o["stage"] = s.stage;
+            o["images"] = s.images;
+            o["median_ms"] = median(s.ms);
+            o["min_ms"] = *std::min_element(s.ms.begin(), s.ms.end());
+            o["runs_ms"] = ms;
+            o["bytes"] = s.bytes;
+            o["failures"] = s.failures;
+            results << o;
+        }
+        QJsonObject host;
+        host["os"] = QSysInfo::prettyProductName();
+        host["cpu"] = QSysInfo::currentCpuArchitecture();
+        host["threads"] = QThread::idealThreadCount();
+        QJsonObject root;
+        root["benchmark"] = "pipeline";
+        root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+        root["qt"] = qVersion();
+        root["host"] = host;
+        root["seed"] = qint64(seed);
+        root["runs"] = runs;
+        root["latency_ms"] = latency;
+        root["results"] = results;
+
+        QFile f(jsonPath);
+        if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::fprintf(stderr, "cannot write %s\n", qPrintable(jsonPath));
+            return 1;
+        }
+        f.write(QJsonDocument(root).toJson());
+    }
+    return 0;
+}
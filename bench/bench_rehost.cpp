@@ -0,0 +1,181 @@
+// Re-hosting remote images: RemoteRehoster, which pipes each download into
+// its OSS upload, against downloading each image whole and then uploading
+// the bytes. The image host is a stand-in on localhost that sends every
+// file at a limited rate per connection; the bucket is a second stand-in.
+//
+//   bench_rehost [images] [MiB per image] [MiB/s per connection]   (default: 6 4 8)
+//
+// "overlap" is the share of the uploaded bytes that reached the bucket
+// while downloads were still running. Exits with status 1 unless every
+// object arrives at full size, the rewritten HTML links only the bucket,
+// most bytes overlap and the batch takes about as long as one image alone.
+
+#include "Config.h"
+#include "RemoteRehoster.h"
+#include "StandInServer.h"
+#include "StsCache.h"
+#include "UploadQueue.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+#include <cstdio>
+#include <functional>
+
+static constexpr qint64 MiB = 1024 * 1024;
+
+static QByteArray randomBytes(qint64 size, quint32 seed) {
+    QByteArray bytes(size, Qt::Uninitialized);
+    QRandomGenerator rng(seed);
+    rng.fillRange(reinterpret_cast<quint32 *>(bytes.data()), size / 4);
+    return bytes;
+}
+
+struct Run {
+    int    succeeded = 0;
+    qint64 ms = 0;
+    qint64 overlapped = 0;  // bytes uploaded before the downloads were done
+};
+
+// Spins the event loop until done() holds, noting how far the uploads got
+// while the image host still had bytes to send.
+static void wait(const std::function<bool()> &done, const StandInServer &images, qint64 imageBytes,
+                 const StandInServer &oss, Run &run) {
+    const qint64 imagesStart = images.stats().bytesOut;
+    const qint64 ossStart = oss.stats().bytesIn;
+    while (!done()) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 10);
+        if (images.stats().bytesOut - imagesStart < imageBytes)
+            run.overlapped = oss.stats().bytesIn - ossStart;
+    }
+}
+
+static Run rehostStreamed(QNetworkAccessManager &network, StsCache &sts, const QStringList &sources,
+                          const StandInServer &images, qint64 imageBytes, const StandInServer &oss,
+                          QStringList *urls = nullptr, QString *html = nullptr) {
+    Run run;
+    QElapsedTimer t;
+    t.start();
+    RemoteRehoster rehost(&network, &sts);
+    rehost.setMaxInFlight(int(sources.size()));
+    bool finished = false;
+    QObject::connect(&rehost, &RemoteRehoster::finished, [&](int ok, int) {
+        run.succeeded = ok;
+        finished = true;
+    });
+    rehost.start(sources);
+    wait([&finished]() { return finished; }, images, imageBytes, oss, run);
+    run.ms = t.elapsed();
+    if (urls) *urls = rehost.urls();
+    if (html) *html = rehost.rewrite(*html);
+    return run;
+}
+
+// A re-host put together from the existing pieces: download the image
+// whole, then upload the bytes.
+static Run rehostBuffered(QNetworkAccessManager &network, StsCache &sts, const QStringList &sources,
+                          const StandInServer &images, qint64 imageBytes, const StandInServer &oss) {
+    Run run;
+    QElapsedTimer t;
+    t.start();
+    QObject context;
+    int pending = int(sources.size());
+    for (int i = 0; i < sources.size(); ++i) {
+        QNetworkReply *get = network.get(QNetworkRequest(QUrl(sources[i])));
+        QObject::connect(get, &QNetworkReply::finished, &context, [&, get, i]() {
+            get->deleteLater();
+            if (get->error() != QNetworkReply::NoError) {
+                --pending;
+                return;
+            }
+            const QByteArray bytes = get->readAll();
+            const QByteArray mime = get->rawHeader("Content-Type");
+            sts.acquire(&context, [&, bytes, mime, i](const StsCredentials &creds, const QString &) {
+                const QString object = QString("buffered/%1").arg(i);
+                QNetworkReply *put = network.put(
+                    UploadQueue::signedRequest(creds, "PUT", object, {}, mime, 60000), bytes);
+                QObject::connect(put, &QNetworkReply::finished, &context, [&, put]() {
+                    put->deleteLater();
+                    if (put->error() == QNetworkReply::NoError) ++run.succeeded;
+                    --pending;
+                });
+            });
+        });
+    }
+    wait([&pending]() { return pending == 0; }, images, imageBytes, oss, run);
+    run.ms = t.elapsed();
+    return run;
+}
+
+static bool check(bool ok, const char *what) {
+    if (!ok) std::fprintf(stderr, "FAILED: %s\n", what);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    const int count = argc > 1 ? qMax(1, QByteArray(argv[1]).toInt()) : 6;
+    const qint64 size = (argc > 2 ? QByteArray(argv[2]).toDouble() : 4) * MiB;
+    const qint64 rate = (argc > 3 ? QByteArray(argv[3]).toDouble() : 8) * MiB;
+
+    QTemporaryDir work;
+    QDir::setCurrent(work.path());
+    // Two hosts, so downloads and uploads do not share connections
+    StandInServer images, oss;
+    if (!images.start() || !oss.start()) return 1;
+    images.setFileRate(rate);
+    QSettings &cfg = Config::settings();
+    cfg.setValue("oss/sts_url", oss.baseUrl() + "/sts");
+    cfg.setValue("oss/oss_upload_url", oss.baseUrl() + "/upload");
+    cfg.setValue("oss/oss_base_url", oss.baseUrl() + "/oss");
+    cfg.setValue("upload/timeout_secs", 60);
+
+    QStringList sources;
+    QString html;
+    for (int i = 0; i < count; ++i) {
+        const QString name = QString("photo%1.jpg").arg(i);
+        images.addFile(name, randomBytes(size, i + 1), "image/jpeg");
+        sources << images.baseUrl() + "/img/" + name;
+        html += QString("<p>Figure %1</p><img src=\"%2\" width=\"640\">\n").arg(i + 1).arg(sources.last());
+    }
+
+    QNetworkAccessManager network;
+    StsCache sts(&network);
+    bool ok = true;
+    std::printf("%-10s %8s %10s %8s %10s\n", "scenario", "images", "succeeded", "ms", "overlap %");
+    auto report = [size](const char *name, int n, const Run &r) {
+        std::printf("%-10s %8d %10d %8lld %10.0f\n", name, n, r.succeeded, r.ms,
+                    100.0 * r.overlapped / (n * size));
+    };
+
+    const Run single = rehostStreamed(network, sts, sources.mid(0, 1), images, size, oss);
+    report("single", 1, single);
+    ok &= check(single.succeeded == 1, "one image is copied");
+
+    const Run buffered = rehostBuffered(network, sts, sources, images, count * size, oss);
+    report("buffered", count, buffered);
+
+    QStringList urls;
+    QString rewritten = html;
+    const Run streamed = rehostStreamed(network, sts, sources, images, count * size, oss, &urls, &rewritten);
+    report("streamed", count, streamed);
+
+    ok &= check(streamed.succeeded == count, "every image is copied");
+    bool complete = true;
+    for (const QString &url : urls)
+        complete = complete && oss.objectSize(url.mid(oss.baseUrl().size() + 5)) == size;  // after "/oss/"
+    ok &= check(complete, "every object arrives at full size");
+    ok &= check(!rewritten.contains(images.baseUrl()) && rewritten.count(oss.baseUrl()) == count,
+                "the rewritten HTML links only the bucket");
+    ok &= check(streamed.overlapped > count * size / 2, "uploads run while the downloads do");
+    ok &= check(streamed.ms < single.ms * 3 / 2 + 200, "the batch takes about as long as one image");
+
+    std::printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
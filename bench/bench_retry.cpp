@@ -0,0 +1,169 @@
+// Upload recovery against a stand-in OSS server that fails on purpose:
+//
+//   faults     small images while 20% of upload requests get a 503 and 5%
+//              lose their connection; every image must still arrive
+//   multipart  one large image in parts under the same faults; the object
+//              must be put together at full size
+//   resume     a batch is torn down halfway (as a crash would) and run
+//              again with a journal loaded from disk; only what was
+//              missing may be sent the second time
+//
+//   bench_retry [large image MiB]      (default: 24)
+//
+// Exits with status 1 if any check fails.
+
+#include "Config.h"
+#include "ImageStore.h"
+#include "StandInServer.h"
+#include "StsCache.h"
+#include "UploadJournal.h"
+#include "UploadQueue.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QtNetwork/QNetworkAccessManager>
+#include <cstdio>
+#include <functional>
+
+static constexpr qint64 MiB = 1024 * 1024;
+
+static QByteArray randomBytes(qint64 size, quint32 seed) {
+    QByteArray bytes(size, Qt::Uninitialized);
+    QRandomGenerator rng(seed);
+    rng.fillRange(reinterpret_cast<quint32 *>(bytes.data()), size / 4);
+    return bytes;
+}
+
+struct Run {
+    int    succeeded = 0;
+    int    retries = 0;
+    bool   finished = false;
+    qint64 ms = 0;
+};
+
+// Runs the batch until it finishes, or until stop() returns true, in which
+// case the queue is destroyed mid-flight.
+static Run upload(QNetworkAccessManager &network, StsCache &sts, UploadJournal *journal,
+                  const QStringList &handles, const ImageStore &store, QStringList *urls = nullptr,
+                  const std::function<bool()> &stop = {}) {
+    Run run;
+    QElapsedTimer t;
+    t.start();
+    auto *queue = new UploadQueue(&network, &sts);
+    queue->setJournal(journal);
+    QObject::connect(queue, &UploadQueue::imageRetrying, [&run]() { ++run.retries; });
+    QObject::connect(queue, &UploadQueue::finished, [&run](int ok, int) {
+        run.succeeded = ok;
+        run.finished = true;
+    });
+    queue->start(handles, store);
+    while (!run.finished && !(stop && stop()))
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 20);
+    if (urls) *urls = queue->urls();
+    delete queue;
+    run.ms = t.elapsed();
+    return run;
+}
+
+static bool check(bool ok, const char *what) {
+    if (!ok) std::fprintf(stderr, "FAILED: %s\n", what);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    const qint64 largeSize = (argc > 1 ? QByteArray(argv[1]).toLongLong() : 24) * MiB;
+
+    QTemporaryDir work;
+    QDir::setCurrent(work.path());
+    StandInServer server;
+    if (!server.start()) return 1;
+    QSettings &cfg = Config::settings();
+    cfg.setValue("oss/sts_url", server.baseUrl() + "/sts");
+    cfg.setValue("oss/oss_upload_url", server.baseUrl() + "/upload");
+    cfg.setValue("oss/oss_base_url", server.baseUrl() + "/oss");
+    cfg.setValue("upload/retries", 8);
+    cfg.setValue("upload/retry_base_ms", 20);
+    cfg.setValue("upload/retry_max_ms", 500);
+    cfg.setValue("upload/timeout_secs", 10);
+    cfg.setValue("upload/multipart_threshold_mb", 8);
+    cfg.setValue("upload/part_size_mb", 4);
+
+    QNetworkAccessManager network;
+    StsCache sts(&network);
+    ImageStore store;
+    QStringList small;
+    for (int i = 0; i < 40; ++i)
+        small << store.insert(randomBytes(200 * 1024, i + 1), QStringLiteral("image/jpeg"));
+    const QString large = store.insert(randomBytes(largeSize, 1000), QStringLiteral("image/png"));
+    const int largeParts = int((largeSize + 4 * MiB - 1) / (4 * MiB));
+    auto objectOf = [&server](const QString &url) {
+        return url.mid(server.baseUrl().size() + 5);  // after "/oss/"
+    };
+
+    bool ok = true;
+    StandInServer::Faults faults;
+    faults.errorRate = 0.2;
+    faults.dropRate = 0.05;
+    std::printf("%-10s %8s %10s %8s %8s %10s %8s\n",
+                "scenario", "images", "succeeded", "faults", "retries", "MiB sent", "ms");
+    auto report = [&server](const char *name, int images, const Run &r) {
+        std::printf("%-10s %8d %10d %8d %8d %10.1f %8lld\n", name, images, r.succeeded,
+                    server.stats().faults, r.retries, server.stats().bytesIn / double(MiB), r.ms);
+    };
+
+    // Faults on every kind of request, single-shot form uploads
+    server.setFaults(faults);
+    server.resetStats();
+    Run r = upload(network, sts, nullptr, small, store);
+    report("faults", int(small.size()), r);
+    ok &= check(r.succeeded == small.size(), "every image uploads despite faults");
+    ok &= check(server.stats().faults > 0 && r.retries > 0, "faults were injected and retried");
+
+    // The same faults on a multipart upload
+    server.resetStats();
+    QStringList urls;
+    r = upload(network, sts, nullptr, { large }, store, &urls);
+    report("multipart", 1, r);
+    ok &= check(r.succeeded == 1, "the large image uploads despite faults");
+    ok &= check(server.objectSize(objectOf(urls.value(0))) == largeSize,
+                "the multipart object is complete");
+
+    // Interrupted batch, resumed from the journal on disk
+    server.setFaults({});
+    const QString journalPath = QDir(work.path()).filePath("upload_journal.jsonl");
+    const QStringList batch = QStringList(small) << large;
+    qint64 fullBytes = 0;
+    for (const QString &h : batch) fullBytes += store.image(h).bytes.size();
+    {
+        UploadJournal journal(journalPath);
+        server.resetStats();
+        r = upload(network, sts, &journal, batch, store, nullptr, [&server, largeParts]() {
+            return server.stats().parts >= largeParts / 2 && server.stats().requests > 30;
+        });
+        report("crash", int(batch.size()), r);
+        ok &= check(!r.finished, "the first run was interrupted");
+    }
+    const qint64 firstBytes = server.stats().bytesIn;
+    {
+        UploadJournal journal(journalPath);
+        ok &= check(!journal.isEmpty(), "the journal survived the interruption");
+        server.resetStats();
+        r = upload(network, sts, &journal, batch, store, &urls);
+        report("resume", int(batch.size()), r);
+        ok &= check(r.succeeded == batch.size(), "the resumed batch completes");
+        ok &= check(server.objectSize(objectOf(urls.last())) == largeSize,
+                    "the resumed multipart object is complete");
+        ok &= check(server.stats().bytesIn < fullBytes - firstBytes / 2,
+                    "the resumed batch skips what was already sent");
+    }
+    ok &= check(!QFile::exists(journalPath), "the journal is removed once the batch succeeded");
+
+    std::printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
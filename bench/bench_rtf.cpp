@@ -0,0 +1,89 @@
+// Copy as Rich Text: RtfWriter against the QTextEdit round trip it replaced
+// (setHtml with data URIs, select all, build the clipboard data).
+//
+//   bench_rtf [images ...]      (default: 1 10 100)
+//
+// Each RTF is also checked for one \pict group per image; a mismatch exits
+// with status 1.
+
+#include "Converter.h"
+#include "ImageStore.h"
+#include "RtfWriter.h"
+#include "WordCorpus.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QMimeData>
+#include <QTemporaryDir>
+#include <QTextEdit>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// createMimeDataFromSelection() is what QTextEdit::copy() puts on the clipboard
+class CopyEdit : public QTextEdit {
+public:
+    QMimeData *copied() const { return createMimeDataFromSelection(); }
+};
+
+static double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+template <typename F>
+static double timeMs(F &&f) {
+    QElapsedTimer t;
+    t.start();
+    f();
+    return t.nsecsElapsed() / 1e6;
+}
+
+int main(int argc, char **argv) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    std::vector<int> counts;
+    for (int i = 1; i < argc; ++i) counts.push_back(std::atoi(argv[i]));
+    if (counts.empty()) counts = { 1, 10, 100 };
+
+    bool ok = true;
+    std::printf("%8s %12s %12s %12s %10s %10s\n",
+                "images", "image MiB", "QTextEdit ms", "RtfWriter ms", "RTF MiB", "MiB/s");
+    for (int images : counts) {
+        QTemporaryDir dir;
+        WordCorpus::Options opt;
+        opt.images = images;
+        opt.imageDir = dir.path();
+        const WordCorpus::Corpus corpus = WordCorpus::generate(opt);
+        ImageStore store;
+        const Converter::Document doc = Converter::inlineAndMask(corpus.html, store, dir.path());
+        const QString withDataUris = store.toDataUris(doc.html);
+
+        std::vector<double> oldMs, newMs;
+        QByteArray rtf;
+        for (int run = 0; run < 3; ++run) {
+            oldMs.push_back(timeMs([&] {
+                CopyEdit edit;
+                edit.setHtml(withDataUris);
+                edit.selectAll();
+                delete edit.copied();
+            }));
+            newMs.push_back(timeMs([&] { rtf = RtfWriter::toRtf(doc.html, &store); }));
+        }
+
+        const int picts = int(rtf.count("{\\pict"));
+        if (!rtf.startsWith("{\\rtf1") || picts != doc.images) {
+            std::fprintf(stderr, "%d images: RTF holds %d pictures, expected %d\n",
+                         images, picts, doc.images);
+            ok = false;
+        }
+        const double rtfMiB = rtf.size() / (1024.0 * 1024.0);
+        std::printf("%8d %12.1f %12.1f %12.1f %10.1f %10.1f\n", images,
+                    corpus.imageBytes / (1024.0 * 1024.0), median(oldMs), median(newMs), rtfMiB,
+                    rtfMiB / (median(newMs) / 1000.0));
+    }
+    return ok ? 0 : 1;
+}
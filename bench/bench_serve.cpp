@@ -0,0 +1,221 @@
+// The conversion service (ConvertServer) under load from local clients:
+//
+//   formats   one document in each format, checked image for image
+//   warm      every document posted to the running service at once:
+//             documents/s, and per-stage latency from /metrics
+//   cold      the same documents through one convertrt-cli process each,
+//             when convertrt-cli sits next to this binary
+//   overload  one worker and one queue slot against a burst; the excess
+//             must be turned away with 503 and the rest still answered
+//   files     an image outside server/file_root must not be read
+//   web       requests from a web page, and uploads without the token, are
+//             refused with 403
+//
+//   bench_serve [documents] [images per document]     (default: 24 10)
+//
+// Exits with status 1 if any check fails.
+
+#include "Config.h"
+#include "ConvertServer.h"
+#include "WordCorpus.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QUrl>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+#include <cstdio>
+
+struct Answer {
+    int        status = 0;
+    int        images = -1;  // X-Convertrt-Images
+    int        unloaded = -1;  // X-Convertrt-Unloaded
+    QByteArray body;
+};
+
+// Posts every document at once and waits for all the answers.
+static QList<Answer> post(QNetworkAccessManager &network, const QString &url, const QList<QByteArray> &docs,
+                          const QList<QPair<QByteArray, QByteArray>> &headers = {}) {
+    QList<Answer> answers(docs.size());
+    int pending = int(docs.size());
+    for (int i = 0; i < docs.size(); ++i) {
+        QNetworkRequest req((QUrl(url)));
+        req.setHeader(QNetworkRequest::ContentTypeHeader, "text/html; charset=utf-8");
+        for (const auto &[name, value] : headers)
+            req.setRawHeader(name, value);
+        QNetworkReply *reply = network.post(req, docs[i]);
+        QObject::connect(reply, &QNetworkReply::finished, [&answers, &pending, reply, i]() {
+            reply->deleteLater();
+            answers[i].status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            answers[i].images = reply->rawHeader("X-Convertrt-Images").toInt();
+            answers[i].unloaded = reply->rawHeader("X-Convertrt-Unloaded").toInt();
+            answers[i].body = reply->readAll();
+            --pending;
+        });
+    }
+    while (pending)
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 50);
+    return answers;
+}
+
+static QJsonObject metrics(QNetworkAccessManager &network, const QString &base) {
+    QNetworkReply *reply = network.get(QNetworkRequest(QUrl(base + "/metrics")));
+    while (!reply->isFinished())
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 50);
+    reply->deleteLater();
+    return QJsonDocument::fromJson(reply->readAll()).object();
+}
+
+static bool check(bool ok, const char *what) {
+    if (!ok) std::fprintf(stderr, "FAILED: %s\n", what);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    const int count = argc > 1 ? qMax(1, QByteArray(argv[1]).toInt()) : 24;
+    const int images = argc > 2 ? qMax(1, QByteArray(argv[2]).toInt()) : 10;
+
+    QTemporaryDir work;
+    QDir::setCurrent(work.path());
+    QList<QByteArray> docs;
+    QStringList paths;
+    for (int i = 0; i < count; ++i) {
+        const QString dir = QDir(work.path()).filePath(QString("doc%1").arg(i));
+        QDir().mkpath(dir);
+        WordCorpus::Options opt;
+        opt.images = images;
+        opt.seed = quint32(i + 1);
+        opt.imageDir = dir;
+        docs << WordCorpus::generate(opt).html.toUtf8();
+        paths << QDir(dir).filePath("doc.html");
+        QFile out(paths.last());
+        if (!out.open(QIODevice::WriteOnly) || out.write(docs.last()) != docs.last().size()) return 1;
+    }
+
+    // The documents link their images as files under the work directory
+    Config::settings().setValue("server/file_root", work.path());
+    ConvertServer server;
+    server.setQueueLimit(count);
+    if (!server.start(0)) return 1;
+    const QString base = QString("http://127.0.0.1:%1").arg(server.serverPort());
+    QNetworkAccessManager network;
+    bool ok = true;
+
+    // Every format once, on the first document
+    const QList<QPair<QString, QByteArray>> formats = {
+        { "inline", "src=\"data:image/" }, { "masked", "[Image omitted #" }, { "rtf", "{\\pict" } };
+    for (const auto &[format, marker] : formats) {
+        const Answer a = post(network, base + "/convert?format=" + format, { docs.first() }).first();
+        const int found = int(a.body.count(marker));
+        std::printf("%-8s HTTP %d, %d images, %lld KiB\n", qPrintable(format), a.status, found,
+                    a.body.size() / 1024);
+        ok &= check(a.status == 200 && a.images == images && found == images,
+                    "each format holds every image");
+    }
+
+    // Warm: all documents at once
+    QElapsedTimer t;
+    t.start();
+    const QList<Answer> warm = post(network, base + "/convert", docs);
+    const qint64 warmMs = qMax<qint64>(1, t.elapsed());
+    int answered = 0;
+    for (const Answer &a : warm)
+        answered += a.status == 200 && int(a.body.count("src=\"data:image/")) == images;
+    std::printf("\n%-8s %10s %10s %10s\n", "", "documents", "ms", "docs/s");
+    std::printf("%-8s %10d %10lld %10.1f\n", "warm", count, warmMs, count * 1000.0 / warmMs);
+    ok &= check(answered == count, "every document comes back whole");
+
+    // Cold: one process per document, as many at once as the service ran
+    const QString cli = QDir(QCoreApplication::applicationDirPath()).filePath("convertrt-cli");
+    if (QFileInfo(cli).isExecutable() || QFileInfo(cli + ".exe").isExecutable()) {
+        t.restart();
+        QList<QProcess *> running;
+        int next = 0, failed = 0;
+        while (next < paths.size() || !running.isEmpty()) {
+            while (next < paths.size() && running.size() < server.workers()) {
+                auto *p = new QProcess;
+                p->start(cli, { "-f", "inline", "-j", "1", paths[next++] });
+                running << p;
+            }
+            QProcess *p = running.takeFirst();
+            p->waitForFinished(-1);
+            failed += p->exitCode() != 0;
+            delete p;
+        }
+        const qint64 coldMs = qMax<qint64>(1, t.elapsed());
+        std::printf("%-8s %10d %10lld %10.1f\n", "cold", count, coldMs, count * 1000.0 / coldMs);
+        ok &= check(failed == 0, "every cold conversion succeeds");
+    } else {
+        std::printf("%-8s (convertrt-cli not found next to this binary)\n", "cold");
+    }
+
+    const QJsonObject m = metrics(network, base);
+    const QJsonObject stages = m["stages"].toObject();
+    std::printf("\n%-8s %8s %10s %10s %10s\n", "stage", "count", "mean ms", "p95 ms", "max ms");
+    for (const char *stage : { "queue", "clean", "inline", "write", "total" }) {
+        const QJsonObject s = stages[QLatin1String(stage)].toObject();
+        std::printf("%-8s %8d %10.1f %10.1f %10.1f\n", stage, s["count"].toInt(), s["mean_ms"].toDouble(),
+                    s["p95_ms"].toDouble(), s["max_ms"].toDouble());
+    }
+    ok &= check(m["completed"].toInt() == count + int(formats.size()), "/metrics counts every answer");
+    ok &= check(m["queued"].toInt() == 0 && m["converting"].toInt() == 0, "nothing is left in work");
+
+    // Overload: a burst against one worker and one waiting slot. Each
+    // request carries every document, so the first is still in work when
+    // the last arrives.
+    server.setWorkers(1);
+    server.setQueueLimit(1);
+    const QList<QByteArray> burst(6, docs.join());
+    const QList<Answer> answers = post(network, base + "/convert?format=rtf", burst);
+    int served = 0, busy = 0;
+    for (const Answer &a : answers) {
+        served += a.status == 200;
+        busy += a.status == 503;
+    }
+    std::printf("\noverload %d requests: %d answered, %d turned away\n", int(burst.size()), served, busy);
+    ok &= check(served + busy == burst.size() && served >= 1 && busy >= 1,
+                "a burst past the queue is turned away, the rest answered");
+    ok &= check(metrics(network, base)["rejected"].toInt() == busy, "/metrics counts the rejections");
+
+    // Files: a document that links a file outside the root gets nothing of it
+    server.setWorkers(2);
+    server.setQueueLimit(2);
+    QTemporaryDir outside;
+    const QString secret = QDir(outside.path()).filePath("secret.png");
+    {
+        QFile f(secret);
+        if (!f.open(QIODevice::WriteOnly) || f.write(WordCorpus::image(0, 1).bytes) <= 0) return 1;
+    }
+    const QByteArray probe = "<p>Hello</p><img src=\"" + QUrl::fromLocalFile(secret).toEncoded() + "\">"
+                           + "<img src=\"" + QDir(work.path()).filePath("../" + QFileInfo(outside.path()).fileName()
+                                                                        + "/secret.png").toUtf8() + "\">";
+    const Answer a = post(network, base + "/convert", { probe }).first();
+    std::printf("\nfiles    HTTP %d, %d images, %d left unloaded\n", a.status, a.images, a.unloaded);
+    ok &= check(a.status == 200 && a.unloaded == 2 && !a.body.contains("data:image/"),
+                "files outside server/file_root are not read");
+
+    // Web: what a page in the browser could send
+    const int fromPage = post(network, base + "/convert", { docs.first() },
+                              { { "Origin", "https://example.com" } }).first().status;
+    const int rebound = post(network, base + "/convert", { docs.first() },
+                             { { "Host", "attacker.example:" + QByteArray::number(server.serverPort()) } })
+                            .first().status;
+    const int noToken = post(network, base + "/convert?upload=1&rehost=1", { docs.first() }).first().status;
+    std::printf("web      Origin: HTTP %d, other Host: HTTP %d, upload without token: HTTP %d\n",
+                fromPage, rebound, noToken);
+    ok &= check(fromPage == 403 && rebound == 403 && noToken == 403,
+                "web pages and uploads without the token are refused");
+
+    std::printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+// Typing latency in the source pane on Word HTML that arrives as one line:
+// the old pane (QTextEdit, regex highlighter, lines as pasted) against the
+// current one (QPlainTextEdit, ImageMarkerHighlighter, LineBreaker).
+//
+//   bench_source [--all] [MiB ...]      (default: 1 10 50)
+//
+// A sample is one character typed in the middle of the document and the
+// repaint that follows. The old pane takes seconds per keystroke on large
+// documents, so it is only measured up to 10 MiB unless --all is given.
+
+#include "HtmlDocument.h"
+#include "ImageMarkerHighlighter.h"
+#include "LineBreaker.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QPlainTextEdit>
+#include <QRegularExpression>
+#include <QSyntaxHighlighter>
+#include <QTextEdit>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// The highlighter the source pane used before
+class RegexHighlighter : public QSyntaxHighlighter {
+public:
+    explicit RegexHighlighter(QTextDocument *doc)
+        : QSyntaxHighlighter(doc), _pattern(QStringLiteral("\\[Image omitted #\\d+\\]")) {
+        _format.setBackground(Qt::yellow);
+    }
+
+protected:
+    void highlightBlock(const QString &text) override {
+        auto it = _pattern.globalMatch(text);
+        while (it.hasNext()) {
+            auto m = it.next();
+            setFormat(m.capturedStart(), m.capturedLength(), _format);
+        }
+    }
+
+private:
+    QRegularExpression _pattern;
+    QTextCharFormat    _format;
+};
+
+// Word-style HTML without a single line break, one image per 20 paragraphs
+static QString makeDocument(qint64 bytes) {
+    QString html = QStringLiteral(
+        "<html><head><style>p.MsoNormal { margin: 0 0 8px 0; }</style></head>"
+        "<body><div class=WordSection1>");
+    int i = 0;
+    while (html.size() * 2 < bytes) {
+        html += QStringLiteral("<p class=MsoNormal style='margin-bottom:0cm'><span lang=EN-US>"
+                               "Paragraph %1. <b>Lorem ipsum</b> dolor sit amet, consectetur "
+                               "adipiscing elit, sed do eiusmod tempor incididunt ut labore et "
+                               "dolore magna aliqua.</span></p>").arg(i);
+        if (i % 20 == 19)
+            html += QStringLiteral("<p class=MsoNormal><img width=320 height=240 "
+                                   "src=\"img:%1\"></p>").arg(i, 40, 10, QChar(u'0'));
+        ++i;
+    }
+    html += QStringLiteral("</div></body></html>");
+    return html;
+}
+
+static qsizetype longestLine(const QString &text) {
+    qsizetype longest = 0, start = 0;
+    for (qsizetype end; (end = text.indexOf(u'\n', start)) >= 0; start = end + 1)
+        longest = qMax(longest, end - start);
+    return qMax(longest, text.size() - start);
+}
+
+static double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+struct Sample {
+    double loadMs = 0;
+    double keyMs = 0;
+    int    blocks = 0;
+};
+
+template <typename Edit>
+static Sample measure(Edit &edit, const QString &text) {
+    const int keystrokes = 20;
+    Sample s;
+    QElapsedTimer t;
+    t.start();
+    edit.setPlainText(text);
+    edit.viewport()->repaint();
+    s.loadMs = t.nsecsElapsed() / 1e6;
+    s.blocks = edit.document()->blockCount();
+
+    QTextCursor c(edit.document());
+    c.setPosition(int(text.indexOf(QLatin1String("Lorem"), text.size() / 2)));
+    edit.setTextCursor(c);
+    edit.ensureCursorVisible();
+    edit.viewport()->repaint();
+
+    std::vector<double> ms;
+    for (int k = 0; k < keystrokes; ++k) {
+        t.restart();
+        edit.textCursor().insertText(QStringLiteral("x"));
+        edit.viewport()->repaint();
+        ms.push_back(t.nsecsElapsed() / 1e6);
+    }
+    s.keyMs = median(ms);
+    return s;
+}
+
+int main(int argc, char **argv) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    bool all = false;
+    std::vector<double> sizes;
+    for (int i = 1; i < argc; ++i) {
+        if (QByteArray(argv[i]) == "--all") all = true;
+        else sizes.push_back(std::atof(argv[i]));
+    }
+    if (sizes.empty()) sizes = { 1, 10, 50 };
+
+    std::printf("%8s %10s %12s %12s %10s %12s %12s\n", "MiB", "old lines", "old load ms",
+                "old ms/key", "lines", "load ms", "ms/key");
+    for (double mib : sizes) {
+        const QString html = makeDocument(qint64(mib * 1024 * 1024));
+
+        Sample old;
+        const bool measureOld = all || mib <= 10;
+        if (measureOld) {
+            QTextEdit edit;
+            edit.setAcceptRichText(false);
+            edit.resize(800, 600);
+            edit.show();
+            RegexHighlighter highlighter(edit.document());
+            // As pasted: markers in place, but no line breaks around them
+            QString text = HtmlDocument(html).masked();
+            text.remove(u'\n');
+            if (longestLine(text) != text.size()) {
+                std::fprintf(stderr, "old pane text is not one line\n");
+                return 1;
+            }
+            old = measure(edit, text);
+        }
+
+        QPlainTextEdit edit;
+        edit.resize(800, 600);
+        edit.show();
+        ImageMarkerHighlighter highlighter(edit.document());
+        const Sample cur = measure(edit, HtmlDocument(LineBreaker::breakLines(html, 200)).masked());
+
+        if (measureOld)
+            std::printf("%8.1f %10d %12.1f %12.2f", mib, old.blocks, old.loadMs, old.keyMs);
+        else
+            std::printf("%8.1f %10s %12s %12s", mib, "-", "-", "-");
+        std::printf(" %10d %12.1f %12.2f\n", cur.blocks, cur.loadMs, cur.keyMs);
+    }
+    return 0;
+}
@@ -0,0 +1,202 @@
+// STS credential caching against a local mock STS endpoint, counting how
+// often it is asked:
+//
+//   reuse         credentials far from expiry serve a whole series of
+//                 callers with one request and one signed policy
+//   concurrent    callers that arrive together while nothing is cached
+//                 share one request
+//   refresh       credentials inside 2 x refresh_margin_secs of expiry are
+//                 still handed out at once, while one new set is fetched in
+//                 the background
+//   expired       credentials that arrive inside the margin are not handed
+//                 out; the next caller asks again
+//   invalidated   after invalidate(), which UploadQueue calls when OSS
+//                 answers 403, the next caller fetches a new set
+//
+// Exits with status 1 if any check fails.
+
+#include "Config.h"
+#include "StsCache.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+#include <cstdio>
+#include <functional>
+
+static constexpr qint64 MarginSecs = 30;
+
+// Answers every request with credentials that expire lifetimeSecs from now
+// and closes the connection.
+class MockSts {
+public:
+    bool start() {
+        if (!_server.listen(QHostAddress::LocalHost)) return false;
+        QObject::connect(&_server, &QTcpServer::newConnection, [this]() {
+            while (QTcpSocket *socket = _server.nextPendingConnection()) {
+                QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() { serve(socket); });
+                QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            }
+        });
+        return true;
+    }
+
+    QString url() const { return QStringLiteral("http://127.0.0.1:%1/sts").arg(_server.serverPort()); }
+
+    qint64 lifetimeSecs = 3600;
+    int    requests = 0;
+
+private:
+    void serve(QTcpSocket *socket) {
+        while (socket->canReadLine()) {
+            if (socket->readLine() != "\r\n") continue;  // request line and headers
+            ++requests;
+            const QJsonObject data{
+                { "accessKeyId", "mock-id" },
+                { "accessKeySecret", "mock-secret" },
+                { "securityToken", "mock-token" },
+                { "expiration", QDateTime::currentDateTimeUtc().addSecs(lifetimeSecs).toString(Qt::ISODate) },
+            };
+            const QByteArray body = QJsonDocument(QJsonObject{ { "data", data } }).toJson(QJsonDocument::Compact);
+            socket->write("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\n"
+                          "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body);
+            socket->disconnectFromHost();
+        }
+    }
+
+    QTcpServer _server;
+};
+
+// Spins the event loop until done() holds or ten seconds have passed.
+static bool waitFor(const std::function<bool()> &done) {
+    QElapsedTimer t;
+    t.start();
+    while (!done() && t.elapsed() < 10000)
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 20);
+    return done();
+}
+
+static bool check(bool ok, const char *what) {
+    if (!ok) std::fprintf(stderr, "FAILED: %s\n", what);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+
+    QTemporaryDir work;
+    QDir::setCurrent(work.path());
+    MockSts server;
+    if (!server.start()) return 1;
+    QSettings &cfg = Config::settings();
+    cfg.setValue("oss/sts_url", server.url());
+    cfg.setValue("sts/refresh_margin_secs", MarginSecs);
+
+    QNetworkAccessManager network;
+    bool ok = true;
+    std::printf("%-12s %8s %10s\n", "scenario", "callers", "STS hits");
+    auto report = [&server](const char *name, int callers) {
+        std::printf("%-12s %8d %10d\n", name, callers, server.requests);
+    };
+
+    // Reuse: one fetch, then every caller answered from the cache
+    {
+        server.lifetimeSecs = 3600;
+        server.requests = 0;
+        StsCache sts(&network);
+        int answered = 0;
+        QSet<QByteArray> signatures;
+        auto done = [&](const StsCredentials &creds, const QString &) {
+            answered += !creds.isNull();
+            signatures.insert(creds.signature);
+        };
+        sts.acquire(&sts, done);
+        ok &= check(waitFor([&answered]() { return answered == 1; }), "the first caller gets credentials");
+        for (int i = 0; i < 10; ++i)
+            sts.acquire(&sts, done);
+        ok &= check(answered == 11, "cached credentials are handed out at once");
+        QCoreApplication::processEvents();
+        report("reuse", 11);
+        ok &= check(server.requests == 1, "credentials far from expiry are fetched once");
+        ok &= check(signatures.size() == 1, "every caller gets the same signed policy");
+    }
+
+    // Concurrent: every caller waits on the same request
+    {
+        server.requests = 0;
+        StsCache sts(&network);
+        int answered = 0;
+        for (int i = 0; i < 20; ++i)
+            sts.acquire(&sts, [&answered](const StsCredentials &creds, const QString &) { answered += !creds.isNull(); });
+        ok &= check(waitFor([&answered]() { return answered == 20; }), "every concurrent caller gets credentials");
+        report("concurrent", 20);
+        ok &= check(server.requests == 1, "concurrent callers share one fetch");
+    }
+
+    // Refresh: usable for now, but close enough to expiry to renew ahead
+    {
+        server.lifetimeSecs = MarginSecs + MarginSecs / 2;
+        server.requests = 0;
+        StsCache sts(&network);
+        int answered = 0;
+        bool refreshed = false;
+        QObject::connect(&sts, &StsCache::refreshed, [&refreshed]() { refreshed = true; });
+        auto done = [&answered](const StsCredentials &creds, const QString &) { answered += !creds.isNull(); };
+        sts.acquire(&sts, done);
+        ok &= check(waitFor([&refreshed]() { return refreshed; }), "the first caller gets credentials");
+        refreshed = false;
+        for (int i = 0; i < 5; ++i)
+            sts.acquire(&sts, done);
+        ok &= check(answered == 6, "credentials in the refresh window are still handed out at once");
+        ok &= check(waitFor([&refreshed]() { return refreshed; }), "a new set is fetched in the background");
+        report("refresh", 6);
+        ok &= check(server.requests == 2, "the background refresh is fetched once");
+    }
+
+    // Expired: the STS hands out credentials already inside the margin
+    {
+        server.lifetimeSecs = MarginSecs / 2;
+        server.requests = 0;
+        StsCache sts(&network);
+        int answered = 0, usable = 0;
+        auto done = [&](const StsCredentials &creds, const QString &) {
+            ++answered;
+            usable += !creds.isNull();
+        };
+        sts.acquire(&sts, done);
+        ok &= check(waitFor([&answered]() { return answered == 1; }), "the first caller is answered");
+        sts.acquire(&sts, done);
+        ok &= check(waitFor([&answered]() { return answered == 2; }), "the second caller is answered");
+        report("expired", 2);
+        ok &= check(usable == 0, "credentials inside the margin are not handed out");
+        ok &= check(server.requests == 2, "each caller asks again");
+    }
+
+    // Invalidated: what a 403 from OSS does to the cache
+    {
+        server.lifetimeSecs = 3600;
+        server.requests = 0;
+        StsCache sts(&network);
+        int answered = 0;
+        auto done = [&answered](const StsCredentials &creds, const QString &) { answered += !creds.isNull(); };
+        sts.acquire(&sts, done);
+        ok &= check(waitFor([&answered]() { return answered == 1; }), "the first caller gets credentials");
+        sts.invalidate();
+        sts.acquire(&sts, done);
+        ok &= check(waitFor([&answered]() { return answered == 2; }), "the caller after invalidate() gets credentials");
+        report("invalidated", 2);
+        ok &= check(server.requests == 2, "invalidate() drops the credentials and one new set is fetched");
+    }
+
+    std::printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
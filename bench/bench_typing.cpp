@@ -0,0 +1,98 @@
+// Typing latency in the preview: one keystroke in the middle of a large
+// document, re-rendered with a full setHtml() versus PreviewRenderer.
+//
+//   bench_typing [MiB ...]      (default: 1 5)
+//
+// Each sample includes the layout of the document, as the preview pane
+// would need it before painting.
+
+#include "PreviewRenderer.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QTextDocument>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static QString makeDocument(qint64 bytes) {
+    QString html = QStringLiteral(
+        "<html><head><style>p.MsoNormal { margin: 0 0 8px 0; } "
+        "h2 { color: #1f3864; }</style></head><body><div class=WordSection1>\n");
+    int i = 0;
+    while (html.size() * 2 < bytes) {
+        if (i % 25 == 0)
+            html += QStringLiteral("<h2>Section %1</h2>\n").arg(i / 25 + 1);
+        html += QStringLiteral("<p class=MsoNormal>Paragraph %1. <b>Lorem ipsum</b> dolor sit amet, "
+                               "consectetur adipiscing elit, sed do eiusmod tempor incididunt ut "
+                               "labore et dolore magna aliqua.</p>\n").arg(i);
+        if (i % 40 == 39)
+            html += QStringLiteral("<table border=1><tr><td>a %1</td><td>b</td></tr>"
+                                   "<tr><td>c</td><td>d</td></tr></table>\n").arg(i);
+        ++i;
+    }
+    html += QStringLiteral("</div></body></html>");
+    return html;
+}
+
+static void layout(QTextDocument &doc) {
+    doc.documentLayout()->documentSize();
+}
+
+static double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+int main(int argc, char **argv) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    std::vector<double> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::atof(argv[i]));
+    if (sizes.empty()) sizes = { 1, 5 };
+
+    const int keystrokes = 20;
+    std::printf("%8s %10s %14s %14s %14s\n",
+                "MiB", "chunks", "initial ms", "setHtml ms/key", "renderer ms/key");
+    for (double mib : sizes) {
+        QString html = makeDocument(qint64(mib * 1024 * 1024));
+        const qsizetype at = html.indexOf(QLatin1String("Lorem"), html.size() / 2);
+
+        QTextDocument full;
+        full.setTextWidth(800);
+        QTextDocument inc;
+        inc.setTextWidth(800);
+        PreviewRenderer renderer(&inc);
+
+        QElapsedTimer t;
+        t.start();
+        renderer.render(html);
+        layout(inc);
+        const double initialMs = t.nsecsElapsed() / 1e6;
+        full.setHtml(html);
+        layout(full);
+
+        std::vector<double> fullMs, incMs;
+        for (int k = 0; k < keystrokes; ++k) {
+            html.insert(at + k, QChar(u'x'));
+
+            t.restart();
+            full.setHtml(html);
+            layout(full);
+            fullMs.push_back(t.nsecsElapsed() / 1e6);
+
+            t.restart();
+            renderer.render(html);
+            layout(inc);
+            incMs.push_back(t.nsecsElapsed() / 1e6);
+        }
+
+        std::printf("%8.1f %10d %14.2f %14.2f %14.2f\n", mib, renderer.chunkCount(),
+                    initialMs, median(fullMs), median(incMs));
+    }
+    return 0;
+}
@@ -0,0 +1,164 @@
+// Peak memory of uploading one large image: the old path, which kept the
+// image as a data URI and assembled the multipart body in a QByteArray,
+// against UploadQueue streaming the stored bytes as one form upload
+// ("streamed") and through the OSS multipart API in parts ("multipart").
+//
+//   bench_upload [MiB]            (default: 40)
+//
+// Peak RSS only ever grows, so each path runs in its own child process.
+// The upload goes to StandInServer, which discards the body as it arrives.
+
+#include "Config.h"
+#include "ImageStore.h"
+#include "ProcessMemory.h"
+#include "StandInServer.h"
+#include "StsCache.h"
+#include "UploadQueue.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+#include <cstdio>
+#include <cstdlib>
+
+static constexpr qint64 MiB = 1024 * 1024;
+
+// Random bytes, filled in place so setup does not peak above the result.
+static QByteArray randomBytes(qint64 size) {
+    QByteArray bytes(size, Qt::Uninitialized);
+    QRandomGenerator rng(42);
+    rng.fillRange(reinterpret_cast<quint32 *>(bytes.data()), size / 4);
+    return bytes;
+}
+
+// The image as the old document held it, built in slices for the same reason.
+static QString dataUri(qint64 size) {
+    static const qint64 Slice = 3 * 1024 * 256;
+    const QByteArray slice = randomBytes(Slice);
+    QString uri;
+    uri.reserve(32 + (size + 2) / 3 * 4);
+    uri += QLatin1String("data:image/jpeg;base64,");
+    for (qint64 done = 0; done < size; done += Slice)
+        uri += QLatin1String(slice.left(qMin(Slice, size - done)).toBase64());
+    return uri;
+}
+
+static bool waitFor(QNetworkReply *reply) {
+    while (!reply->isFinished())
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 50);
+    return reply->error() == QNetworkReply::NoError;
+}
+
+// What confirmAndUpload and uploadToOss did before UploadQueue: copy the
+// base64 out of the URI, decode it, then append it to the form body.
+static bool uploadBuffered(QNetworkAccessManager &network, qint64 size) {
+    const QString uri = dataUri(size);
+    std::printf("setup %lld\n", ProcessMemory::peakRss());
+    std::fflush(stdout);
+
+    QByteArray b64 = uri.section(',', 1).toLatin1();
+    QByteArray bytes = QByteArray::fromBase64(b64);
+    const QByteArray boundary = "----formdata-qt-bench";
+    QByteArray body;
+    body += "--" + boundary + "\r\nContent-Disposition: form-data; name=\"key\"\r\n\r\nbench\r\n";
+    body += "--" + boundary + "\r\nContent-Disposition: form-data; name=\"file\"; "
+            "filename=\"image.jpeg\"\r\nContent-Type: image/jpeg\r\n\r\n";
+    body += bytes;
+    body += "\r\n--" + boundary + "--\r\n";
+
+    QNetworkRequest req((QUrl(Config::ossUploadUrl())));
+    req.setHeader(QNetworkRequest::ContentTypeHeader, "multipart/form-data; boundary=" + boundary);
+    QNetworkReply *reply = network.post(req, body);
+    const bool ok = waitFor(reply);
+    reply->deleteLater();
+    return ok;
+}
+
+static bool uploadStreamed(QNetworkAccessManager &network, qint64 size) {
+    ImageStore store;
+    const QString handle = store.insert(randomBytes(size), QStringLiteral("image/jpeg"));
+    std::printf("setup %lld\n", ProcessMemory::peakRss());
+    std::fflush(stdout);
+
+    StsCache sts(&network);
+    UploadQueue queue(&network, &sts);
+    bool done = false;
+    int succeeded = 0;
+    QObject::connect(&queue, &UploadQueue::finished, [&](int ok, int) {
+        succeeded = ok;
+        done = true;
+    });
+    queue.start({ handle }, store);
+    while (!done)
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 50);
+    return succeeded == 1;
+}
+
+static int child(const QString &mode, qint64 size) {
+    QTemporaryDir work;
+    QDir::setCurrent(work.path());
+    StandInServer server;
+    if (!server.start()) return 1;
+    QSettings &cfg = Config::settings();
+    cfg.setValue("oss/sts_url", server.baseUrl() + "/sts");
+    cfg.setValue("oss/oss_upload_url", server.baseUrl() + "/upload");
+    cfg.setValue("oss/oss_base_url", server.baseUrl() + "/oss");
+    // "streamed" measures the single form body, so it must stay below the
+    // multipart threshold; "multipart" goes over it
+    cfg.setValue("upload/multipart_threshold_mb", mode == "multipart" ? 1 : size / MiB + 1);
+    cfg.setValue("upload/part_size_mb", 4);
+
+    QNetworkAccessManager network;
+    QElapsedTimer t;
+    t.start();
+    bool ok = mode == "buffered" ? uploadBuffered(network, size) : uploadStreamed(network, size);
+    // The path taken must be the one the row claims
+    ok = ok && (mode == "multipart") == (server.stats().parts > 0);
+    std::printf("peak %lld\nms %lld\nok %d\n", ProcessMemory::peakRss(), t.elapsed(), ok);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+
+    if (args.size() > 2 && args[1].startsWith("--child="))
+        return child(args[1].mid(8), args[2].toLongLong());
+
+    const qint64 size = (args.size() > 1 ? args[1].toLongLong() : 40) * MiB;
+    if (ProcessMemory::peakRss() < 0) {
+        std::fprintf(stderr, "peak RSS is not available on this platform\n");
+        return 1;
+    }
+
+    std::printf("%-10s %10s %14s %14s %12s %8s\n",
+                "path", "image MiB", "setup MiB", "peak MiB", "upload MiB", "ms");
+    for (const QString mode : { "buffered", "streamed", "multipart" }) {
+        QProcess p;
+        p.start(app.applicationFilePath(), { "--child=" + mode, QString::number(size) });
+        p.waitForFinished(-1);
+
+        qint64 setup = 0, peak = 0, ms = 0;
+        bool ok = false;
+        for (const QByteArray &line : p.readAllStandardOutput().split('\n')) {
+            const QList<QByteArray> kv = line.split(' ');
+            if (kv.size() != 2) continue;
+            if (kv[0] == "setup") setup = kv[1].toLongLong();
+            else if (kv[0] == "peak") peak = kv[1].toLongLong();
+            else if (kv[0] == "ms") ms = kv[1].toLongLong();
+            else if (kv[0] == "ok") ok = kv[1] == "1";
+        }
+        // upload MiB is what the upload itself added on top of the image
+        std::printf("%-10s %10lld %14.1f %14.1f %12.1f %8lld%s\n", qPrintable(mode), size / MiB,
+                    double(setup) / MiB, double(peak) / MiB, double(peak - setup) / MiB, ms,
+                    ok ? "" : "  (failed)");
+    }
+    return 0;
+}
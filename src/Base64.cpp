@@ -0,0 +1,397 @@
+#include "Base64.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define BASE64_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define BASE64_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang compile each vector kernel for its own instruction set, so
+// the rest of the file keeps the baseline flags; MSVC needs no attribute.
+#if defined(__GNUC__) || defined(__clang__)
+#define BASE64_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BASE64_TARGET(isa)
+#endif
+
+using uchar = unsigned char;
+
+static const char Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// 0..63 for alphabet characters, -1 for everything else
+struct DecodeTable {
+    signed char value[256];
+    constexpr DecodeTable() : value() {
+        for (int i = 0; i < 256; ++i) value[i] = -1;
+        for (int i = 0; i < 64; ++i) value[uchar(Alphabet[i])] = static_cast<signed char>(i);
+    }
+};
+static constexpr DecodeTable Decode;
+
+// Scalar tails. Both finish whatever the vector kernels left over.
+
+static void encodeScalar(const uchar *&s, const uchar *end, char *&o) {
+    for (; end - s >= 3; s += 3) {
+        const unsigned v = unsigned(s[0]) << 16 | unsigned(s[1]) << 8 | s[2];
+        *o++ = Alphabet[v >> 18];
+        *o++ = Alphabet[(v >> 12) & 63];
+        *o++ = Alphabet[(v >> 6) & 63];
+        *o++ = Alphabet[v & 63];
+    }
+    if (end - s == 1) {
+        const unsigned v = unsigned(s[0]) << 16;
+        *o++ = Alphabet[v >> 18];
+        *o++ = Alphabet[(v >> 12) & 63];
+        *o++ = '=';
+        *o++ = '=';
+        ++s;
+    } else if (end - s == 2) {
+        const unsigned v = unsigned(s[0]) << 16 | unsigned(s[1]) << 8;
+        *o++ = Alphabet[v >> 18];
+        *o++ = Alphabet[(v >> 12) & 63];
+        *o++ = Alphabet[(v >> 6) & 63];
+        *o++ = '=';
+        s += 2;
+    }
+}
+
+// Consumes one character the way QByteArray::fromBase64() does: anything
+// outside the alphabet, padding included, is skipped.
+struct DecodeState {
+    unsigned buf = 0;
+    int      nbits = 0;
+};
+
+static inline void decodeChar(DecodeState &st, char c, uchar *&o) {
+    const int d = Decode.value[uchar(c)];
+    if (d < 0) return;
+    st.buf = (st.buf << 6) | unsigned(d);
+    st.nbits += 6;
+    if (st.nbits >= 8) {
+        st.nbits -= 8;
+        *o++ = uchar(st.buf >> st.nbits);
+        st.buf &= (1u << st.nbits) - 1;
+    }
+}
+
+#if defined(BASE64_X86)
+
+// Vector kernels after Muła and Lemire, "Faster Base64 Encoding and
+// Decoding using AVX2 Instructions" (2018). Each stops before the first
+// block that is short or holds a character outside the alphabet.
+
+BASE64_TARGET("sse4.1")
+static inline __m128i encodeTranslate128(__m128i in) {
+    // Offsets from 6-bit values to ASCII for A-Z, a-z, 0-9, '+' and '/'
+    const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    __m128i indices = _mm_subs_epu8(in, _mm_set1_epi8(51));
+    indices = _mm_sub_epi8(indices, _mm_cmpgt_epi8(in, _mm_set1_epi8(25)));
+    return _mm_add_epi8(in, _mm_shuffle_epi8(lut, indices));
+}
+
+BASE64_TARGET("sse4.1")
+static void encodeSse41(const uchar *&s, const uchar *end, char *&o) {
+    const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    // Reads 16 bytes, uses 12
+    while (end - s >= 16) {
+        __m128i in = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s)), shuffle);
+        const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+        const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+        const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(o), encodeTranslate128(_mm_or_si128(t1, t3)));
+        s += 12;
+        o += 16;
+    }
+}
+
+BASE64_TARGET("sse4.1")
+static void decodeSse41(const char *&s, const char *end, uchar *&o) {
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2F = _mm_set1_epi8(0x2F);
+    // Reads 16 characters, writes 16 bytes of which 12 are output
+    while (end - s >= 16) {
+        __m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+        const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask2F);
+        const __m128i loNibbles = _mm_and_si128(str, mask2F);
+        const __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        const __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+        if (!_mm_testz_si128(lo, hi)) break;
+
+        const __m128i eq2F = _mm_cmpeq_epi8(str, mask2F);
+        str = _mm_add_epi8(str, _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles)));
+        const __m128i merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+        const __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(o),
+                         _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                                                -1, -1, -1, -1)));
+        s += 16;
+        o += 12;
+    }
+}
+
+BASE64_TARGET("avx2")
+static void encodeAvx2(const uchar *&s, const uchar *end, char *&o) {
+    // Each 128-bit lane takes 12 bytes, so the load starts 4 bytes early;
+    // the first block is loaded in place and shifted instead.
+    const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                            14, 15, 13, 14, 11, 12, 10, 11, 8, 9, 7, 8, 5, 6, 4, 5);
+    const __m256i lut = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+                                         65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    bool first = true;
+    while (end - s >= 32) {
+        __m256i in;
+        if (first) {
+            in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+            in = _mm256_permutevar8x32_epi32(in, _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6));
+            first = false;
+        } else {
+            in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s - 4));
+        }
+        in = _mm256_shuffle_epi8(in, shuffle);
+        const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+        const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+        const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        const __m256i v = _mm256_or_si256(t1, t3);
+
+        __m256i indices = _mm256_subs_epu8(v, _mm256_set1_epi8(51));
+        indices = _mm256_sub_epi8(indices, _mm256_cmpgt_epi8(v, _mm256_set1_epi8(25)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(o),
+                            _mm256_add_epi8(v, _mm256_shuffle_epi8(lut, indices)));
+        s += 24;
+        o += 32;
+    }
+}
+
+BASE64_TARGET("avx2")
+static void decodeAvx2(const char *&s, const char *end, uchar *&o) {
+    const __m256i lutLo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                           0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                           0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                           0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lutHi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                           0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                           0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                           0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lutRoll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                             0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask2F = _mm256_set1_epi8(0x2F);
+    // Reads 32 characters, writes 32 bytes of which 24 are output
+    while (end - s >= 32) {
+        __m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+        const __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask2F);
+        const __m256i loNibbles = _mm256_and_si256(str, mask2F);
+        const __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+        const __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+        if (!_mm256_testz_si256(lo, hi)) break;
+
+        const __m256i eq2F = _mm256_cmpeq_epi8(str, mask2F);
+        str = _mm256_add_epi8(str, _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles)));
+        const __m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        __m256i packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        packed = _mm256_shuffle_epi8(packed, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                              2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(o), packed);
+        s += 32;
+        o += 24;
+    }
+}
+
+static bool cpuHas(Base64::Kernel kernel) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int r[4];
+    __cpuid(r, 0);
+    const int maxLeaf = r[0];
+    __cpuid(r, 1);
+    const bool sse41 = r[2] & (1 << 19);
+    const bool osxsave = r[2] & (1 << 27);
+    const bool avx = r[2] & (1 << 28);
+    if (kernel == Base64::Kernel::Sse41) return sse41;
+    if (!osxsave || !avx || maxLeaf < 7) return false;
+    // The OS must save the YMM registers
+    if ((_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(r, 7, 0);
+    return r[1] & (1 << 5);
+#else
+    __builtin_cpu_init();
+    if (kernel == Base64::Kernel::Sse41) return __builtin_cpu_supports("sse4.1");
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // BASE64_X86
+
+#if defined(BASE64_NEON)
+
+static void encodeNeon(const uchar *&s, const uchar *end, char *&o) {
+    const uint8x16x4_t lut = { { vld1q_u8(reinterpret_cast<const uchar *>(Alphabet)),
+                                 vld1q_u8(reinterpret_cast<const uchar *>(Alphabet) + 16),
+                                 vld1q_u8(reinterpret_cast<const uchar *>(Alphabet) + 32),
+                                 vld1q_u8(reinterpret_cast<const uchar *>(Alphabet) + 48) } };
+    const uint8x16_t mask3F = vdupq_n_u8(0x3F);
+    // 48 bytes in, de-interleaved into three registers; 64 characters out
+    while (end - s >= 48) {
+        const uint8x16x3_t in = vld3q_u8(s);
+        uint8x16x4_t idx;
+        idx.val[0] = vshrq_n_u8(in.val[0], 2);
+        idx.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[1], 4), vshlq_n_u8(in.val[0], 4)), mask3F);
+        idx.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[2], 6), vshlq_n_u8(in.val[1], 2)), mask3F);
+        idx.val[3] = vandq_u8(in.val[2], mask3F);
+        uint8x16x4_t out;
+        for (int i = 0; i < 4; ++i)
+            out.val[i] = vqtbl4q_u8(lut, idx.val[i]);
+        vst4q_u8(reinterpret_cast<uchar *>(o), out);
+        s += 48;
+        o += 64;
+    }
+}
+
+static void decodeNeon(const char *&s, const char *end, uchar *&o) {
+    // Values for ASCII 0-63 and 64-127, 0xFF where not in the alphabet.
+    // Out-of-range table lookups give 0, so each half only answers for
+    // its own characters and the two results can be or-ed together.
+    uchar table[128];
+    for (int i = 0; i < 128; ++i) table[i] = uchar(Decode.value[i]);
+    const uint8x16x4_t lo = { { vld1q_u8(table), vld1q_u8(table + 16),
+                                vld1q_u8(table + 32), vld1q_u8(table + 48) } };
+    const uint8x16x4_t hi = { { vld1q_u8(table + 64), vld1q_u8(table + 80),
+                                vld1q_u8(table + 96), vld1q_u8(table + 112) } };
+    const uint8x16_t offset = vdupq_n_u8(64);
+    // 64 characters in, de-interleaved into four registers; 48 bytes out
+    while (end - s >= 64) {
+        const uint8x16x4_t str = vld4q_u8(reinterpret_cast<const uchar *>(s));
+        uint8x16x4_t d;
+        uint8x16_t bad = vdupq_n_u8(0);
+        for (int i = 0; i < 4; ++i) {
+            d.val[i] = vorrq_u8(vqtbl4q_u8(lo, str.val[i]),
+                                vqtbl4q_u8(hi, vsubq_u8(str.val[i], offset)));
+            // Bit 7 marks both 0xFF entries and non-ASCII input
+            bad = vorrq_u8(bad, vorrq_u8(d.val[i], str.val[i]));
+        }
+        if (vmaxvq_u8(bad) & 0x80) break;
+
+        uint8x16x3_t out;
+        out.val[0] = vorrq_u8(vshlq_n_u8(d.val[0], 2), vshrq_n_u8(d.val[1], 4));
+        out.val[1] = vorrq_u8(vshlq_n_u8(d.val[1], 4), vshrq_n_u8(d.val[2], 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(d.val[2], 6), d.val[3]);
+        vst3q_u8(o, out);
+        s += 64;
+        o += 48;
+    }
+}
+
+#endif // BASE64_NEON
+
+using EncodeKernel = void (*)(const uchar *&, const uchar *, char *&);
+using DecodeKernel = void (*)(const char *&, const char *, uchar *&);
+
+static EncodeKernel encodeKernel(Base64::Kernel kernel) {
+    switch (kernel) {
+#if defined(BASE64_X86)
+    case Base64::Kernel::Sse41: return encodeSse41;
+    case Base64::Kernel::Avx2:  return encodeAvx2;
+#elif defined(BASE64_NEON)
+    case Base64::Kernel::Neon:  return encodeNeon;
+#endif
+    default: return nullptr;
+    }
+}
+
+static DecodeKernel decodeKernel(Base64::Kernel kernel) {
+    switch (kernel) {
+#if defined(BASE64_X86)
+    case Base64::Kernel::Sse41: return decodeSse41;
+    case Base64::Kernel::Avx2:  return decodeAvx2;
+#elif defined(BASE64_NEON)
+    case Base64::Kernel::Neon:  return decodeNeon;
+#endif
+    default: return nullptr;
+    }
+}
+
+bool Base64::isSupported(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Scalar: return true;
+#if defined(BASE64_X86)
+    case Kernel::Sse41:
+    case Kernel::Avx2: {
+        static const bool sse41 = cpuHas(Kernel::Sse41);
+        static const bool avx2 = cpuHas(Kernel::Avx2);
+        return kernel == Kernel::Sse41 ? sse41 : avx2;
+    }
+#elif defined(BASE64_NEON)
+    case Kernel::Neon: return true;
+#endif
+    default: return false;
+    }
+}
+
+QList<Base64::Kernel> Base64::supported() {
+    QList<Kernel> kernels;
+    for (Kernel k : { Kernel::Scalar, Kernel::Sse41, Kernel::Avx2, Kernel::Neon })
+        if (isSupported(k)) kernels << k;
+    return kernels;
+}
+
+Base64::Kernel Base64::best() {
+    static const Kernel kernel = supported().last();
+    return kernel;
+}
+
+const char *Base64::name(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Scalar: return "scalar";
+    case Kernel::Sse41:  return "sse4.1";
+    case Kernel::Avx2:   return "avx2";
+    case Kernel::Neon:   return "neon";
+    }
+    return "unknown";
+}
+
+QByteArray Base64::encode(QByteArrayView data, Kernel kernel) {
+    QByteArray out((data.size() + 2) / 3 * 4, Qt::Uninitialized);
+    const uchar *s = reinterpret_cast<const uchar *>(data.data());
+    const uchar *end = s + data.size();
+    char *o = out.data();
+    if (EncodeKernel k = isSupported(kernel) ? encodeKernel(kernel) : nullptr)
+        k(s, end, o);
+    encodeScalar(s, end, o);
+    Q_ASSERT(o == out.constData() + out.size());
+    return out;
+}
+
+QByteArray Base64::decode(QByteArrayView base64, Kernel kernel) {
+    // The vector kernels store whole registers; leave room past the output
+    static const qsizetype Slack = 32;
+    QByteArray out(base64.size() / 4 * 3 + 3 + Slack, Qt::Uninitialized);
+    const char *s = base64.data();
+    const char *end = s + base64.size();
+    uchar *o = reinterpret_cast<uchar *>(out.data());
+    const DecodeKernel k = isSupported(kernel) ? decodeKernel(kernel) : nullptr;
+
+    DecodeState st;
+    const char *scalarUntil = s;
+    while (s < end) {
+        // Vector blocks only start on a 4-character group; after a block
+        // that had stray characters, go past it before trying again.
+        if (k && st.nbits == 0 && s >= scalarUntil) {
+            k(s, end, o);
+            if (s >= end) break;
+            scalarUntil = s + 64;
+        }
+        decodeChar(st, *s++, o);
+    }
+    out.truncate(o - reinterpret_cast<uchar *>(out.data()));
+    return out;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QList>
+
+// Base64 for image data, with vector kernels picked at run time for the
+// CPU: AVX2 or SSE4.1 on x86, NEON on ARM64, scalar everywhere else.
+// Output is identical to QByteArray::toBase64() and fromBase64() with the
+// default options, including fromBase64() skipping characters outside the
+// alphabet.
+class Base64 {
+public:
+    enum class Kernel { Scalar, Sse41, Avx2, Neon };
+
+    // The fastest kernel this CPU supports.
+    static Kernel best();
+    static bool isSupported(Kernel kernel);
+    static QList<Kernel> supported();
+    static const char *name(Kernel kernel);
+
+    static QByteArray encode(QByteArrayView data, Kernel kernel = best());
+    static QByteArray decode(QByteArrayView base64, Kernel kernel = best());
+};
@@ -0,0 +1,195 @@
+#include "Config.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+#include <QtGlobal>
+
+QSettings &Config::settings() {
+    static QSettings settings(QStringLiteral("config.ini"), QSettings::IniFormat);
+    return settings;
+}
+
+QString Config::dataPath(const QString &fileName) {
+    return QFileInfo(settings().fileName()).absoluteDir().filePath(fileName);
+}
+
+QString Config::stsUrl() {
+    return settings().value("oss/sts_url").toString();
+}
+
+QString Config::ossUploadUrl() {
+    return settings().value("oss/oss_upload_url").toString();
+}
+
+QString Config::ossBaseUrl() {
+    return settings().value("oss/oss_base_url").toString();
+}
+
+int Config::uploadConcurrency() {
+    return qBound(1, settings().value("upload/concurrency", 8).toInt(), 32);
+}
+
+bool Config::uploadCacheEnabled() {
+    return settings().value("upload/cache", true).toBool();
+}
+
+bool Config::contentAddressedKeys() {
+    return settings().value("upload/content_addressed_keys", false).toBool();
+}
+
+QString Config::objectKeyPrefix() {
+    return settings().value("upload/key_prefix", "pc/course/dev").toString();
+}
+
+int Config::uploadRetries() {
+    return qBound(0, settings().value("upload/retries", 4).toInt(), 10);
+}
+
+int Config::uploadRetryBaseMs() {
+    return qBound(1, settings().value("upload/retry_base_ms", 500).toInt(), 60000);
+}
+
+int Config::uploadRetryMaxMs() {
+    return qBound(uploadRetryBaseMs(), settings().value("upload/retry_max_ms", 30000).toInt(), 600000);
+}
+
+int Config::uploadTimeoutSecs() {
+    return qBound(5, settings().value("upload/timeout_secs", 60).toInt(), 3600);
+}
+
+qint64 Config::multipartThresholdMb() {
+    return qMax<qint64>(1, settings().value("upload/multipart_threshold_mb", 8).toLongLong());
+}
+
+qint64 Config::multipartPartMb() {
+    return qBound<qint64>(1, settings().value("upload/part_size_mb", 4).toLongLong(), 1024);
+}
+
+bool Config::uploadJournalEnabled() {
+    return settings().value("upload/journal", true).toBool();
+}
+
+bool Config::rehostRemoteImages() {
+    return settings().value("upload/rehost_remote", false).toBool();
+}
+
+qint64 Config::rehostMaxMb() {
+    return qMax<qint64>(1, settings().value("upload/rehost_max_mb", 64).toLongLong());
+}
+
+int Config::previewSyncDelayMs() {
+    return qBound(0, settings().value("preview/sync_delay_ms", 150).toInt(), 5000);
+}
+
+qint64 Config::previewImageCacheMb() {
+    return qMax<qint64>(1, settings().value("preview/image_cache_mb", 128).toLongLong());
+}
+
+bool Config::previewThumbnails() {
+    return settings().value("preview/thumbnails", false).toBool();
+}
+
+int Config::sourceLineWidth() {
+    const int width = settings().value("source/line_width", 200).toInt();
+    return width <= 0 ? 0 : qMax(40, width);
+}
+
+int Config::externalConcurrency() {
+    return qBound(1, settings().value("external/concurrency", 6).toInt(), 32);
+}
+
+qint64 Config::externalMemoryCacheMb() {
+    return qMax<qint64>(1, settings().value("external/cache_mb", 64).toLongLong());
+}
+
+qint64 Config::externalDiskCacheMb() {
+    return qMax<qint64>(1, settings().value("external/disk_cache_mb", 256).toLongLong());
+}
+
+qint64 Config::stsLifetimeSecs() {
+    return qMax<qint64>(60, settings().value("sts/lifetime_secs", 900).toLongLong());
+}
+
+qint64 Config::stsRefreshMarginSecs() {
+    return qMax<qint64>(0, settings().value("sts/refresh_margin_secs", 120).toLongLong());
+}
+
+bool Config::optimizeImages() {
+    return settings().value("optimize/enabled", false).toBool();
+}
+
+QString Config::optimizeFormat() {
+    return settings().value("optimize/format", "keep").toString().toLower();
+}
+
+int Config::optimizeQuality() {
+    return qBound(1, settings().value("optimize/quality", 85).toInt(), 100);
+}
+
+bool Config::optimizeDownscale() {
+    return settings().value("optimize/downscale", true).toBool();
+}
+
+qreal Config::optimizeScale() {
+    return qBound(0.25, settings().value("optimize/scale", 1.0).toDouble(), 4.0);
+}
+
+bool Config::cleanWordHtml() {
+    return settings().value("clean/enabled", true).toBool();
+}
+
+bool Config::cleanOfficeMarkup() {
+    return settings().value("clean/office_markup", true).toBool();
+}
+
+bool Config::cleanComments() {
+    return settings().value("clean/comments", true).toBool();
+}
+
+bool Config::cleanMsoStyles() {
+    return settings().value("clean/styles", true).toBool();
+}
+
+bool Config::cleanLang() {
+    return settings().value("clean/lang", true).toBool();
+}
+
+bool Config::cleanEmptySpans() {
+    return settings().value("clean/empty_spans", true).toBool();
+}
+
+quint16 Config::serverPort() {
+    return quint16(qBound(1, settings().value("server/port", 8765).toInt(), 65535));
+}
+
+int Config::serverWorkers() {
+    const int n = settings().value("server/workers", 0).toInt();
+    return qBound(1, n > 0 ? n : QThread::idealThreadCount(), 64);
+}
+
+int Config::serverQueueLimit() {
+    return qBound(0, settings().value("server/queue", 64).toInt(), 4096);
+}
+
+qint64 Config::serverMaxBodyMb() {
+    return qMax<qint64>(1, settings().value("server/max_body_mb", 64).toLongLong());
+}
+
+QByteArray Config::serverToken() {
+    return settings().value("server/token").toString().toUtf8();
+}
+
+QString Config::serverFileRoot() {
+    const QString root = settings().value("server/file_root").toString();
+    return root.isEmpty() ? root : dataPath(root);
+}
+
+bool Config::traceEnabled() {
+    return settings().value("trace/enabled", false).toBool();
+}
+
+QString Config::traceFile() {
+    const QString name = settings().value("trace/file", "trace.json").toString();
+    return name.isEmpty() ? QString() : dataPath(name);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QSettings>
+#include <QString>
+
+// Settings loaded from config.ini in the working directory.
+class Config {
+public:
+    static QSettings &settings();
+
+    // Path of a file kept next to config.ini.
+    static QString dataPath(const QString &fileName);
+
+    static QString stsUrl();
+    static QString ossUploadUrl();
+    static QString ossBaseUrl();
+
+    // Maximum number of uploads in flight at once.
+    static int uploadConcurrency();
+    // Reuse URLs of images uploaded in earlier sessions.
+    static bool uploadCacheEnabled();
+    // Name objects after their content hash so identical images share one.
+    static bool contentAddressedKeys();
+    static QString objectKeyPrefix();
+    // Retries of a failed request, with the backoff doubling from base to
+    // max, and how long a request may make no progress before it fails.
+    static int uploadRetries();
+    static int uploadRetryBaseMs();
+    static int uploadRetryMaxMs();
+    static int uploadTimeoutSecs();
+    // Images above the threshold are uploaded in parts of part size.
+    static qint64 multipartThresholdMb();
+    static qint64 multipartPartMb();
+    // Record finished uploads so an interrupted batch resumes.
+    static bool uploadJournalEnabled();
+    // Copy images linked from other hosts to OSS along with the upload;
+    // larger images are not copied.
+    static bool rehostRemoteImages();
+    static qint64 rehostMaxMb();
+
+    // Delay after the last keystroke before the preview is updated.
+    static int previewSyncDelayMs();
+    // Decoded images kept for the preview, and whether images wider than
+    // the preview are shown as viewport-sized thumbnails.
+    static qint64 previewImageCacheMb();
+    static bool previewThumbnails();
+    // Pasted HTML is broken into lines of about this many characters for
+    // the source pane; 0 keeps the lines as they came.
+    static int sourceLineWidth();
+
+    // Parallel fetches and cache sizes for http(s) images in the preview.
+    static int externalConcurrency();
+    static qint64 externalMemoryCacheMb();
+    static qint64 externalDiskCacheMb();
+
+    // Assumed STS credential lifetime when the response has no expiration,
+    // and how long before expiry cached credentials stop being handed out.
+    static qint64 stsLifetimeSecs();
+    static qint64 stsRefreshMarginSecs();
+
+    // Downscale and re-encode pasted images before they are inlined.
+    static bool optimizeImages();
+    static QString optimizeFormat();  // keep, jpeg or png
+    static int optimizeQuality();
+    static bool optimizeDownscale();
+    static qreal optimizeScale();
+
+    // Strip Word-only markup from pasted HTML before it is converted.
+    static bool cleanWordHtml();
+    static bool cleanOfficeMarkup();
+    static bool cleanComments();
+    static bool cleanMsoStyles();
+    static bool cleanLang();
+    static bool cleanEmptySpans();
+
+    // The conversion service (convertrt --serve): its port on localhost,
+    // documents converted at once, how many more may wait, and the largest
+    // document accepted.
+    static quint16 serverPort();
+    static int serverWorkers();
+    static int serverQueueLimit();
+    static qint64 serverMaxBodyMb();
+    // The only directory whose files posted documents may link as images;
+    // empty (the default) reads no local files.
+    static QString serverFileRoot();
+    // Sent as X-Convertrt-Token to allow upload=1 and rehost=1; while
+    // empty (the default) the service uploads nothing.
+    static QByteArray serverToken();
+
+    // Record stage timings; the Chrome trace file is written next to
+    // config.ini on exit (none when the name is empty).
+    static bool traceEnabled();
+    static QString traceFile();
+};
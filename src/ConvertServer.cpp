@@ -0,0 +1,666 @@
+#include "ConvertServer.h"
+#include "Config.h"
+#include "Converter.h"
+#include "ImageStore.h"
+#include "ImgScanner.h"
+#include "RemoteRehoster.h"
+#include "RtfWriter.h"
+#include "Trace.h"
+#include "UploadQueue.h"
+
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QPointer>
+#include <QStringDecoder>
+#include <QStringEncoder>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QWaitCondition>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtNetwork/QTcpSocket>
+#include <algorithm>
+#include <utility>
+
+static const QStringList Formats = { "inline", "masked", "rtf" };
+
+// Bytes a connection holds unread while its previous request is in work
+static constexpr qint64 ReadBufferSize = 1024 * 1024;
+static constexpr qint64 MaxHeaderSize = 64 * 1024;
+// Size of the chunks an answer goes out in, and how much of it may wait
+// in the socket before the worker writing it is held up
+static constexpr qint64 ChunkSize = 64 * 1024;
+static constexpr qint64 SendBufferLimit = 4 * 1024 * 1024;
+// Samples per stage kept for the percentiles
+static constexpr int Recent = 1024;
+
+struct ConvertServer::Job {
+    QPointer<QTcpSocket> socket;
+    QByteArray body;
+    QString    format;
+    bool       upload = false;
+    bool       rehost = false;
+    bool       clean = true;
+    bool       optimize = false;
+    Converter::Document doc;
+    std::shared_ptr<ImageStore> store;
+    int        failed = 0;        // uploads and copies that failed
+    int        unloaded = 0;      // srcs left as they were: refused files, bad data
+    bool       relinked = false;  // srcs changed since the document was masked
+    QElapsedTimer started;        // when the request was taken
+    QElapsedTimer stage;
+    qint64     us[Stages];        // -1 for a stage the job skipped
+
+    Job() { std::fill(std::begin(us), std::end(us), -1); }
+};
+
+namespace {
+
+// The body of one answer, written on a worker and sent on the server's
+// thread as HTTP chunks. The worker waits while the socket holds more than
+// SendBufferLimit unsent bytes, so a client that reads slowly slows down
+// its own job instead of filling memory. Writes fail once the client has
+// gone.
+class ResponseStream : public QIODevice {
+public:
+    explicit ResponseStream(QTcpSocket *socket)
+        : _socket(socket)
+    {
+        open(QIODevice::WriteOnly);
+        connect(socket, &QTcpSocket::bytesWritten, this, [this](qint64 n) { sent(n); });
+        connect(socket, &QTcpSocket::disconnected, this, [this]() { sent(-1); });
+        connect(socket, &QObject::destroyed, this, [this]() { sent(-1); });
+    }
+
+    // Sends what is left and the closing chunk; on the worker.
+    void finish() {
+        flush(_pending.size());
+        post("0\r\n\r\n");
+    }
+
+    bool delivered() {
+        QMutexLocker lock(&_mutex);
+        return !_gone;
+    }
+
+    bool isSequential() const override { return true; }
+
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+
+    qint64 writeData(const char *data, qint64 len) override {
+        if (!delivered()) return -1;
+        _pending.append(data, len);
+        while (_pending.size() >= ChunkSize)
+            flush(ChunkSize);
+        return len;
+    }
+
+private:
+    void flush(qint64 n) {
+        if (n <= 0) return;
+        post(QByteArray::number(n, 16) + "\r\n" + _pending.left(n) + "\r\n");
+        _pending.remove(0, n);
+    }
+
+    void post(const QByteArray &bytes) {
+        {
+            QMutexLocker lock(&_mutex);
+            while (_unsent > SendBufferLimit && !_gone)
+                _drained.wait(&_mutex);
+            if (_gone) return;
+            _unsent += bytes.size();
+        }
+        QMetaObject::invokeMethod(this, [this, bytes]() {
+            if (_socket) _socket->write(bytes);
+        }, Qt::QueuedConnection);
+    }
+
+    // n bytes left the socket; -1 when the client is gone
+    void sent(qint64 n) {
+        QMutexLocker lock(&_mutex);
+        if (n < 0)
+            _gone = true;
+        else
+            _unsent = qMax<qint64>(0, _unsent - n);
+        _drained.wakeAll();
+    }
+
+    QPointer<QTcpSocket> _socket;
+    QByteArray     _pending;  // worker only
+    QMutex         _mutex;
+    QWaitCondition _drained;
+    qint64         _unsent = 0;
+    bool           _gone = false;
+};
+
+QByteArray reasonPhrase(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 411: return "Length Required";
+    case 413: return "Content Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 503: return "Service Unavailable";
+    default:  return "Error";
+    }
+}
+
+} // namespace
+
+void ConvertServer::StageStats::add(qint64 us) {
+    ++count;
+    totalUs += us;
+    maxUs = qMax(maxUs, us);
+    if (recentUs.size() < Recent)
+        recentUs << us;
+    else
+        recentUs[next] = us;
+    next = (next + 1) % Recent;
+}
+
+ConvertServer::ConvertServer(QObject *parent)
+    : QTcpServer(parent),
+      _cleanOptions(WordCleaner::configured()),
+      _optimizeOptions(ImageOptimizer::configured()),
+      _clean(Config::cleanWordHtml()),
+      _optimize(Config::optimizeImages()),
+      _cacheUploads(Config::uploadCacheEnabled()),
+      _fileRoot(Config::serverFileRoot()),
+      _token(Config::serverToken()),
+      _maxBody(Config::serverMaxBodyMb() * 1024 * 1024),
+      _workers(Config::serverWorkers()),
+      _queueLimit(Config::serverQueueLimit())
+{
+    _pool.setMaxThreadCount(_workers);
+    _writers.setMaxThreadCount(_workers);
+}
+
+ConvertServer::~ConvertServer() {
+    // Workers held up by a slow client give up once its socket is gone
+    const auto sockets = _connections.keys();
+    for (QTcpSocket *socket : sockets) {
+        disconnect(socket, nullptr, this, nullptr);
+        socket->abort();
+    }
+    _writers.waitForDone();
+    _pool.waitForDone();
+}
+
+bool ConvertServer::start(quint16 port) {
+    return listen(QHostAddress::LocalHost, port);
+}
+
+void ConvertServer::setWorkers(int n) {
+    _workers = qBound(1, n, 64);
+    _pool.setMaxThreadCount(_workers);
+    _writers.setMaxThreadCount(_workers);
+    pump();
+}
+
+void ConvertServer::setQueueLimit(int n) {
+    _queueLimit = qMax(0, n);
+}
+
+void ConvertServer::incomingConnection(qintptr socketDescriptor) {
+    auto *socket = new QTcpSocket(this);
+    socket->setSocketDescriptor(socketDescriptor);
+    socket->setReadBufferSize(ReadBufferSize);
+    _connections.insert(socket, Connection());
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { readFrom(socket); });
+    connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+        _connections.remove(socket);
+        socket->deleteLater();
+    });
+}
+
+void ConvertServer::readFrom(QTcpSocket *socket) {
+    const auto it = _connections.find(socket);
+    if (it == _connections.end()) return;
+    Connection &c = *it;
+    if (c.closing) {
+        socket->readAll();
+        return;
+    }
+
+    // Requests can arrive back to back; those behind one in work stay
+    // unread, which stops the client once the socket buffer is full
+    while (!c.busy && !c.closing) {
+        c.buffer += socket->readAll();
+        if (c.bodyLeft < 0) {
+            const qsizetype headerEnd = c.buffer.indexOf("\r\n\r\n");
+            if (headerEnd < 0) {
+                if (c.buffer.size() > MaxHeaderSize) {
+                    respond(socket, 431, "text/plain", "Headers too large\n");
+                    hangUp(socket);
+                }
+                return;
+            }
+
+            const QList<QByteArray> lines = c.buffer.left(headerEnd).split('\n');
+            const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+            c.buffer.remove(0, headerEnd + 4);
+            if (requestLine.size() < 3) {
+                respond(socket, 400, "text/plain", "Malformed request line\n");
+                hangUp(socket);
+                return;
+            }
+            c.method = requestLine[0];
+            c.path = requestLine[1];
+            c.body.clear();
+            c.bodyLeft = 0;
+            c.keepAlive = requestLine[2] != "HTTP/1.0";
+            c.expectContinue = false;
+            c.foreign = true;  // until a Host header of ours shows up
+            c.token.clear();
+            bool chunked = false, origin = false;
+            for (qsizetype i = 1; i < lines.size(); ++i) {
+                const qsizetype colon = lines[i].indexOf(':');
+                if (colon <= 0) continue;
+                const QByteArray name = lines[i].left(colon).trimmed().toLower();
+                const QByteArray value = lines[i].mid(colon + 1).trimmed().toLower();
+                if (name == "content-length")
+                    c.bodyLeft = value.toLongLong();
+                else if (name == "connection")
+                    c.keepAlive = value == "close" ? false : value == "keep-alive" ? true : c.keepAlive;
+                else if (name == "expect")
+                    c.expectContinue = value == "100-continue";
+                else if (name == "transfer-encoding")
+                    chunked = value != "identity";
+                else if (name == "origin")
+                    origin = true;
+                else if (name == "host")
+                    c.foreign = value != "127.0.0.1:" + QByteArray::number(serverPort())
+                             && value != "localhost:" + QByteArray::number(serverPort());
+                else if (name == "x-convertrt-token")
+                    c.token = lines[i].mid(colon + 1).trimmed();
+            }
+            if (origin || c.foreign) {
+                respond(socket, 403, "text/plain", "Only for programs on this machine, not web pages\n");
+                hangUp(socket);
+                return;
+            }
+            if (chunked) {
+                respond(socket, 411, "text/plain", "Send the document with a Content-Length\n");
+                hangUp(socket);
+                return;
+            }
+            if (!accept(socket, c)) return;
+        }
+
+        const qint64 n = qMin<qint64>(c.bodyLeft, c.buffer.size());
+        if (!c.turnedAway)
+            c.body += c.buffer.left(n);
+        c.buffer.remove(0, n);
+        c.bodyLeft -= n;
+        if (c.bodyLeft > 0) return;
+
+        c.bodyLeft = -1;
+        if (std::exchange(c.turnedAway, false))
+            respond(socket, 503, "text/plain", "Busy, try again\n", "Retry-After: 1\r\n");
+        else
+            handle(socket, c);
+        if (c.buffer.isEmpty() && !socket->bytesAvailable()) return;
+    }
+}
+
+// Decides from the headers alone, so a document that cannot be taken is
+// never read.
+bool ConvertServer::accept(QTcpSocket *socket, Connection &c) {
+    if (c.method == "POST" && c.path.startsWith("/convert")) {
+        if (c.bodyLeft > _maxBody) {
+            ++_rejected;
+            respond(socket, 413, "text/plain", "Document too large\n");
+            hangUp(socket);
+            return false;
+        }
+        const int held = int(_queue.size()) + _converting + _uploading + _writing;
+        if (held >= _workers + _queueLimit) {
+            ++_rejected;
+            if (c.expectContinue) {
+                respond(socket, 503, "text/plain", "Busy, try again\n", "Retry-After: 1\r\n");
+                hangUp(socket);
+                return false;
+            }
+            // The body is already on its way; answering before it is read
+            // would lose the answer in a reset connection
+            c.turnedAway = true;
+            return true;
+        }
+    } else if (c.bodyLeft > MaxHeaderSize) {
+        respond(socket, 413, "text/plain", "Request too large\n");
+        hangUp(socket);
+        return false;
+    }
+    if (c.expectContinue)
+        socket->write("HTTP/1.1 100 Continue\r\n\r\n");
+    return true;
+}
+
+void ConvertServer::handle(QTcpSocket *socket, Connection &c) {
+    const QUrl url(QString::fromUtf8("http://localhost" + c.path));
+    const QUrlQuery query(url);
+    QByteArray body = std::exchange(c.body, {});
+
+    if (url.path() == u"/metrics") {
+        if (c.method != "GET")
+            respond(socket, 405, "text/plain", "Use GET\n", "Allow: GET\r\n");
+        else
+            respond(socket, 200, "application/json", metrics());
+        return;
+    }
+    if (url.path() != u"/convert") {
+        respond(socket, 404, "text/plain", "Not found\n");
+        return;
+    }
+    if (c.method != "POST") {
+        respond(socket, 405, "text/plain", "Use POST\n", "Allow: POST\r\n");
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->format = query.hasQueryItem("format") ? query.queryItemValue("format").toLower() : QString("inline");
+    if (!Formats.contains(job->format)) {
+        respond(socket, 400, "text/plain", "Unknown format: " + job->format.toUtf8() + "\n");
+        return;
+    }
+    auto flag = [&query](const char *name, bool fallback) {
+        const QString key = QLatin1String(name);
+        if (!query.hasQueryItem(key)) return fallback;
+        const QString value = query.queryItemValue(key).toLower();
+        return value == "1" || value == "true" || value == "yes" || value.isEmpty();
+    };
+    job->upload = flag("upload", false);
+    job->rehost = flag("rehost", false);
+    if ((job->upload || job->rehost) && !tokenMatches(c.token)) {
+        respond(socket, 403, "text/plain",
+                "upload and rehost need X-Convertrt-Token set to [server] token in config.ini\n");
+        return;
+    }
+    job->clean = flag("clean", _clean);
+    job->optimize = flag("optimize", _optimize);
+    job->socket = socket;
+    job->body = std::move(body);
+    job->started.start();
+
+    ++_accepted;
+    c.busy = true;
+    _queue.enqueue(job);
+    pump();
+}
+
+// In time independent of where the first difference is
+bool ConvertServer::tokenMatches(const QByteArray &token) const {
+    if (_token.isEmpty() || token.size() != _token.size()) return false;
+    char diff = 0;
+    for (qsizetype i = 0; i < token.size(); ++i)
+        diff |= token[i] ^ _token[i];
+    return diff == 0;
+}
+
+void ConvertServer::respond(QTcpSocket *socket, int status, const QByteArray &type, const QByteArray &body,
+                            const QByteArray &headers) {
+    const bool keepAlive = _connections.value(socket).keepAlive;
+    socket->write("HTTP/1.1 " + QByteArray::number(status) + " " + reasonPhrase(status) + "\r\n"
+                  + "Content-Type: " + type + "\r\n"
+                  + headers
+                  + "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                  + "Connection: " + (keepAlive ? "keep-alive" : "close") + "\r\n\r\n"
+                  + body);
+    if (!keepAlive)
+        hangUp(socket);
+}
+
+// Closes the connection once the answer has gone out; anything more the
+// client sends is dropped.
+void ConvertServer::hangUp(QTcpSocket *socket) {
+    const auto it = _connections.find(socket);
+    if (it == _connections.end() || it->closing) return;
+    it->closing = true;
+    it->keepAlive = false;
+    // Later: readFrom() may still be using the connection
+    QMetaObject::invokeMethod(socket, &QAbstractSocket::disconnectFromHost, Qt::QueuedConnection);
+}
+
+void ConvertServer::pump() {
+    while (_converting < _workers && !_queue.isEmpty()) {
+        const JobPtr job = _queue.dequeue();
+        job->us[Queue] = job->started.nsecsElapsed() / 1000;
+        if (!job->socket) {
+            finishJob(job, false);
+            continue;
+        }
+        ++_converting;
+        auto *watcher = new QFutureWatcher<void>(this);
+        connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, job]() {
+            watcher->deleteLater();
+            --_converting;
+            converted(job);
+            pump();
+        });
+        watcher->setFuture(QtConcurrent::run(&_pool, [job, clean = _cleanOptions, optimize = _optimizeOptions,
+                                                      root = _fileRoot]() {
+            convert(*job, clean, optimize, root);
+        }));
+    }
+}
+
+void ConvertServer::convert(Job &job, const WordCleaner::Options &cleanOptions,
+                            const ImageOptimizer::Options &optimizeOptions, const QString &fileRoot) {
+    const Trace::Scope trace("document");
+    QElapsedTimer t;
+    t.start();
+    QStringDecoder decoder(QStringConverter::encodingForHtml(job.body).value_or(QStringConverter::Utf8));
+    QString html = decoder(job.body);
+    job.body = QByteArray();
+    if (job.clean) {
+        const Trace::Scope trace("clean");
+        html = WordCleaner::clean(html, cleanOptions);
+    }
+    job.us[Clean] = t.nsecsElapsed() / 1000;
+
+    t.restart();
+    job.store = std::make_shared<ImageStore>();
+    // Any local client can post a document: it may not pull in files from
+    // outside the configured root, e.g. file:///home/user/.ssh/id_rsa
+    job.doc = Converter::inlineAndMask(html, *job.store, fileRoot, nullptr, LocalImageLoader::UnderBaseDir);
+    job.us[Inline] = t.nsecsElapsed() / 1000;
+    ImgScanner scanner(job.doc.html);
+    ImgScanner::Tag tag;
+    while (scanner.next(tag)) {
+        if (!tag.hasSrc()) continue;
+        const QStringView src = QStringView(job.doc.html).sliced(tag.srcStart, tag.srcEnd - tag.srcStart);
+        job.unloaded += !src.isEmpty() && !ImageStore::isHandle(src) && !RemoteRehoster::isRemote(src);
+    }
+
+    if (job.optimize) {
+        t.restart();
+        Converter::optimizeImages(job.doc, *job.store, optimizeOptions);
+        job.us[Optimize] = t.nsecsElapsed() / 1000;
+    }
+}
+
+// Uploads run here on the server's thread, each document with a queue of
+// its own; the credentials and the upload cache are shared by all.
+void ConvertServer::converted(const JobPtr &job) {
+    const QStringList handles = job->upload ? Converter::imageHandles(job->doc.html) : QStringList();
+    const QStringList remote = job->rehost ? RemoteRehoster::remoteSources(job->doc.html) : QStringList();
+    if (!job->socket || (handles.isEmpty() && remote.isEmpty())) {
+        uploaded(job);
+        return;
+    }
+
+    ++_uploading;
+    job->stage.start();
+    auto *uploads = new UploadQueue(&_network, &_sts, this);
+    if (_cacheUploads)
+        uploads->setCache(&_uploadCache);
+    auto *rehost = new RemoteRehoster(&_network, &_sts, this);
+    // The URLs come from the client: nothing on this machine or its network
+    rehost->setPublicOnly(true);
+    // Nobody is left to link the images for
+    connect(job->socket, &QObject::destroyed, uploads, &UploadQueue::cancel);
+    connect(job->socket, &QObject::destroyed, rehost, &RemoteRehoster::cancel);
+
+    auto running = std::make_shared<int>(2);
+    auto batchFinished = [this, job, uploads, rehost, running, upload = !handles.isEmpty(),
+                          copy = !remote.isEmpty()]() {
+        if (--*running) return;
+        if (upload) {
+            job->doc.html = Converter::replaceHandles(job->doc.html, uploads->urls());
+            job->failed += int(uploads->urls().count(QString()));
+        }
+        if (copy) {
+            job->doc.html = rehost->rewrite(job->doc.html);
+            job->failed += int(rehost->urls().count(QString()));
+        }
+        job->relinked = true;
+        job->us[Upload] = job->stage.nsecsElapsed() / 1000;
+        uploads->deleteLater();
+        rehost->deleteLater();
+        --_uploading;
+        uploaded(job);
+    };
+    connect(uploads, &UploadQueue::finished, this, batchFinished);
+    connect(rehost, &RemoteRehoster::finished, this, batchFinished);
+    // An empty batch finishes on its own, after this returns
+    uploads->start(handles, *job->store);
+    rehost->start(remote);
+}
+
+void ConvertServer::uploaded(const JobPtr &job) {
+    QTcpSocket *socket = job->socket;
+    if (!socket) {
+        finishJob(job, false);
+        return;
+    }
+
+    const bool keepAlive = _connections.value(socket).keepAlive;
+    socket->write("HTTP/1.1 200 OK\r\n"
+                  "Content-Type: " + QByteArray(job->format == "rtf" ? "application/rtf" : "text/html; charset=utf-8") + "\r\n"
+                  "Transfer-Encoding: chunked\r\n"
+                  "X-Convertrt-Images: " + QByteArray::number(job->doc.images) + "\r\n"
+                  "X-Convertrt-Failed: " + QByteArray::number(job->failed) + "\r\n"
+                  "X-Convertrt-Unloaded: " + QByteArray::number(job->unloaded) + "\r\n"
+                  "Connection: " + (keepAlive ? "keep-alive" : "close") + "\r\n\r\n");
+
+    ++_writing;
+    job->stage.start();
+    auto *stream = new ResponseStream(socket);
+    auto *watcher = new QFutureWatcher<void>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, stream, job]() {
+        watcher->deleteLater();
+        stream->deleteLater();
+        --_writing;
+        job->us[Write] = job->stage.nsecsElapsed() / 1000;
+        finishJob(job, stream->delivered());
+    });
+    watcher->setFuture(QtConcurrent::run(&_writers, [job, stream]() {
+        writeResult(*job, stream);
+        stream->finish();
+    }));
+}
+
+bool ConvertServer::writeResult(Job &job, QIODevice *out) {
+    const Trace::Scope trace("write");
+    if (job.format == "rtf")
+        return RtfWriter(out, job.store.get()).write(job.doc.html);
+
+    // Stateful, so a surrogate pair split between two writes stays whole
+    QStringEncoder utf8(QStringConverter::Utf8);
+    auto text = [out, &utf8](QStringView s) {
+        const QByteArray bytes = utf8(s);
+        return out->write(bytes) == bytes.size();
+    };
+    if (job.format == "masked") {
+        // The links changed after the document was split; mask it again
+        const QString masked = job.relinked ? Converter::inlineAndMask(job.doc.html, *job.store).masked
+                                            : job.doc.masked;
+        return text(masked);
+    }
+
+    // Data URIs one image at a time, never the whole document at once
+    const QStringView html = job.doc.html;
+    ImgScanner scanner(html);
+    ImgScanner::Tag tag;
+    qsizetype from = 0;
+    while (scanner.next(tag)) {
+        if (!tag.hasSrc()) continue;
+        const QStringView src = html.sliced(tag.srcStart, tag.srcEnd - tag.srcStart);
+        if (!ImageStore::isHandle(src)) continue;
+        const QByteArray uri = job.store->dataUri(src).toLatin1();
+        if (uri.isEmpty()) continue;
+        if (!text(html.sliced(from, tag.srcStart - from)) || out->write(uri) != uri.size())
+            return false;
+        from = tag.srcEnd;
+    }
+    return text(html.sliced(from));
+}
+
+void ConvertServer::finishJob(const JobPtr &job, bool delivered) {
+    job->us[Total] = job->started.nsecsElapsed() / 1000;
+    if (delivered) {
+        ++_completed;
+        for (int s = 0; s < Stages; ++s) {
+            if (job->us[s] >= 0)
+                _stages[s].add(job->us[s]);
+        }
+    } else {
+        ++_dropped;
+    }
+    job->store.reset();
+    job->doc = Converter::Document();
+
+    QTcpSocket *socket = job->socket;
+    const auto it = socket ? _connections.find(socket) : _connections.end();
+    if (it == _connections.end()) return;
+    it->busy = false;
+    if (!it->keepAlive) {
+        hangUp(socket);
+        return;
+    }
+    // Requests that arrived in the meantime are still in the socket
+    QMetaObject::invokeMethod(this, [this, socket = QPointer<QTcpSocket>(socket)]() {
+        if (socket) readFrom(socket);
+    }, Qt::QueuedConnection);
+}
+
+QByteArray ConvertServer::metrics() const {
+    static const char *const Names[Stages] = { "queue", "clean", "inline", "optimize", "upload", "write", "total" };
+    QJsonObject stages;
+    for (int s = 0; s < Stages; ++s) {
+        const StageStats &st = _stages[s];
+        QList<qint64> recent = st.recentUs;
+        std::sort(recent.begin(), recent.end());
+        auto percentile = [&recent](int p) {
+            return recent.isEmpty() ? 0.0 : recent[(recent.size() - 1) * p / 100] / 1000.0;
+        };
+        stages[QLatin1String(Names[s])] = QJsonObject{
+            { "count", st.count },
+            { "mean_ms", st.count ? st.totalUs / 1000.0 / st.count : 0.0 },
+            { "p50_ms", percentile(50) },
+            { "p95_ms", percentile(95) },
+            { "max_ms", st.maxUs / 1000.0 },
+        };
+    }
+    const QJsonObject root{
+        { "workers", _workers },
+        { "queue_limit", _queueLimit },
+        { "queued", int(_queue.size()) },
+        { "converting", _converting },
+        { "uploading", _uploading },
+        { "writing", _writing },
+        { "connections", int(_connections.size()) },
+        { "accepted", _accepted },
+        { "rejected", _rejected },
+        { "completed", _completed },
+        { "dropped", _dropped },
+        { "stages", stages },
+    };
+    return QJsonDocument(root).toJson();
+}
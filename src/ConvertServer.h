@@ -0,0 +1,142 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QQueue>
+#include <QThreadPool>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QTcpServer>
+#include <memory>
+
+#include "ImageOptimizer.h"
+#include "StsCache.h"
+#include "UploadCache.h"
+#include "WordCleaner.h"
+
+class QIODevice;
+class QTcpSocket;
+
+// Conversion as a service on localhost, so other tools share one warm
+// process instead of starting one per document: one STS session, the
+// upload cache and a fixed pool of workers.
+//
+//   POST /convert?format=inline|masked|rtf[&upload=1][&rehost=1][&clean=0|1][&optimize=0|1]
+//        The body is the HTML. The answer is the converted document,
+//        sent in chunks as it is written; X-Convertrt-Images and
+//        X-Convertrt-Failed give the image count and failed uploads, and
+//        X-Convertrt-Unloaded the images left as they were. Local files
+//        are only read from under Config::serverFileRoot(), and none when
+//        it is not set. upload and rehost need X-Convertrt-Token to match
+//        Config::serverToken(), and rehost only copies from public hosts.
+//   GET  /metrics
+//        Queue depth, jobs per stage, counters and per-stage latency as
+//        JSON.
+//
+// Localhost is not enough to keep web pages out: a browser lets any page
+// post to 127.0.0.1 without asking, so a request with an Origin header,
+// or addressed to any Host but 127.0.0.1 or localhost on this port (DNS
+// rebinding), is answered 403.
+//
+// At most workers() documents are converted at once and queueLimit() more
+// are held; past that a request is answered 503 with Retry-After before its
+// body is read. A connection is not read while its document is in work,
+// and a client that reads its result slowly holds up only its own job.
+class ConvertServer : public QTcpServer {
+    Q_OBJECT
+public:
+    enum Stage { Queue, Clean, Inline, Optimize, Upload, Write, Total, Stages };
+
+    explicit ConvertServer(QObject *parent = nullptr);
+    ~ConvertServer() override;
+
+    // Port 0 picks a free one; see serverPort().
+    bool start(quint16 port);
+
+    void setWorkers(int n);
+    int workers() const { return _workers; }
+    void setQueueLimit(int n);
+    int queueLimit() const { return _queueLimit; }
+
+    // The /metrics document.
+    QByteArray metrics() const;
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    struct Job;
+    using JobPtr = std::shared_ptr<Job>;
+
+    // Parse state of one kept-alive connection
+    struct Connection {
+        QByteArray buffer;
+        QByteArray method;
+        QByteArray path;
+        QByteArray body;
+        qint64     bodyLeft = -1;  // -1 while reading headers
+        bool       keepAlive = true;
+        bool       expectContinue = false;
+        bool       turnedAway = false;  // the body is read past, then 503
+        bool       busy = false;     // a request of this connection is in work
+        bool       closing = false;  // answered for the last time
+        bool       foreign = false;  // from a web page, or for another host
+        QByteArray token;            // X-Convertrt-Token
+    };
+
+    // Latency of one stage over the jobs so far, the last few kept for
+    // percentiles
+    struct StageStats {
+        qint64 count = 0;
+        qint64 totalUs = 0;
+        qint64 maxUs = 0;
+        QList<qint64> recentUs;
+        int    next = 0;
+
+        void add(qint64 us);
+    };
+
+    void readFrom(QTcpSocket *socket);
+    bool accept(QTcpSocket *socket, Connection &c);
+    void handle(QTcpSocket *socket, Connection &c);
+    void respond(QTcpSocket *socket, int status, const QByteArray &type, const QByteArray &body,
+                 const QByteArray &headers = QByteArray());
+    void hangUp(QTcpSocket *socket);
+    bool tokenMatches(const QByteArray &token) const;
+    void pump();
+    void converted(const JobPtr &job);
+    void uploaded(const JobPtr &job);
+    void finishJob(const JobPtr &job, bool delivered);
+    // On the workers: everything up to the upload, and the answer
+    static void convert(Job &job, const WordCleaner::Options &cleanOptions,
+                        const ImageOptimizer::Options &optimizeOptions, const QString &fileRoot);
+    static bool writeResult(Job &job, QIODevice *out);
+
+    QNetworkAccessManager _network;
+    StsCache              _sts{ &_network };
+    UploadCache           _uploadCache;
+    QThreadPool           _pool;
+    QThreadPool           _writers;  // apart, so slow clients hold up no conversion
+    QHash<QTcpSocket *, Connection> _connections;
+    QQueue<JobPtr>        _queue;
+    StageStats            _stages[Stages];
+    WordCleaner::Options  _cleanOptions;
+    ImageOptimizer::Options _optimizeOptions;
+    bool   _clean;
+    bool   _optimize;
+    bool   _cacheUploads;
+    QString _fileRoot;
+    QByteArray _token;
+    qint64 _maxBody;
+    int    _workers;
+    int    _queueLimit;
+    quint64 _nextId = 1;
+    // Jobs in each state; together they are bounded by workers + queue
+    int    _converting = 0;
+    int    _uploading = 0;
+    int    _writing = 0;
+    qint64 _accepted = 0;
+    qint64 _rejected = 0;
+    qint64 _completed = 0;
+    qint64 _dropped = 0;   // the client left before its result was sent
+};
@@ -0,0 +1,63 @@
+#include "Converter.h"
+#include "ImageStore.h"
+#include "ImgScanner.h"
+#include "LocalImageLoader.h"
+#include "Trace.h"
+
+Converter::Document Converter::inlineAndMask(const QString &html, ImageStore &store,
+                                             const QString &baseDir, QThreadPool *pool,
+                                             LocalImageLoader::Files files) {
+    // Move every local and inline image into the store up front on the
+    // thread pool, then splice the handles back in document order.
+    QHash<QString, QString> handles;
+    {
+        const Trace::Scope trace("inline");
+        handles = LocalImageLoader::loadAll(LocalImageLoader::collectSources(html), store, baseDir, pool, files);
+    }
+    const Trace::Scope trace("mask");
+    auto r = ImgScanner::inlineAndMask(html, [&handles](QStringView src) {
+        return handles.value(src.toString());
+    });
+
+    Document doc;
+    doc.html = std::move(r.html);
+    doc.masked = std::move(r.masked);
+    doc.imgTags = std::move(r.tags);
+    doc.images = doc.imgTags.size();
+    Trace::count("images", doc.images);
+    return doc;
+}
+
+ImageOptimizer::Report Converter::optimizeImages(Document &doc, ImageStore &store,
+                                                 const ImageOptimizer::Options &opt, QThreadPool *pool) {
+    const Trace::Scope trace("optimize");
+    const ImageOptimizer::Result r = ImageOptimizer::optimize(doc.html, store, opt, pool);
+    if (r.handles.isEmpty()) return r.report;
+    auto resolve = [&r](QStringView src) { return r.handles.value(src.toString()); };
+    doc.html = ImgScanner::rewrite(doc.html, resolve);
+    for (QString &tag : doc.imgTags)
+        tag = ImgScanner::rewrite(tag, resolve);
+    return r.report;
+}
+
+QStringList Converter::imageHandles(const QString &html) {
+    QStringList handles;
+    ImgScanner scanner(html);
+    ImgScanner::Tag t;
+    while (scanner.next(t)) {
+        if (!t.hasSrc()) continue;
+        QStringView src = QStringView(html).mid(t.srcStart, t.srcEnd - t.srcStart);
+        if (ImageStore::isHandle(src))
+            handles << src.toString();
+    }
+    return handles;
+}
+
+QString Converter::replaceHandles(const QString &html, const QStringList &urls) {
+    int next = 0;
+    return ImgScanner::rewrite(html, [&](QStringView src) {
+        if (!ImageStore::isHandle(src) || next >= urls.size()) return QString();
+        const QString &url = urls[next++];
+        return url.isEmpty() ? QString() : url;
+    });
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+#include "ImageOptimizer.h"
+#include "LocalImageLoader.h"
+
+class ImageStore;
+class QThreadPool;
+
+// The GUI-free part of a conversion: pulls every local and inline image of
+// a document into an ImageStore and masks the <img> tags. Shared by the
+// window and the command line.
+class Converter {
+public:
+    struct Document {
+        QString     html;     // images as ImageStore handles
+        QString     masked;   // images as [Image omitted #n]
+        QStringList imgTags;  // the <img> tags, in order
+        int         images = 0;
+    };
+
+    // Relative image paths are resolved against baseDir (the working
+    // directory when empty); see LocalImageLoader::Files for which files
+    // may be read.
+    static Document inlineAndMask(const QString &html, ImageStore &store,
+                                  const QString &baseDir = QString(),
+                                  QThreadPool *pool = nullptr,
+                                  LocalImageLoader::Files files = LocalImageLoader::AnyFile);
+
+    // Downscales and re-encodes the document's images in the store and
+    // points html and imgTags at the smaller copies.
+    static ImageOptimizer::Report optimizeImages(Document &doc, ImageStore &store,
+                                                 const ImageOptimizer::Options &opt,
+                                                 QThreadPool *pool = nullptr);
+
+    // ImageStore handles in document order, one per <img> instance.
+    static QStringList imageHandles(const QString &html);
+    // Replaces the n-th handle with urls[n]; empty entries keep the handle.
+    static QString replaceHandles(const QString &html, const QStringList &urls);
+};
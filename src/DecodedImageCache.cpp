@@ -0,0 +1,76 @@
+#include "DecodedImageCache.h"
+#include "ImageStore.h"
+
+#include <QBuffer>
+#include <QImageReader>
+
+static int costKiB(const QImage &image) {
+    return int(qMax<qint64>(1, image.sizeInBytes() / 1024));
+}
+
+DecodedImageCache::DecodedImageCache(qint64 maxBytes) {
+    setMaxBytes(maxBytes);
+}
+
+void DecodedImageCache::setMaxBytes(qint64 bytes) {
+    _images.setMaxCost(qMax<qint64>(1, bytes / 1024));
+}
+
+QImage DecodedImageCache::decode(const QByteArray &bytes, int maxWidth, bool *scaled) {
+    if (scaled) *scaled = false;
+    QBuffer in;
+    in.setData(bytes);
+    in.open(QIODevice::ReadOnly);
+    QImageReader reader(&in);
+    reader.setAutoTransform(true);
+    if (maxWidth > 0) {
+        const bool rotated = reader.transformation() & QImageIOHandler::TransformationRotate90;
+        const QSize stored = reader.size();
+        const QSize shown = rotated ? stored.transposed() : stored;
+        if (shown.isValid() && shown.width() > maxWidth) {
+            // Let the decoder do the scaling; JPEG skips most of the work
+            const QSize target = shown.scaled(maxWidth, shown.height(), Qt::KeepAspectRatio);
+            reader.setScaledSize(rotated ? target.transposed() : target);
+            if (scaled) *scaled = true;
+        }
+    }
+    return reader.read();
+}
+
+QImage DecodedImageCache::image(const ImageStore &store, const QString &handle, int maxWidth, bool *scaled) {
+    const QString key = maxWidth > 0 ? ImageStore::keyOf(handle) + u'@' + QString::number(maxWidth)
+                                     : ImageStore::keyOf(handle);
+    if (const Entry *e = _images.object(key)) {
+        ++_hits;
+        if (scaled) *scaled = e->scaled;
+        return e->image;
+    }
+    ++_misses;
+    if (scaled) *scaled = false;
+    const StoredImage stored = store.image(handle);
+    if (stored.isNull()) return {};
+    bool wasScaled = false;
+    const QImage img = decode(stored.bytes, maxWidth, &wasScaled);
+    if (!img.isNull())
+        _images.insert(key, new Entry{ img, wasScaled }, costKiB(img));
+    if (scaled) *scaled = wasScaled;
+    return img;
+}
+
+DecodedImageCache::Stats DecodedImageCache::stats() const {
+    Stats s;
+    s.hits = _hits;
+    s.misses = _misses;
+    s.images = _images.count();
+    s.bytes = _images.totalCost() * 1024;
+    s.maxBytes = _images.maxCost() * 1024;
+    return s;
+}
+
+void DecodedImageCache::resetStats() {
+    _hits = _misses = 0;
+}
+
+void DecodedImageCache::clear() {
+    _images.clear();
+}
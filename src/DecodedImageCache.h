@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QCache>
+#include <QImage>
+#include <QString>
+
+class ImageStore;
+
+// Decoded images for the preview, keyed by content hash, so rendering the
+// same document again (after setHtml, a paste or a sync) decodes nothing.
+// With a maximum width, wider images are decoded straight to that width
+// and only the thumbnail is kept. Bounded by decoded size, least recently
+// used first out. Not thread-safe.
+class DecodedImageCache {
+public:
+    struct Stats {
+        qint64 hits = 0;
+        qint64 misses = 0;  // decoded (or failed to decode) on request
+        int    images = 0;
+        qint64 bytes = 0;
+        qint64 maxBytes = 0;
+
+        double hitRate() const { return hits + misses ? double(hits) / (hits + misses) : 0.0; }
+    };
+
+    explicit DecodedImageCache(qint64 maxBytes = 64 * 1024 * 1024);
+
+    void setMaxBytes(qint64 bytes);
+
+    // The image behind an img: handle, null if it is not in the store or
+    // cannot be decoded. maxWidth is in pixels; 0 keeps the full size.
+    // scaled tells whether the image was wider and came back scaled down.
+    QImage image(const ImageStore &store, const QString &handle, int maxWidth = 0, bool *scaled = nullptr);
+
+    Stats stats() const;
+    void resetStats();
+    void clear();
+
+    // Decodes bytes, scaled down to maxWidth if wider, honouring EXIF
+    // orientation.
+    static QImage decode(const QByteArray &bytes, int maxWidth = 0, bool *scaled = nullptr);
+
+private:
+    struct Entry {
+        QImage image;
+        bool   scaled;
+    };
+
+    QCache<QString, Entry> _images;  // cost in KiB
+    qint64 _hits = 0;
+    qint64 _misses = 0;
+};
@@ -0,0 +1,570 @@
+#include "DocxReader.h"
+#include "ImageStore.h"
+#include "ImgScanner.h"
+#include "Trace.h"
+#include "ZipReader.h"
+
+#include <QDir>
+#include <QHash>
+#include <QList>
+#include <QMimeDatabase>
+#include <QSet>
+#include <QThreadPool>
+#include <QXmlStreamReader>
+#include <QtConcurrent/QtConcurrentMap>
+
+namespace {
+
+struct Relationship {
+    QString type;
+    QString target;  // part name, or a URL when external
+    bool    external = false;
+};
+using Relationships = QHash<QString, Relationship>;
+
+// Attributes are matched by local name; Word's prefixes are not guaranteed.
+QString attr(const QXmlStreamReader &xml, QStringView name) {
+    const QXmlStreamAttributes attrs = xml.attributes();
+    for (const QXmlStreamAttribute &a : attrs)
+        if (a.name() == name) return a.value().toString();
+    return {};
+}
+
+// w:b, w:i and friends: present means on, unless w:val says otherwise
+bool isOn(const QXmlStreamReader &xml) {
+    const QString v = attr(xml, u"val");
+    return v.isEmpty() || v == u"1" || v == u"true" || v == u"on";
+}
+
+QString escape(QStringView s) {
+    QString out;
+    out.reserve(s.size());
+    for (QChar c : s) {
+        switch (c.unicode()) {
+        case u'&': out += QLatin1String("&amp;"); break;
+        case u'<': out += QLatin1String("&lt;"); break;
+        case u'>': out += QLatin1String("&gt;"); break;
+        case u'"': out += QLatin1String("&quot;"); break;
+        default:   out += c;
+        }
+    }
+    return out;
+}
+
+QString relsPart(const QString &part) {
+    const qsizetype slash = part.lastIndexOf(u'/');
+    return part.left(slash + 1) + QLatin1String("_rels/") + part.mid(slash + 1) + QLatin1String(".rels");
+}
+
+Relationships readRelationships(const ZipReader &zip, const QString &part) {
+    Relationships rels;
+    QXmlStreamReader xml(zip.read(relsPart(part)));
+    if (!xml.readNextStartElement()) return rels;
+    const QString dir = part.left(part.lastIndexOf(u'/') + 1);
+    while (xml.readNextStartElement()) {
+        if (xml.name() == u"Relationship") {
+            Relationship r{ attr(xml, u"Type"), attr(xml, u"Target"),
+                            attr(xml, u"TargetMode") == u"External" };
+            if (!r.external)
+                r.target = r.target.startsWith(u'/') ? r.target.mid(1) : QDir::cleanPath(dir + r.target);
+            rels.insert(attr(xml, u"Id"), r);
+        }
+        xml.skipCurrentElement();
+    }
+    return rels;
+}
+
+QString partOfType(const Relationships &rels, QStringView type) {
+    for (const Relationship &r : rels)
+        if (!r.external && r.type.endsWith(type)) return r.target;
+    return {};
+}
+
+// Paragraph style ID -> heading level, from the locale-independent style names
+QHash<QString, int> readHeadings(const ZipReader &zip, const QString &part) {
+    QHash<QString, int> headings;
+    if (part.isEmpty()) return headings;
+    QXmlStreamReader xml(zip.read(part));
+    if (!xml.readNextStartElement()) return headings;
+    while (xml.readNextStartElement()) {
+        if (xml.name() != u"style") {
+            xml.skipCurrentElement();
+            continue;
+        }
+        const QString id = attr(xml, u"styleId");
+        while (xml.readNextStartElement()) {
+            if (xml.name() == u"name") {
+                const QString name = attr(xml, u"val").toLower();
+                int level = 0;
+                if (name == u"title") level = 1;
+                else if (name.startsWith(u"heading ")) level = QStringView(name).mid(8).toInt();
+                if (level >= 1 && level <= 6) headings.insert(id, level);
+            }
+            xml.skipCurrentElement();
+        }
+    }
+    return headings;
+}
+
+// numId -> bit per list level, set where the level is numbered
+QHash<QString, quint16> readNumbering(const ZipReader &zip, const QString &part) {
+    QHash<QString, quint16> numbered;
+    if (part.isEmpty()) return numbered;
+    QHash<QString, quint16> abstract;
+    QHash<QString, QString> nums;
+    QXmlStreamReader xml(zip.read(part));
+    if (!xml.readNextStartElement()) return numbered;
+    while (xml.readNextStartElement()) {
+        if (xml.name() == u"abstractNum") {
+            quint16 &bits = abstract[attr(xml, u"abstractNumId")];
+            while (xml.readNextStartElement()) {
+                if (xml.name() == u"lvl") {
+                    const int level = attr(xml, u"ilvl").toInt();
+                    while (xml.readNextStartElement()) {
+                        if (xml.name() == u"numFmt") {
+                            const QString fmt = attr(xml, u"val");
+                            if (fmt != u"bullet" && fmt != u"none" && level < 16)
+                                bits |= quint16(1u << level);
+                        }
+                        xml.skipCurrentElement();
+                    }
+                } else {
+                    xml.skipCurrentElement();
+                }
+            }
+        } else if (xml.name() == u"num") {
+            const QString id = attr(xml, u"numId");
+            while (xml.readNextStartElement()) {
+                if (xml.name() == u"abstractNumId") nums.insert(id, attr(xml, u"val"));
+                xml.skipCurrentElement();
+            }
+        } else {
+            xml.skipCurrentElement();
+        }
+    }
+    for (auto it = nums.cbegin(); it != nums.cend(); ++it)
+        numbered.insert(it.key(), abstract.value(it.value()));
+    return numbered;
+}
+
+// Streams the body of the main document part out as HTML. Each method is
+// entered on the start element it handles and returns after its end.
+class BodyWriter {
+public:
+    BodyWriter(QXmlStreamReader &xml, const Relationships &rels, const QHash<QString, int> &headings,
+               const QHash<QString, quint16> &numbered)
+        : _xml(xml), _rels(rels), _headings(headings), _numbered(numbered) {}
+
+    QString write() {
+        _html = QStringLiteral("<html><head><meta charset=\"utf-8\"></head><body>\n");
+        if (_xml.readNextStartElement()) {  // w:document
+            while (_xml.readNextStartElement()) {
+                if (_xml.name() == u"body") {
+                    while (_xml.readNextStartElement()) block();
+                } else {
+                    _xml.skipCurrentElement();
+                }
+            }
+        }
+        closeLists(0);
+        _html += QLatin1String("</body></html>\n");
+        return std::move(_html);
+    }
+
+private:
+    static bool isTransparent(QStringView name) {
+        return name == u"sdt" || name == u"sdtContent" || name == u"customXml" || name == u"ins"
+            || name == u"moveTo" || name == u"smartTag" || name == u"fldSimple" || name == u"dir"
+            || name == u"bdo";
+    }
+
+    void block() {
+        const QStringView name = _xml.name();
+        if (name == u"p") {
+            paragraph();
+        } else if (name == u"tbl") {
+            table();
+        } else if (isTransparent(name)) {
+            while (_xml.readNextStartElement()) block();
+        } else {
+            _xml.skipCurrentElement();
+        }
+    }
+
+    // Lists are nested by level; list items are paragraphs with w:numPr.
+    void closeLists(qsizetype depth) {
+        while (_lists.size() > depth)
+            _html += _lists.takeLast() ? QLatin1String("</ol>\n") : QLatin1String("</ul>\n");
+    }
+    void openList(int level, bool ordered) {
+        closeLists(level + 1);
+        if (_lists.size() == level + 1 && _lists.last() != ordered) closeLists(level);
+        while (_lists.size() <= level) {
+            _lists.append(ordered);
+            _html += ordered ? QLatin1String("<ol>\n") : QLatin1String("<ul>\n");
+        }
+    }
+
+    void paragraph() {
+        int heading = 0;
+        QString align, numId;
+        int level = 0;
+        QString tag;
+        qsizetype contentStart = -1;
+        auto open = [&]() {
+            if (!numId.isEmpty() && numId != u"0") {
+                openList(qBound(0, level, 8), _numbered.value(numId) & (1u << qBound(0, level, 8)));
+                tag = QStringLiteral("li");
+            } else {
+                closeLists(0);
+                tag = heading ? QStringLiteral("h%1").arg(heading) : QStringLiteral("p");
+            }
+            _html += u'<';
+            _html += tag;
+            if (!align.isEmpty()) _html += QLatin1String(" style=\"text-align:") + align + QLatin1String("\"");
+            _html += u'>';
+            contentStart = _html.size();
+        };
+        while (_xml.readNextStartElement()) {
+            if (_xml.name() == u"pPr") {
+                while (_xml.readNextStartElement()) {
+                    const QStringView name = _xml.name();
+                    if (name == u"pStyle") {
+                        heading = _headings.value(attr(_xml, u"val"));
+                    } else if (name == u"jc") {
+                        const QString jc = attr(_xml, u"val");
+                        if (jc == u"center") align = QStringLiteral("center");
+                        else if (jc == u"right" || jc == u"end") align = QStringLiteral("right");
+                        else if (jc == u"both" || jc == u"distribute") align = QStringLiteral("justify");
+                    } else if (name == u"numPr") {
+                        while (_xml.readNextStartElement()) {
+                            if (_xml.name() == u"ilvl") level = attr(_xml, u"val").toInt();
+                            else if (_xml.name() == u"numId") numId = attr(_xml, u"val");
+                            _xml.skipCurrentElement();
+                        }
+                        continue;
+                    }
+                    _xml.skipCurrentElement();
+                }
+                continue;
+            }
+            if (contentStart < 0) open();
+            inlineContent();
+        }
+        if (contentStart < 0) open();
+        endFormat();
+        // Empty paragraphs keep their line, as in Word
+        if (_html.size() == contentStart) _html += QLatin1String("&nbsp;");
+        _html += QLatin1String("</") + tag + QLatin1String(">\n");
+    }
+
+    void inlineContent() {
+        const QStringView name = _xml.name();
+        if (name == u"r") {
+            run();
+        } else if (name == u"hyperlink") {
+            QString href;
+            const QString id = attr(_xml, u"id");
+            if (!id.isEmpty()) href = _rels.value(id).target;
+            const QString anchor = attr(_xml, u"anchor");
+            if (!anchor.isEmpty()) href += QLatin1Char('#') + anchor;
+            endFormat();
+            if (!href.isEmpty()) _html += QLatin1String("<a href=\"") + escape(href) + QLatin1String("\">");
+            while (_xml.readNextStartElement()) inlineContent();
+            endFormat();
+            if (!href.isEmpty()) _html += QLatin1String("</a>");
+        } else if (name == u"bookmarkStart") {
+            const QString bookmark = attr(_xml, u"name");
+            if (!bookmark.isEmpty() && bookmark != u"_GoBack") {
+                endFormat();
+                _html += QLatin1String("<a name=\"") + escape(bookmark) + QLatin1String("\"></a>");
+            }
+            _xml.skipCurrentElement();
+        } else if (isTransparent(name)) {
+            while (_xml.readNextStartElement()) inlineContent();
+        } else {
+            _xml.skipCurrentElement();  // deletions, comments, field codes, ...
+        }
+    }
+
+    // Consecutive runs with the same formatting share one set of tags.
+    void setFormat(const QString &open, const QString &close) {
+        if (open == _open) return;
+        _html += _close;
+        _html += open;
+        _open = open;
+        _close = close;
+    }
+    void endFormat() { setFormat(QString(), QString()); }
+
+    void runProperties(QString &open, QString &close) {
+        bool bold = false, italic = false, underline = false, strike = false;
+        QString vertical, style;
+        while (_xml.readNextStartElement()) {
+            const QStringView name = _xml.name();
+            if (name == u"b") bold = isOn(_xml);
+            else if (name == u"i") italic = isOn(_xml);
+            else if (name == u"u") underline = attr(_xml, u"val") != u"none";
+            else if (name == u"strike" || name == u"dstrike") strike = isOn(_xml);
+            else if (name == u"vertAlign") vertical = attr(_xml, u"val");
+            else if (name == u"color") {
+                const QString color = attr(_xml, u"val");
+                if (color.size() == 6 && color != u"000000") style += QStringLiteral("color:#%1;").arg(color);
+            } else if (name == u"sz") {
+                const int halfPoints = attr(_xml, u"val").toInt();
+                if (halfPoints > 0) style += QStringLiteral("font-size:%1pt;").arg(halfPoints / 2.0);
+            }
+            _xml.skipCurrentElement();
+        }
+        if (!style.isEmpty()) {
+            open += QLatin1String("<span style=\"") + style + QLatin1String("\">");
+            close.prepend(QLatin1String("</span>"));
+        }
+        auto wrap = [&](const char *tag, bool on) {
+            if (!on) return;
+            open += QStringLiteral("<%1>").arg(QLatin1String(tag));
+            close.prepend(QStringLiteral("</%1>").arg(QLatin1String(tag)));
+        };
+        wrap("b", bold);
+        wrap("i", italic);
+        wrap("u", underline);
+        wrap("s", strike);
+        wrap("sup", vertical == u"superscript");
+        wrap("sub", vertical == u"subscript");
+    }
+
+    void run() {
+        QString open, close;
+        while (_xml.readNextStartElement()) {
+            if (_xml.name() == u"rPr") runProperties(open, close);
+            else runContent(open, close);
+        }
+    }
+
+    void runContent(const QString &open, const QString &close) {
+        const QStringView name = _xml.name();
+        if (name == u"t") {
+            const QString text = _xml.readElementText();
+            if (text.isEmpty()) return;
+            setFormat(open, close);
+            _html += escape(text);
+            return;
+        }
+        QLatin1String literal;
+        if (name == u"tab" || name == u"ptab") literal = QLatin1String("&emsp;");
+        else if (name == u"br" || name == u"cr") literal = QLatin1String("<br>");
+        else if (name == u"noBreakHyphen") literal = QLatin1String("&#8209;");
+        else if (name == u"softHyphen") literal = QLatin1String("&shy;");
+        if (literal.size()) {
+            setFormat(open, close);
+            _html += literal;
+            _xml.skipCurrentElement();
+        } else if (name == u"sym") {
+            const uint code = attr(_xml, u"char").toUInt(nullptr, 16);
+            _xml.skipCurrentElement();
+            if (!code) return;
+            setFormat(open, close);
+            // Symbol fonts map their glyphs to U+F0xx; the plain code is the nearer guess
+            _html += QChar(code >= 0xf000 && code <= 0xf0ff ? code - 0xf000 : code);
+        } else if (name == u"drawing") {
+            setFormat(open, close);
+            drawing();
+        } else if (name == u"pict" || name == u"object") {
+            setFormat(open, close);
+            picture();
+        } else if (name == u"AlternateContent") {
+            // The first choice is the richer form; the fallback repeats it
+            bool done = false;
+            while (_xml.readNextStartElement()) {
+                if (!done && _xml.name() == u"Choice") {
+                    while (_xml.readNextStartElement()) runContent(open, close);
+                    done = true;
+                } else {
+                    _xml.skipCurrentElement();
+                }
+            }
+        } else {
+            _xml.skipCurrentElement();
+        }
+    }
+
+    void image(const QString &id, const QString &linkId, int width, int height, const QString &alt) {
+        const Relationship rel = _rels.value(id.isEmpty() ? linkId : id);
+        if (rel.target.isEmpty()) return;
+        _html += QLatin1String("<img");
+        if (width > 0 && height > 0)
+            _html += QStringLiteral(" width=%1 height=%2").arg(width).arg(height);
+        _html += QLatin1String(" src=\"") + escape(rel.target) + QLatin1String("\"");
+        if (!alt.isEmpty()) _html += QLatin1String(" alt=\"") + escape(alt) + QLatin1String("\"");
+        _html += u'>';
+    }
+
+    // DrawingML: the picture is an a:blip somewhere below, its size wp:extent
+    void drawing() {
+        int width = 0, height = 0;
+        QString alt;
+        QList<QPair<QString, QString>> blips;  // embed, link
+        for (int depth = 1; depth > 0 && !_xml.atEnd();) {
+            const QXmlStreamReader::TokenType token = _xml.readNext();
+            if (token == QXmlStreamReader::EndElement) {
+                --depth;
+                continue;
+            }
+            if (token != QXmlStreamReader::StartElement) continue;
+            ++depth;
+            const QStringView name = _xml.name();
+            if (name == u"extent" && !width) {
+                width = int(attr(_xml, u"cx").toLongLong() / 9525);  // EMU per pixel at 96 dpi
+                height = int(attr(_xml, u"cy").toLongLong() / 9525);
+            } else if (name == u"docPr") {
+                alt = attr(_xml, u"descr");
+            } else if (name == u"blip") {
+                blips.append({ attr(_xml, u"embed"), attr(_xml, u"link") });
+            }
+        }
+        for (const auto &b : blips)
+            image(b.first, b.second, blips.size() == 1 ? width : 0, blips.size() == 1 ? height : 0, alt);
+    }
+
+    // VML, from older documents: v:imagedata inside a v:shape sized in points
+    void picture() {
+        int width = 0, height = 0;
+        for (int depth = 1; depth > 0 && !_xml.atEnd();) {
+            const QXmlStreamReader::TokenType token = _xml.readNext();
+            if (token == QXmlStreamReader::EndElement) {
+                --depth;
+                continue;
+            }
+            if (token != QXmlStreamReader::StartElement) continue;
+            ++depth;
+            const QStringView name = _xml.name();
+            if (name == u"shape") {
+                const QString style = attr(_xml, u"style");
+                for (QStringView decl : QStringView(style).split(u';')) {
+                    const qsizetype colon = decl.indexOf(u':');
+                    if (colon < 0) continue;
+                    const QStringView key = decl.left(colon).trimmed();
+                    QStringView value = decl.mid(colon + 1).trimmed();
+                    if (!value.endsWith(u"pt")) continue;
+                    const int px = qRound(value.chopped(2).toDouble() * 4 / 3);
+                    if (key == u"width") width = px;
+                    else if (key == u"height") height = px;
+                }
+            } else if (name == u"imagedata") {
+                image(attr(_xml, u"id"), QString(), width, height, attr(_xml, u"title"));
+            }
+        }
+    }
+
+    void table() {
+        endFormat();
+        closeLists(0);
+        _html += QLatin1String("<table border=1 cellspacing=0 cellpadding=4 "
+                               "style=\"border-collapse:collapse\">\n");
+        while (_xml.readNextStartElement()) {
+            if (_xml.name() != u"tr") {
+                _xml.skipCurrentElement();
+                continue;
+            }
+            _html += QLatin1String("<tr>");
+            while (_xml.readNextStartElement()) {
+                if (_xml.name() == u"tc") cell();
+                else _xml.skipCurrentElement();
+            }
+            _html += QLatin1String("</tr>\n");
+        }
+        _html += QLatin1String("</table>\n");
+    }
+
+    void cell() {
+        int span = 1;
+        bool opened = false;
+        while (_xml.readNextStartElement()) {
+            if (_xml.name() == u"tcPr") {
+                while (_xml.readNextStartElement()) {
+                    if (_xml.name() == u"gridSpan") span = qMax(1, attr(_xml, u"val").toInt());
+                    _xml.skipCurrentElement();
+                }
+                continue;
+            }
+            if (!opened) {
+                _html += span > 1 ? QStringLiteral("<td colspan=%1>").arg(span) : QStringLiteral("<td>");
+                opened = true;
+            }
+            block();
+        }
+        if (!opened)
+            _html += span > 1 ? QStringLiteral("<td colspan=%1>").arg(span) : QStringLiteral("<td>");
+        closeLists(0);
+        _html += QLatin1String("</td>");
+    }
+
+    QXmlStreamReader &_xml;
+    const Relationships &_rels;
+    const QHash<QString, int> &_headings;
+    const QHash<QString, quint16> &_numbered;
+    QString     _html;
+    QList<bool> _lists;  // open lists, outermost first; true when ordered
+    QString     _open;   // tags of the current run formatting
+    QString     _close;
+};
+
+} // namespace
+
+DocxReader::Result DocxReader::read(const QString &path, ImageStore &store, QThreadPool *pool) {
+    const Trace::Scope trace("docx");
+    Result result;
+    ZipReader zip(path);
+    if (!zip.open()) {
+        result.error = zip.errorString();
+        return result;
+    }
+    QString document = partOfType(readRelationships(zip, QString()), u"/officeDocument");
+    if (document.isEmpty()) document = QStringLiteral("word/document.xml");
+    const Relationships rels = readRelationships(zip, document);
+
+    // Images are read while the XML is converted
+    QStringList media;
+    QSet<QString> seen;
+    for (const Relationship &r : rels) {
+        if (r.external || !r.type.endsWith(u"/image") || seen.contains(r.target)) continue;
+        seen.insert(r.target);
+        media << r.target;
+    }
+    QFuture<QString> handles = QtConcurrent::mapped(
+        pool ? pool : QThreadPool::globalInstance(), media, [&zip, &store](const QString &part) {
+            const QByteArray bytes = zip.read(part);
+            if (bytes.isEmpty()) return QString();
+            // QMimeDatabase shares one global, thread-safe database between instances.
+            const QString mime = QMimeDatabase().mimeTypeForFile(part, QMimeDatabase::MatchExtension).name();
+            return store.insert(bytes, mime);
+        });
+
+    QString error;
+    const QByteArray xmlBytes = zip.read(document, &error);
+    QString html;
+    if (!xmlBytes.isNull()) {
+        QXmlStreamReader xml(xmlBytes);
+        html = BodyWriter(xml, rels, readHeadings(zip, partOfType(rels, u"/styles")),
+                          readNumbering(zip, partOfType(rels, u"/numbering"))).write();
+        if (xml.hasError())
+            error = QStringLiteral("%1: %2").arg(document, xml.errorString());
+    }
+    handles.waitForFinished();
+    if (!error.isEmpty()) {
+        result.error = error;
+        return result;
+    }
+
+    QHash<QString, QString> byPart;
+    const QList<QString> loaded = handles.results();
+    for (qsizetype i = 0; i < media.size(); ++i) {
+        if (loaded[i].isNull()) continue;
+        byPart.insert(media[i], loaded[i]);
+        ++result.images;
+    }
+    result.html = ImgScanner::rewrite(html, [&byPart](QStringView src) {
+        return byPart.value(src.toString());
+    });
+    return result;
+}
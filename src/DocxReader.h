@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QString>
+
+class ImageStore;
+class QThreadPool;
+
+// Opens a .docx directly, without Word or the clipboard. The body of the
+// main document part becomes HTML in the shape the rest of the pipeline
+// expects: paragraphs, headings, lists, tables, links, character formatting
+// and images. Images are read from the package (word/media) on the thread
+// pool while the XML is converted, and go straight into the store; the
+// HTML refers to them by handle. Nothing is extracted to disk.
+class DocxReader {
+public:
+    struct Result {
+        QString html;
+        int     images = 0;  // images read from the package
+        QString error;
+    };
+
+    static Result read(const QString &path, ImageStore &store, QThreadPool *pool = nullptr);
+};
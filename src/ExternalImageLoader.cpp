@@ -0,0 +1,111 @@
+#include "ExternalImageLoader.h"
+#include "Config.h"
+#include "Trace.h"
+
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtNetwork/QNetworkDiskCache>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+
+// How long a URL that failed for good is left alone
+static constexpr qint64 FailureMemoryMs = 5 * 60 * 1000;
+
+ExternalImageLoader::ExternalImageLoader(QObject *parent)
+    : QObject(parent),
+      _maxInFlight(Config::externalConcurrency())
+{
+    auto *disk = new QNetworkDiskCache(this);
+    disk->setCacheDirectory(
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/http");
+    disk->setMaximumCacheSize(Config::externalDiskCacheMb() * 1024 * 1024);
+    _network.setCache(disk);
+
+    _images.setMaxCost(Config::externalMemoryCacheMb() * 1024);
+}
+
+bool ExternalImageLoader::isRemote(const QUrl &url) {
+    const QString scheme = url.scheme();
+    return scheme == QLatin1String("http") || scheme == QLatin1String("https");
+}
+
+QImage ExternalImageLoader::image(const QUrl &url) {
+    if (QImage *img = _images.object(url))
+        return *img;
+    if (!_pending.contains(url) && !hasFailed(url)) {
+        _pending.insert(url);
+        _queue.append(url);
+        pump();
+    }
+    return {};
+}
+
+void ExternalImageLoader::setMaxInFlight(int n) {
+    _maxInFlight = qMax(1, n);
+    pump();
+}
+
+void ExternalImageLoader::pump() {
+    while (_active < _maxInFlight && !_queue.isEmpty())
+        fetch(_queue.takeFirst());
+}
+
+void ExternalImageLoader::fetch(const QUrl &url) {
+    QNetworkRequest req(url);
+    req.setRawHeader("User-Agent", "convertrt/1.0");
+    req.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+    // Images already on disk are used without revalidating them
+    req.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
+    req.setTransferTimeout(10000); // 10 second timeout
+
+    ++_active;
+    QNetworkReply *reply = _network.get(req);
+    Trace::begin("external_fetch", quintptr(reply));
+    connect(reply, &QNetworkReply::finished, this, [this, reply, url]() {
+        --_active;
+        reply->deleteLater();
+        Trace::end("external_fetch", quintptr(reply));
+        if (reply->error() != QNetworkReply::NoError) {
+            _pending.remove(url);
+            // Timeouts, dropped connections and 5xx may pass; try again later
+            const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (status >= 400 && status < 500 && status != 408 && status != 429)
+                _failed.insert(url, QDateTime::currentMSecsSinceEpoch() + FailureMemoryMs);
+        } else {
+            // Decode off the GUI thread
+            const QByteArray data = reply->readAll();
+            Trace::count("external_bytes", data.size());
+            auto *watcher = new QFutureWatcher<QImage>(this);
+            connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, url]() {
+                watcher->deleteLater();
+                decoded(url, watcher->result());
+            });
+            watcher->setFuture(QtConcurrent::run([data]() {
+                QImage img;
+                img.loadFromData(data);
+                return img;
+            }));
+        }
+        pump();
+    });
+}
+
+void ExternalImageLoader::decoded(const QUrl &url, const QImage &image) {
+    _pending.remove(url);
+    if (image.isNull()) {
+        _failed.insert(url, QDateTime::currentMSecsSinceEpoch() + FailureMemoryMs);
+        return;
+    }
+    _images.insert(url, new QImage(image), qMax<qsizetype>(1, image.sizeInBytes() / 1024));
+    emit imageLoaded(url, image);
+}
+
+bool ExternalImageLoader::hasFailed(const QUrl &url) {
+    const auto it = _failed.constFind(url);
+    if (it == _failed.constEnd()) return false;
+    if (*it > QDateTime::currentMSecsSinceEpoch()) return true;
+    _failed.erase(it);
+    return false;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QUrl>
+#include <QtNetwork/QNetworkAccessManager>
+
+// Fetches http(s) images in the background for the preview. Downloads go
+// through a QNetworkDiskCache, decoded images are kept in a bounded LRU,
+// and at most maxInFlight() requests run at once. Callers ask with image()
+// and are told through imageLoaded() when a missing image arrives. A URL
+// that failed for good (a 4xx, or bytes that are no image) is not asked for
+// again for a few minutes; one that timed out or got a 5xx is retried the
+// next time the preview needs it.
+class ExternalImageLoader : public QObject {
+    Q_OBJECT
+public:
+    explicit ExternalImageLoader(QObject *parent = nullptr);
+
+    static bool isRemote(const QUrl &url);
+
+    // The decoded image if cached; otherwise queues a fetch and returns a
+    // null QImage.
+    QImage image(const QUrl &url);
+
+    void setMaxInFlight(int n);
+
+    // Lets every failed URL be fetched again, e.g. for a new document.
+    void forgetFailures() { _failed.clear(); }
+
+signals:
+    void imageLoaded(const QUrl &url, const QImage &image);
+
+private:
+    void pump();
+    void fetch(const QUrl &url);
+    void decoded(const QUrl &url, const QImage &image);
+    bool hasFailed(const QUrl &url);
+
+    QNetworkAccessManager _network;
+    QCache<QUrl, QImage>  _images;   // cost in KiB
+    QList<QUrl>           _queue;
+    QSet<QUrl>            _pending;  // queued, downloading or decoding
+    QHash<QUrl, qint64>   _failed;   // until when, ms since the epoch
+    int _active = 0;
+    int _maxInFlight;
+};
@@ -0,0 +1,145 @@
+#include "HtmlDocument.h"
+
+#include <utility>
+
+static constexpr QStringView MarkerPrefix = u"[Image omitted #";
+
+HtmlDocument::HtmlDocument(QStringView html) {
+    _text.reserve(html.size());
+    ImgScanner scanner(html);
+    ImgScanner::Tag t;
+    qsizetype pos = 0;
+    while (scanner.next(t)) {
+        if (t.start > pos) {
+            _pieces.append({ _text.size(), t.start - pos, -1 });
+            _text += html.mid(pos, t.start - pos);
+        }
+        Image img;
+        if (t.hasSrc()) {
+            img.before = html.mid(t.start, t.srcStart - t.start).toString();
+            img.src = html.mid(t.srcStart, t.srcEnd - t.srcStart).toString();
+            img.after = html.mid(t.srcEnd, t.end - t.srcEnd).toString();
+            img.hasSrc = true;
+        } else {
+            img.before = html.mid(t.start, t.end - t.start).toString();
+        }
+        _tagBytes += t.end - t.start;
+        const int index = _images.size();
+        _images.append(std::move(img));
+        const QString m = marker(index);
+        _pieces.append({ _text.size(), m.size(), index });
+        _text += m;
+        pos = t.end;
+    }
+    if (pos < html.size()) {
+        _pieces.append({ _text.size(), html.size() - pos, -1 });
+        _text += html.mid(pos);
+    }
+}
+
+// The line breaks keep each marker on a line of its own in the source pane;
+// they belong to the marker and are not part of the HTML.
+QString HtmlDocument::marker(int image) {
+    return QStringLiteral("\n[Image omitted #%1]\n").arg(image + 1);
+}
+
+qsizetype HtmlDocument::findMarker(QStringView text, qsizetype from, qsizetype *end, int *image) {
+    while (true) {
+        const qsizetype at = text.indexOf(MarkerPrefix, from);
+        if (at < 0) return -1;
+        const qsizetype digits = at + MarkerPrefix.size();
+        qsizetype close = digits;
+        int n = 0;
+        for (; close < text.size() && n < 100000000; ++close) {
+            const char16_t c = text[close].unicode();
+            if (c < u'0' || c > u'9') break;
+            n = n * 10 + (c - u'0');
+        }
+        if (close > digits && close < text.size() && text[close] == u']') {
+            *end = close + 1;
+            *image = n - 1;
+            return at;
+        }
+        from = at + 1;
+    }
+}
+
+void HtmlDocument::setMasked(const QString &text) {
+    _text = text;
+    _pieces.clear();
+    const QStringView s(_text);
+    qsizetype pos = 0;   // start of the pending text piece
+    qsizetype at, end;
+    int index;
+    while ((at = findMarker(s, pos, &end, &index)) >= 0) {
+        qsizetype start = at;
+        if (start > pos && s[start - 1] == u'\n') --start;
+        if (end < s.size() && s[end] == u'\n') ++end;
+        if (start > pos)
+            _pieces.append({ pos, start - pos, -1 });
+        if (index >= 0 && index < _images.size())
+            _pieces.append({ start, end - start, index });
+        pos = end;
+    }
+    if (pos < s.size())
+        _pieces.append({ pos, s.size() - pos, -1 });
+}
+
+void HtmlDocument::appendTag(QString &out, const Image &img, const ImgScanner::Resolver *resolve) const {
+    out += img.before;
+    if (!img.hasSrc) return;
+    QString resolved;
+    if (resolve) resolved = (*resolve)(img.src);
+    out += resolved.isNull() ? img.src : resolved;
+    out += img.after;
+}
+
+QString HtmlDocument::build(const ImgScanner::Resolver *resolve) const {
+    QString out;
+    out.reserve(_text.size() + _tagBytes);
+    const QStringView text(_text);
+    for (const Piece &p : _pieces) {
+        if (p.image < 0)
+            out += text.mid(p.start, p.length);
+        else
+            appendTag(out, _images[p.image], resolve);
+    }
+    return out;
+}
+
+QString HtmlDocument::html() const {
+    return build(nullptr);
+}
+
+QString HtmlDocument::html(const ImgScanner::Resolver &resolve) const {
+    return build(&resolve);
+}
+
+QString HtmlDocument::imageTag(int image) const {
+    QString out;
+    appendTag(out, _images[image], nullptr);
+    return out;
+}
+
+QString HtmlDocument::src(int image) const {
+    const Image &img = _images[image];
+    return img.hasSrc ? img.src : QString();
+}
+
+void HtmlDocument::setSrc(int image, const QString &src) {
+    Image &img = _images[image];
+    if (!img.hasSrc) return;
+    _tagBytes += src.size() - img.src.size();
+    img.src = src;
+}
+
+QList<int> HtmlDocument::usedImages() const {
+    QList<int> used;
+    QList<bool> seen(_images.size(), false);
+    for (const Piece &p : _pieces) {
+        if (p.image < 0 || seen[p.image]) continue;
+        seen[p.image] = true;
+        used << p.image;
+    }
+    return used;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringView>
+
+#include "ImgScanner.h"
+
+// The working document as a piece table. The text is kept in its masked
+// form, with each <img> tag replaced by an "[Image omitted #n]" marker, and
+// the tags live in a separate table that the markers index. Changing a src
+// touches one table entry; html() splices the tags back in one pass.
+//
+// The masked text is what the source pane shows, so an edit there is taken
+// over with setMasked() without touching the tags.
+class HtmlDocument {
+public:
+    HtmlDocument() = default;
+    // Splits html at its <img> tags; they become images 0..n-1.
+    explicit HtmlDocument(QStringView html);
+
+    static QString marker(int image);
+    // Offset of the next "[Image omitted #n]" in text at or after from, -1
+    // if there is none; end is set past its ']' and image to n - 1. A plain
+    // scan, cheap enough to run on every highlighted block.
+    static qsizetype findMarker(QStringView text, qsizetype from, qsizetype *end, int *image);
+
+    // Replaces the text. Markers refer to this document's images; a marker
+    // for an image that does not exist is dropped.
+    void setMasked(const QString &text);
+    const QString &masked() const { return _text; }
+
+    QString html() const;
+    // html() with every src passed through resolve; a null result keeps it.
+    QString html(const ImgScanner::Resolver &resolve) const;
+
+    bool isEmpty() const { return _text.isEmpty(); }
+    int imageCount() const { return _images.size(); }
+    QString imageTag(int image) const;
+    // Null for a tag without a src.
+    QString src(int image) const;
+    void setSrc(int image, const QString &src);
+    // Images the text refers to, in order of first reference.
+    QList<int> usedImages() const;
+
+private:
+    struct Image {
+        QString before;  // tag up to the src value, or the whole tag
+        QString src;
+        QString after;
+        bool    hasSrc = false;
+    };
+
+    struct Piece {
+        qsizetype start = 0;   // text pieces: span of _text
+        qsizetype length = 0;
+        int       image = -1;  // image pieces: index into _images
+    };
+
+    void appendTag(QString &out, const Image &img, const ImgScanner::Resolver *resolve) const;
+    QString build(const ImgScanner::Resolver *resolve) const;
+
+    QString      _text;
+    QList<Piece> _pieces;
+    QList<Image> _images;
+    qsizetype    _tagBytes = 0;  // total length of the tags, for reserve()
+};
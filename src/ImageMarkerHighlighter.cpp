@@ -0,0 +1,15 @@
+#include "ImageMarkerHighlighter.h"
+#include "HtmlDocument.h"
+
+ImageMarkerHighlighter::ImageMarkerHighlighter(QTextDocument *doc)
+    : QSyntaxHighlighter(doc)
+{
+    _format.setBackground(Qt::yellow);
+}
+
+void ImageMarkerHighlighter::highlightBlock(const QString &text) {
+    qsizetype at, end = 0;
+    int image;
+    while ((at = HtmlDocument::findMarker(text, end, &end, &image)) >= 0)
+        setFormat(int(at), int(end - at), _format);
+}
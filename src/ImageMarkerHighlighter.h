@@ -0,0 +1,16 @@
+#pragma once
+
+#include <QSyntaxHighlighter>
+#include <QTextCharFormat>
+
+// Marks "[Image omitted #n]" in the source pane. Blocks are re-highlighted
+// as they change, so the scan is a plain search for the marker prefix.
+class ImageMarkerHighlighter : public QSyntaxHighlighter {
+    Q_OBJECT
+public:
+    explicit ImageMarkerHighlighter(QTextDocument *doc);
+protected:
+    void highlightBlock(const QString &text) override;
+private:
+    QTextCharFormat _format;
+};
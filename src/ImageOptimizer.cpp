@@ -0,0 +1,154 @@
+#include "ImageOptimizer.h"
+#include "Config.h"
+#include "ImgScanner.h"
+
+#include <QBuffer>
+#include <QImage>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtMath>
+
+// Pixels from a width or height attribute; 0 when absent or relative.
+static int pixels(QStringView value) {
+    value = value.trimmed();
+    if (value.endsWith(u"px", Qt::CaseInsensitive)) value.chop(2);
+    bool ok = false;
+    const int n = value.toInt(&ok);
+    return ok && n > 0 ? n : 0;
+}
+
+static bool hasTransparency(const QImage &image) {
+    if (!image.hasAlphaChannel()) return false;
+    const QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+    for (int y = 0; y < argb.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(argb.constScanLine(y));
+        for (int x = 0; x < argb.width(); ++x)
+            if (qAlpha(line[x]) != 255) return true;
+    }
+    return false;
+}
+
+ImageOptimizer::Options ImageOptimizer::configured() {
+    Options opt;
+    const QString format = Config::optimizeFormat();
+    opt.format = format == "jpeg" ? Format::Jpeg : format == "png" ? Format::Png : Format::Keep;
+    opt.quality = Config::optimizeQuality();
+    opt.downscale = Config::optimizeDownscale();
+    opt.scale = Config::optimizeScale();
+    return opt;
+}
+
+StoredImage ImageOptimizer::optimizeImage(const StoredImage &img, const QList<QSize> &displayed,
+                                          const Options &opt) {
+    QBuffer in;
+    in.setData(img.bytes);
+    in.open(QIODevice::ReadOnly);
+    QImageReader reader(&in);
+    reader.setAutoTransform(true);
+    const QByteArray sourceFormat = reader.format();
+    if (reader.supportsAnimation() && reader.imageCount() > 1) return {};
+    const QSize stored = reader.size();
+    if (!stored.isValid()) return {};
+
+    // Attributes describe the image as shown, after EXIF rotation
+    const bool rotated = reader.transformation() & QImageIOHandler::TransformationRotate90;
+    const QSize shown = rotated ? stored.transposed() : stored;
+    QSize target = shown;
+    if (opt.downscale && !displayed.isEmpty()) {
+        QSize box(0, 0);
+        bool natural = false;
+        for (const QSize &d : displayed) {
+            int w = d.width(), h = d.height();
+            if (w <= 0 && h <= 0) { natural = true; break; }
+            if (w <= 0) w = qRound(qreal(h) * shown.width() / shown.height());
+            if (h <= 0) h = qRound(qreal(w) * shown.height() / shown.width());
+            box = box.expandedTo(QSize(w, h));
+        }
+        if (!natural)
+            target = QSize(qCeil(box.width() * opt.scale), qCeil(box.height() * opt.scale)).boundedTo(shown);
+    }
+    if (target != shown)
+        reader.setScaledSize(rotated ? target.transposed() : target);
+
+    QImage image = reader.read();
+    if (image.isNull()) return {};
+
+    const bool transparent = hasTransparency(image);
+    bool jpeg = opt.format == Format::Jpeg
+             || (opt.format == Format::Keep && (sourceFormat == "jpeg" || sourceFormat == "jpg"));
+    if (transparent) jpeg = false;
+    if (!transparent && image.hasAlphaChannel())
+        image = image.convertToFormat(QImage::Format_RGB32);
+
+    StoredImage out;
+    QBuffer buf(&out.bytes);
+    buf.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buf, jpeg ? "jpeg" : "png");
+    if (jpeg) {
+        writer.setQuality(opt.quality);
+        writer.setOptimizedWrite(true);
+    } else {
+        writer.setQuality(0);  // strongest zlib compression
+    }
+    if (!writer.write(image) || out.bytes.size() >= img.bytes.size()) return {};
+    out.mime = jpeg ? QStringLiteral("image/jpeg") : QStringLiteral("image/png");
+    return out;
+}
+
+ImageOptimizer::Result ImageOptimizer::optimize(const QString &html, ImageStore &store,
+                                                const Options &opt, QThreadPool *pool) {
+    // Every size each image is shown at
+    QHash<QString, QList<QSize>> displayed;
+    QStringList handles;
+    ImgScanner scanner(html);
+    ImgScanner::Tag t;
+    while (scanner.next(t)) {
+        if (!t.hasSrc()) continue;
+        const QString src = QStringView(html).mid(t.srcStart, t.srcEnd - t.srcStart).toString();
+        if (!ImageStore::isHandle(src)) continue;
+        if (!displayed.contains(src)) handles << src;
+        const QStringView w = ImgScanner::attribute(html, t, u"width");
+        const QStringView h = ImgScanner::attribute(html, t, u"height");
+        // A relative size depends on the page, so keep all pixels
+        if (w.contains(u'%') || h.contains(u'%'))
+            displayed[src] << QSize(0, 0);
+        else
+            displayed[src] << QSize(pixels(w), pixels(h));
+    }
+
+    Result result;
+    if (handles.isEmpty()) return result;
+
+    struct Job {
+        QString     handle;
+        StoredImage before;
+        StoredImage after;
+    };
+    const QList<Job> jobs = QtConcurrent::blockingMapped<QList<Job>>(
+        pool ? pool : QThreadPool::globalInstance(), handles,
+        [&store, &displayed, &opt](const QString &handle) {
+            Job job{ handle, store.image(handle), {} };
+            if (!job.before.isNull())
+                job.after = optimizeImage(job.before, displayed.value(handle), opt);
+            return job;
+        });
+
+    for (const Job &job : jobs) {
+        if (job.before.isNull()) continue;
+        ++result.report.images;
+        result.report.bytesBefore += job.before.bytes.size();
+        if (job.after.isNull()) {
+            result.report.bytesAfter += job.before.bytes.size();
+            continue;
+        }
+        ++result.report.optimized;
+        result.report.bytesAfter += job.after.bytes.size();
+        const QString handle = store.insert(job.after.bytes, job.after.mime);
+        if (handle == job.handle) continue;
+        result.handles.insert(job.handle, handle);
+        store.remove(job.handle);
+    }
+    return result;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QSize>
+#include <QString>
+
+#include "ImageStore.h"
+
+class QThreadPool;
+
+// Shrinks stored images before they are inlined or uploaded: each image is
+// scaled down to the largest size the document displays it at (its width
+// and height attributes) and re-encoded. An image is only replaced when the
+// result is smaller. Images are processed in parallel on the thread pool.
+class ImageOptimizer {
+public:
+    enum class Format {
+        Keep,  // JPEG stays JPEG, everything else becomes PNG
+        Jpeg,  // JPEG unless the image has transparency
+        Png,
+    };
+
+    struct Options {
+        Format format = Format::Keep;
+        int    quality = 85;     // JPEG quality
+        bool   downscale = true;
+        qreal  scale = 1.0;      // pixels kept per displayed pixel
+    };
+
+    struct Report {
+        int    images = 0;       // distinct images looked at
+        int    optimized = 0;    // replaced by a smaller encoding
+        qint64 bytesBefore = 0;
+        qint64 bytesAfter = 0;
+
+        qint64 saved() const { return bytesBefore - bytesAfter; }
+    };
+
+    struct Result {
+        QHash<QString, QString> handles;  // old handle -> new handle
+        Report report;
+    };
+
+    // Options from the [optimize] section of config.ini.
+    static Options configured();
+
+    // Optimizes every image handle in html. The replaced originals are
+    // removed from the store; apply result.handles to the HTML.
+    static Result optimize(const QString &html, ImageStore &store, const Options &opt,
+                           QThreadPool *pool = nullptr);
+
+    // displayed holds one size per place the image is shown; a 0 width or
+    // height follows the aspect ratio, and 0x0 (or an empty list) keeps the
+    // full size. Null when the image cannot be decoded or would not get
+    // smaller.
+    static StoredImage optimizeImage(const StoredImage &img, const QList<QSize> &displayed,
+                                     const Options &opt);
+};
@@ -0,0 +1,111 @@
+#include "ImageStore.h"
+#include "Base64.h"
+#include "ImgScanner.h"
+
+#include <QCryptographicHash>
+#include <utility>
+
+static constexpr QStringView HandlePrefix = u"img:";
+
+bool ImageStore::isHandle(QStringView src) {
+    return src.startsWith(HandlePrefix);
+}
+
+QString ImageStore::handleFor(const QString &key) {
+    return QStringLiteral("img:") + key;
+}
+
+QString ImageStore::keyOf(QStringView handle) {
+    return handle.mid(HandlePrefix.size()).toString();
+}
+
+QString ImageStore::keyFor(const QByteArray &bytes) {
+    return QString::fromLatin1(QCryptographicHash::hash(bytes, QCryptographicHash::Sha256).toHex());
+}
+
+bool ImageStore::contains(const QString &key) const {
+    QMutexLocker locker(&_lock);
+    return _images.contains(key);
+}
+
+QString ImageStore::insert(const QString &key, const QByteArray &bytes, const QString &mime) {
+    QMutexLocker locker(&_lock);
+    if (!_images.contains(key)) {
+        _images.insert(key, StoredImage{ bytes, mime });
+        _bytes += bytes.size();
+    }
+    return handleFor(key);
+}
+
+QString ImageStore::insert(const QByteArray &bytes, const QString &mime) {
+    return insert(keyFor(bytes), bytes, mime);
+}
+
+QString ImageStore::insertDataUri(QStringView src) {
+    if (!src.startsWith(u"data:", Qt::CaseInsensitive)) return {};
+    const qsizetype comma = src.indexOf(u',');
+    if (comma < 0) return {};
+    const QStringView meta = src.mid(5, comma - 5);
+    if (!meta.endsWith(u";base64", Qt::CaseInsensitive)) return {};
+
+    QByteArray bytes = Base64::decode(src.mid(comma + 1).toLatin1());
+    if (bytes.isEmpty()) return {};
+    return insert(bytes, meta.chopped(7).toString());
+}
+
+StoredImage ImageStore::image(QStringView handle) const {
+    if (!isHandle(handle)) return {};
+    QMutexLocker locker(&_lock);
+    return _images.value(keyOf(handle));
+}
+
+QString ImageStore::dataUri(QStringView handle) const {
+    StoredImage img = image(handle);
+    if (img.isNull()) return {};
+    QString uri;
+    const QByteArray b64 = Base64::encode(img.bytes);
+    uri.reserve(img.mime.size() + 13 + b64.size());
+    uri += QStringLiteral("data:%1;base64,").arg(img.mime);
+    uri += QLatin1String(b64);
+    return uri;
+}
+
+QString ImageStore::toDataUris(QStringView html) const {
+    return ImgScanner::rewrite(html, [this](QStringView src) {
+        return isHandle(src) ? dataUri(src) : QString();
+    });
+}
+
+void ImageStore::remove(QStringView handle) {
+    if (!isHandle(handle)) return;
+    QMutexLocker locker(&_lock);
+    const auto it = _images.constFind(keyOf(handle));
+    if (it == _images.constEnd()) return;
+    _bytes -= it->bytes.size();
+    _images.erase(it);
+}
+
+void ImageStore::clear() {
+    QMutexLocker locker(&_lock);
+    _images.clear();
+    _bytes = 0;
+}
+
+void ImageStore::swap(ImageStore &other) {
+    if (&other == this) return;
+    // A fixed lock order, so two swaps in opposite directions cannot deadlock
+    QMutexLocker first(this < &other ? &_lock : &other._lock);
+    QMutexLocker second(this < &other ? &other._lock : &_lock);
+    _images.swap(other._images);
+    std::swap(_bytes, other._bytes);
+}
+
+int ImageStore::count() const {
+    QMutexLocker locker(&_lock);
+    return _images.size();
+}
+
+qint64 ImageStore::byteSize() const {
+    QMutexLocker locker(&_lock);
+    return _bytes;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringView>
+
+struct StoredImage {
+    QByteArray bytes;
+    QString    mime;
+
+    bool isNull() const { return bytes.isNull(); }
+};
+
+// Holds each distinct image once, as raw bytes keyed by the SHA-256 of its
+// content. Documents refer to images with short "img:<key>" handles in
+// place of data URIs; those are only built again by toDataUris() when the
+// HTML leaves the application. Safe to use from several threads.
+class ImageStore {
+public:
+    static bool isHandle(QStringView src);
+    static QString handleFor(const QString &key);
+    static QString keyOf(QStringView handle);
+    static QString keyFor(const QByteArray &bytes);
+
+    bool contains(const QString &key) const;
+
+    // Both return the handle of the stored image.
+    QString insert(const QString &key, const QByteArray &bytes, const QString &mime);
+    QString insert(const QByteArray &bytes, const QString &mime);
+    // Decodes a base64 data URI; returns a null QString if src is not one.
+    QString insertDataUri(QStringView src);
+
+    StoredImage image(QStringView handle) const;
+    QString dataUri(QStringView handle) const;
+    // Copy of html with every handle replaced by its data URI.
+    QString toDataUris(QStringView html) const;
+
+    void remove(QStringView handle);
+    void clear();
+    // Exchanges contents with a store filled elsewhere, e.g. on a worker.
+    void swap(ImageStore &other);
+    int count() const;
+    qint64 byteSize() const;
+
+private:
+    mutable QMutex _lock;
+    QHash<QString, StoredImage> _images;
+    qint64 _bytes = 0;
+};
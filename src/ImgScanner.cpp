@@ -0,0 +1,145 @@
+#include "ImgScanner.h"
+
+static bool isWordChar(QChar c) {
+    return c.isLetterOrNumber() || c == u'_';
+}
+
+static bool isSpace(QChar c) {
+    return c == u' ' || c == u'\t' || c == u'\n' || c == u'\r' || c == u'\f';
+}
+
+ImgScanner::ImgScanner(QStringView html)
+    : _html(html)
+{
+}
+
+bool ImgScanner::next(Tag &tag) {
+    const qsizetype n = _html.size();
+    while (_pos < n) {
+        qsizetype lt = _html.indexOf(u'<', _pos);
+        if (lt < 0 || lt + 4 > n) break;
+        _pos = lt + 1;
+        if (_html.mid(lt + 1, 3).compare(u"img", Qt::CaseInsensitive) != 0)
+            continue;
+        if (lt + 4 < n && isWordChar(_html[lt + 4]))
+            continue;
+        // Same extent as <img\b[^>]*>: the tag ends at the first '>'.
+        qsizetype gt = _html.indexOf(u'>', lt + 4);
+        if (gt < 0) break;
+
+        tag = Tag();
+        tag.start = lt;
+        tag.end = gt + 1;
+        findSrc(tag);
+        _pos = tag.end;
+        return true;
+    }
+    _pos = n;
+    return false;
+}
+
+// Finds the value of attribute name inside the tag [start, end).
+static bool findAttribute(QStringView html, qsizetype start, qsizetype end, QStringView attr,
+                          qsizetype &valStart, qsizetype &valEnd) {
+    qsizetype i = start + 4;
+    const qsizetype stop = end - 1;
+    while (i < stop) {
+        while (i < stop && (isSpace(html[i]) || html[i] == u'/')) ++i;
+        const qsizetype nameStart = i;
+        while (i < stop && !isSpace(html[i]) && html[i] != u'=' && html[i] != u'/') ++i;
+        const QStringView name = html.mid(nameStart, i - nameStart);
+        while (i < stop && isSpace(html[i])) ++i;
+        if (i >= stop || html[i] != u'=') {
+            if (name.isEmpty()) ++i;
+            continue;
+        }
+        ++i;
+        while (i < stop && isSpace(html[i])) ++i;
+
+        if (i < stop && (html[i] == u'"' || html[i] == u'\'')) {
+            const QChar quote = html[i];
+            valStart = i + 1;
+            valEnd = html.indexOf(quote, valStart);
+            if (valEnd < 0 || valEnd > stop) valEnd = stop;
+            i = valEnd + 1;
+        } else {
+            valStart = i;
+            while (i < stop && !isSpace(html[i])) ++i;
+            valEnd = i;
+        }
+
+        if (name.compare(attr, Qt::CaseInsensitive) == 0 && valEnd > valStart)
+            return true;
+    }
+    return false;
+}
+
+void ImgScanner::findSrc(Tag &tag) const {
+    qsizetype valStart, valEnd;
+    if (findAttribute(_html, tag.start, tag.end, u"src", valStart, valEnd)) {
+        tag.srcStart = valStart;
+        tag.srcEnd = valEnd;
+    }
+}
+
+QStringView ImgScanner::attribute(QStringView html, const Tag &tag, QStringView name) {
+    qsizetype valStart, valEnd;
+    if (!findAttribute(html, tag.start, tag.end, name, valStart, valEnd)) return {};
+    return html.mid(valStart, valEnd - valStart);
+}
+
+ImgScanner::Result ImgScanner::inlineAndMask(QStringView html, const Resolver &resolve) {
+    Result r;
+    r.html.reserve(html.size());
+    r.masked.reserve(html.size());
+
+    ImgScanner scanner(html);
+    Tag t;
+    qsizetype pos = 0;
+    int count = 0;
+    while (scanner.next(t)) {
+        const QStringView before = html.mid(pos, t.start - pos);
+        r.html += before;
+        r.masked += before;
+
+        const qsizetype tagStart = r.html.size();
+        QString src;
+        if (t.hasSrc())
+            src = resolve(html.mid(t.srcStart, t.srcEnd - t.srcStart));
+        if (!src.isNull()) {
+            r.html += html.mid(t.start, t.srcStart - t.start);
+            r.html += src;
+            r.html += html.mid(t.srcEnd, t.end - t.srcEnd);
+        } else {
+            r.html += html.mid(t.start, t.end - t.start);
+        }
+        r.tags << r.html.mid(tagStart);
+
+        r.masked += QStringLiteral("\n[Image omitted #%1]\n").arg(++count);
+        pos = t.end;
+    }
+    const QStringView tail = html.mid(pos);
+    r.html += tail;
+    r.masked += tail;
+    return r;
+}
+
+QString ImgScanner::rewrite(QStringView html, const Resolver &resolve) {
+    QString out;
+    ImgScanner scanner(html);
+    Tag t;
+    qsizetype pos = 0;
+    while (scanner.next(t)) {
+        if (!t.hasSrc()) continue;
+        QString src = resolve(html.mid(t.srcStart, t.srcEnd - t.srcStart));
+        if (src.isNull()) continue;
+        if (pos == 0)
+            out.reserve(html.size() + src.size());
+        out += html.mid(pos, t.srcStart - pos);
+        out += src;
+        pos = t.srcEnd;
+    }
+    if (pos == 0) return html.toString();
+    out += html.mid(pos);
+    return out;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <functional>
+
+// Forward-only tokenizer for <img> tags. Each call to next() reports the
+// offsets of the following tag and of its src attribute value, without
+// copying or modifying the input.
+class ImgScanner {
+public:
+    struct Tag {
+        qsizetype start = 0;      // offset of '<'
+        qsizetype end = 0;        // one past the closing '>'
+        qsizetype srcStart = -1;  // src value, -1 when the tag has none
+        qsizetype srcEnd = -1;
+
+        bool hasSrc() const { return srcStart >= 0; }
+    };
+
+    struct Result {
+        QString     html;    // tags with their src rewritten
+        QString     masked;  // tags replaced by [Image omitted #n]
+        QStringList tags;    // rewritten tags, in document order
+    };
+
+    // Returns the replacement for a src value, or a null QString to keep it.
+    using Resolver = std::function<QString(QStringView src)>;
+
+    explicit ImgScanner(QStringView html);
+
+    bool next(Tag &tag);
+
+    // Value of another attribute of a tag found by next(); empty if absent.
+    static QStringView attribute(QStringView html, const Tag &tag, QStringView name);
+
+    // Rewrites every src through resolve and masks every tag, in one pass.
+    static Result inlineAndMask(QStringView html, const Resolver &resolve);
+    // Rewrites every src through resolve; no masking.
+    static QString rewrite(QStringView html, const Resolver &resolve);
+
+private:
+    void findSrc(Tag &tag) const;
+
+    QStringView _html;
+    qsizetype   _pos = 0;
+};
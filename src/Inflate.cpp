@@ -0,0 +1,259 @@
+#include "Inflate.h"
+
+#include <cstring>
+
+using uchar = unsigned char;
+
+namespace {
+
+constexpr int MaxBits = 15;
+constexpr int FastBits = 10;
+
+// Canonical Huffman code. Codes up to FastBits long are decoded with one
+// table lookup; longer ones (rare) bit by bit from the code counts.
+struct Huffman {
+    quint16 fast[1 << FastBits];   // symbol << 4 | length, 0 when longer
+    quint16 count[MaxBits + 1];
+    quint16 symbol[288];
+
+    bool build(const uchar *lengths, int n) {
+        std::memset(count, 0, sizeof count);
+        for (int i = 0; i < n; ++i) ++count[lengths[i]];
+        count[0] = 0;
+        int left = 1;
+        for (int len = 1; len <= MaxBits; ++len) {
+            left = (left << 1) - count[len];
+            if (left < 0) return false;  // over-subscribed
+        }
+        quint16 offset[MaxBits + 2];
+        offset[1] = 0;
+        for (int len = 1; len <= MaxBits; ++len) offset[len + 1] = offset[len] + count[len];
+        for (int i = 0; i < n; ++i)
+            if (lengths[i]) symbol[offset[lengths[i]]++] = quint16(i);
+
+        std::memset(fast, 0, sizeof fast);
+        int code = 0;
+        for (int len = 1, index = 0; len <= FastBits; ++len) {
+            for (int k = 0; k < count[len]; ++k, ++code, ++index) {
+                // Codes are stored most significant bit first, read least first
+                int reversed = 0;
+                for (int b = 0; b < len; ++b) reversed |= ((code >> b) & 1) << (len - 1 - b);
+                const quint16 entry = quint16(symbol[index] << 4 | len);
+                for (int fill = reversed; fill < (1 << FastBits); fill += 1 << len)
+                    fast[fill] = entry;
+            }
+            code <<= 1;
+        }
+        return true;
+    }
+};
+
+// A DEFLATE stream cannot expand by more than about 1032 to 1
+constexpr qsizetype MaxRatio = 1032;
+constexpr qsizetype MaxOutput = qsizetype(1) << 31;
+
+class Decoder {
+public:
+    Decoder(QByteArrayView in, QByteArray &out, qsizetype start, qsizetype limit)
+        : _in(reinterpret_cast<const uchar *>(in.data())), _end(_in + in.size()), _out(out),
+          _pos(start), _limit(limit) {}
+
+    bool run() {
+        bool last;
+        do {
+            if (!need(3)) return false;
+            last = take(1);
+            const int type = int(take(2));
+            bool ok;
+            if (type == 0) ok = stored();
+            else if (type == 1) ok = fixed();
+            else if (type == 2) ok = dynamic();
+            else ok = false;
+            if (!ok) return false;
+        } while (!last);
+        _out.truncate(_pos);
+        return true;
+    }
+
+private:
+    void refill() {
+        while (_bits <= 56 && _in < _end) {
+            _buf |= quint64(*_in++) << _bits;
+            _bits += 8;
+        }
+    }
+    bool need(int n) {
+        if (_bits < n) refill();
+        return _bits >= n;
+    }
+    quint32 take(int n) {
+        const quint32 v = quint32(_buf & ((quint64(1) << n) - 1));
+        _buf >>= n;
+        _bits -= n;
+        return v;
+    }
+
+    int decode(const Huffman &h) {
+        if (_bits < MaxBits) refill();
+        const quint16 e = h.fast[_buf & ((1 << FastBits) - 1)];
+        if (e) {
+            const int len = e & 15;
+            if (len > _bits) return -1;
+            take(len);
+            return e >> 4;
+        }
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len <= MaxBits; ++len) {
+            if (!need(1)) return -1;
+            code |= int(take(1));
+            const int count = h.count[len];
+            if (code - first < count) return h.symbol[index + code - first];
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    bool reserve(qsizetype n) {
+        if (_pos + n > _limit) return false;
+        if (_pos + n <= _out.size()) return true;
+        _out.resize(qMin(_limit, qMax(_pos + n, qMax<qsizetype>(_out.size() * 2, 64 * 1024))));
+        return true;
+    }
+
+    bool stored() {
+        take(_bits & 7);  // to a byte boundary
+        if (!need(32)) return false;
+        const quint32 len = take(16);
+        if ((~take(16) & 0xffff) != len) return false;
+        if (!reserve(len)) return false;
+        char *o = _out.data() + _pos;
+        quint32 left = len;
+        while (left && _bits >= 8) {  // bytes already in the bit buffer
+            *o++ = char(take(8));
+            --left;
+        }
+        if (_end - _in < qsizetype(left)) return false;
+        std::memcpy(o, _in, left);
+        _in += left;
+        _pos += len;
+        return true;
+    }
+
+    bool fixed() {
+        uchar lengths[288 + 30];
+        int i = 0;
+        for (; i < 144; ++i) lengths[i] = 8;
+        for (; i < 256; ++i) lengths[i] = 9;
+        for (; i < 280; ++i) lengths[i] = 7;
+        for (; i < 288; ++i) lengths[i] = 8;
+        for (; i < 288 + 30; ++i) lengths[i] = 5;
+        return _lit.build(lengths, 288) && _dist.build(lengths + 288, 30) && codes();
+    }
+
+    bool dynamic() {
+        static constexpr uchar Order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        if (!need(14)) return false;
+        const int nlen = int(take(5)) + 257;
+        const int ndist = int(take(5)) + 1;
+        const int ncode = int(take(4)) + 4;
+        if (nlen > 286 || ndist > 30) return false;
+
+        uchar lengths[288 + 30] = {};
+        for (int i = 0; i < ncode; ++i) {
+            if (!need(3)) return false;
+            lengths[Order[i]] = uchar(take(3));
+        }
+        if (!_lit.build(lengths, 19)) return false;
+
+        for (int i = 0; i < nlen + ndist;) {
+            const int sym = decode(_lit);
+            if (sym < 0) return false;
+            if (sym < 16) {
+                lengths[i++] = uchar(sym);
+                continue;
+            }
+            int repeat;
+            uchar value = 0;
+            if (sym == 16) {
+                if (i == 0 || !need(2)) return false;
+                value = lengths[i - 1];
+                repeat = 3 + int(take(2));
+            } else if (sym == 17) {
+                if (!need(3)) return false;
+                repeat = 3 + int(take(3));
+            } else {
+                if (!need(7)) return false;
+                repeat = 11 + int(take(7));
+            }
+            if (i + repeat > nlen + ndist) return false;
+            while (repeat--) lengths[i++] = value;
+        }
+        if (lengths[256] == 0) return false;  // no end-of-block code
+        return _lit.build(lengths, nlen) && _dist.build(lengths + nlen, ndist) && codes();
+    }
+
+    bool codes() {
+        static constexpr quint16 LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static constexpr uchar LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                   3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static constexpr quint16 DistBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                                  193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+                                                  4097, 6145, 8193, 12289, 16385, 24577 };
+        static constexpr uchar DistExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                                 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+        while (true) {
+            int sym = decode(_lit);
+            if (sym < 0) return false;
+            if (sym < 256) {
+                if (!reserve(1)) return false;
+                _out.data()[_pos++] = char(sym);
+                continue;
+            }
+            if (sym == 256) return true;
+            sym -= 257;
+            if (sym >= 29 || !need(LengthExtra[sym])) return false;
+            const qsizetype len = LengthBase[sym] + take(LengthExtra[sym]);
+            const int dsym = decode(_dist);
+            if (dsym < 0 || dsym >= 30 || !need(DistExtra[dsym])) return false;
+            const qsizetype dist = DistBase[dsym] + take(DistExtra[dsym]);
+            if (dist > _pos - _start || !reserve(len)) return false;
+            char *o = _out.data() + _pos;
+            const char *from = o - dist;
+            if (dist >= len) {
+                std::memcpy(o, from, size_t(len));
+            } else {
+                for (qsizetype k = 0; k < len; ++k) o[k] = from[k];  // overlapping run
+            }
+            _pos += len;
+        }
+    }
+
+    const uchar *_in;
+    const uchar *_end;
+    QByteArray  &_out;
+    qsizetype    _pos;
+    qsizetype    _limit;  // end of the output allowed
+    qsizetype    _start = _pos;
+    quint64      _buf = 0;
+    int          _bits = 0;
+    Huffman      _lit;
+    Huffman      _dist;
+};
+
+} // namespace
+
+bool Inflate::inflate(QByteArrayView deflated, QByteArray &out, qsizetype sizeHint, qsizetype maxSize) {
+    const qsizetype start = out.size();
+    const qsizetype limit = qMin(maxSize >= 0 ? maxSize : MaxOutput, MaxOutput);
+    // The hint may come from an untrusted header: never allocate more than
+    // the input could expand to
+    sizeHint = qMin(sizeHint, qMin(limit, deflated.size() * MaxRatio + 1024));
+    if (sizeHint > 0) out.resize(start + sizeHint);
+    Decoder decoder(deflated, out, start, start + limit);
+    if (decoder.run()) return true;
+    out.truncate(start);
+    return false;
+}
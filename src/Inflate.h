@@ -0,0 +1,17 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+
+// Raw DEFLATE (RFC 1951) decoder, as used by ZIP entries. Qt only exposes
+// zlib through qUncompress(), which wants a zlib stream with an Adler-32
+// trailer that ZIP entries do not have.
+class Inflate {
+public:
+    // Appends the decompressed data to out; sizeHint, when known, avoids
+    // growing the buffer and is capped by what the input could expand to.
+    // False on corrupt or truncated input, or if more than maxSize bytes
+    // (at most 2 GiB) would come out.
+    static bool inflate(QByteArrayView deflated, QByteArray &out, qsizetype sizeHint = -1,
+                        qsizetype maxSize = -1);
+};
@@ -0,0 +1,75 @@
+#include "LazyMimeData.h"
+#include "RtfWriter.h"
+#include "Trace.h"
+
+#include <QTextDocumentFragment>
+
+static const QString HtmlMime = QStringLiteral("text/html");
+static const QString TextMime = QStringLiteral("text/plain");
+
+static const QStringList &rtfMimes() {
+    static const QStringList mimes = {
+        QStringLiteral("text/rtf"),
+        QStringLiteral("application/rtf"),
+#ifdef Q_OS_WIN
+        // Word and WordPad only look for the native clipboard format
+        QStringLiteral("application/x-qt-windows-mime;value=\"Rich Text Format\""),
+#endif
+    };
+    return mimes;
+}
+
+LazyMimeData::LazyMimeData(const HtmlDocument &doc, const ImageStore &images)
+    : _doc(doc)
+{
+    for (int image : _doc.usedImages()) {
+        const QString src = _doc.src(image);
+        if (!ImageStore::isHandle(src)) continue;
+        const StoredImage img = images.image(src);
+        if (!img.isNull())
+            _images.insert(ImageStore::keyOf(src), img.bytes, img.mime);
+    }
+}
+
+QStringList LazyMimeData::formats() const {
+    return QStringList{ HtmlMime } + rtfMimes() + QStringList{ TextMime };
+}
+
+bool LazyMimeData::hasFormat(const QString &mimeType) const {
+    return mimeType == HtmlMime || mimeType == TextMime || rtfMimes().contains(mimeType);
+}
+
+QVariant LazyMimeData::retrieveData(const QString &mimeType, QMetaType type) const {
+    if (mimeType == HtmlMime) return html();
+    if (mimeType == TextMime) return text();
+    if (rtfMimes().contains(mimeType)) return rtf();
+    return QMimeData::retrieveData(mimeType, type);
+}
+
+QString LazyMimeData::html() const {
+    if (_html.isNull()) {
+        const Trace::Scope trace("copy_html");
+        _html = _doc.html([this](QStringView src) {
+            return ImageStore::isHandle(src) ? _images.dataUri(src) : QString();
+        });
+    }
+    return _html;
+}
+
+QByteArray LazyMimeData::rtf() const {
+    if (_rtf.isNull()) {
+        const Trace::Scope trace("copy_rtf");
+        _rtf = RtfWriter::toRtf(_doc.html(), &_images);
+    }
+    return _rtf;
+}
+
+QString LazyMimeData::text() const {
+    if (_text.isNull()) {
+        const Trace::Scope trace("copy_text");
+        // The handles are never resolved; only the text is wanted
+        _text = QTextDocumentFragment::fromHtml(_doc.html()).toPlainText();
+        _text.remove(QChar::ObjectReplacementCharacter);
+    }
+    return _text;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMimeData>
+#include <QString>
+
+#include "HtmlDocument.h"
+#include "ImageStore.h"
+
+// Clipboard data for the whole document that is only built when a program
+// asks for it: HTML with the images as data URIs, RTF, or plain text. Each
+// format is produced on its first request and kept, so pasting into a
+// plain-text field never encodes an image. Holds its own copy of the
+// document and of the images it uses (shared, not duplicated), so a later
+// paste cannot change what was copied.
+class LazyMimeData : public QMimeData {
+    Q_OBJECT
+public:
+    LazyMimeData(const HtmlDocument &doc, const ImageStore &images);
+
+    QStringList formats() const override;
+    bool hasFormat(const QString &mimeType) const override;
+
+protected:
+    QVariant retrieveData(const QString &mimeType, QMetaType type) const override;
+
+private:
+    QString html() const;
+    QByteArray rtf() const;
+    QString text() const;
+
+    HtmlDocument _doc;
+    ImageStore   _images;
+
+    mutable QString    _html;
+    mutable QByteArray _rtf;
+    mutable QString    _text;
+};
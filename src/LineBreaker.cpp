@@ -0,0 +1,119 @@
+#include "LineBreaker.h"
+
+#include <initializer_list>
+
+static bool isNameChar(QChar c) {
+    return c.isLetterOrNumber() || c == u':' || c == u'-' || c == u'_';
+}
+
+static bool is(QStringView name, QStringView other) {
+    return name.compare(other, Qt::CaseInsensitive) == 0;
+}
+
+// Whitespace before these opening tags is not rendered.
+static bool isBlock(QStringView name) {
+    for (QStringView b : { u"p", u"div", u"br", u"table", u"tr", u"td", u"th", u"thead",
+                           u"tbody", u"ul", u"ol", u"li", u"h1", u"h2", u"h3", u"h4", u"h5",
+                           u"h6", u"blockquote", u"hr" }) {
+        if (is(name, b)) return true;
+    }
+    return false;
+}
+
+// Elements whose text must keep its whitespace as it is.
+static bool isVerbatim(QStringView name) {
+    return is(name, u"pre") || is(name, u"textarea") || is(name, u"script") || is(name, u"style");
+}
+
+// Whether the '<' at i opens a tag, end tag, comment or declaration.
+static bool startsMarkup(QStringView html, qsizetype i) {
+    if (i + 1 >= html.size()) return false;
+    const QChar c = html[i + 1];
+    return c.isLetter() || c == u'/' || c == u'!' || c == u'?';
+}
+
+// Offset just past the construct (tag or comment) starting with '<' at
+// from; the end of html if it is not closed.
+static qsizetype markupEnd(QStringView html, qsizetype from) {
+    if (html.mid(from, 4) == u"<!--") {
+        const qsizetype end = html.indexOf(u"-->", from + 4);
+        return end < 0 ? html.size() : end + 3;
+    }
+    QChar quote;
+    for (qsizetype i = from + 1; i < html.size(); ++i) {
+        const QChar c = html[i];
+        if (!quote.isNull()) {
+            if (c == quote) quote = QChar();
+        } else if (c == u'"' || c == u'\'') {
+            quote = c;
+        } else if (c == u'>') {
+            return i + 1;
+        }
+    }
+    return html.size();
+}
+
+QString LineBreaker::breakLines(QStringView html, int width) {
+    if (width <= 0) return html.toString();
+    QString out;
+    out.reserve(html.size() + html.size() / width + 16);
+    qsizetype lineStart = 0;  // in out
+    QStringView verbatim;     // element whose end tag is awaited
+    qsizetype i = 0;
+    while (i < html.size()) {
+        if (html[i] == u'<' && startsMarkup(html, i)) {
+            const qsizetype end = markupEnd(html, i);
+            const bool closing = html[i + 1] == u'/';
+            qsizetype n = i + (closing ? 2 : 1);
+            const qsizetype nameStart = n;
+            while (n < end && isNameChar(html[n])) ++n;
+            const QStringView name = html.mid(nameStart, n - nameStart);
+            if (!verbatim.isEmpty()) {
+                if (closing && is(name, verbatim)) verbatim = QStringView();
+            } else if (!name.isEmpty()) {
+                if (!closing && isBlock(name) && out.size() - lineStart >= width && !out.endsWith(u'\n')) {
+                    out += u'\n';
+                    lineStart = out.size();
+                }
+                if (!closing && isVerbatim(name)) verbatim = name;
+            }
+            const QStringView markup = html.mid(i, end - i);
+            out += markup;
+            const qsizetype nl = markup.lastIndexOf(u'\n');
+            if (nl >= 0) lineStart = out.size() - markup.size() + nl + 1;
+            i = end;
+            continue;
+        }
+        // Text up to the next tag; a '<' that starts no tag is text
+        qsizetype next = html.indexOf(u'<', i + 1);
+        if (next < 0) next = html.size();
+        while (next < html.size() && !startsMarkup(html, next)) {
+            next = html.indexOf(u'<', next + 1);
+            if (next < 0) next = html.size();
+        }
+        while (i < next) {
+            const qsizetype room = width - (out.size() - lineStart);
+            if (!verbatim.isEmpty() || room > 0) {
+                // Copy up to where the line is full
+                const qsizetype stop = verbatim.isEmpty() ? qMin(next, i + room) : next;
+                const QStringView run = html.mid(i, stop - i);
+                out += run;
+                const qsizetype nl = run.lastIndexOf(u'\n');
+                if (nl >= 0) lineStart = out.size() - run.size() + nl + 1;
+                i = stop;
+                continue;
+            }
+            // The line is full: break at the next space or line break
+            qsizetype at = i;
+            while (at < next && html[at] != u' ' && html[at] != u'\n') ++at;
+            out += html.mid(i, at - i);
+            if (at < next) {
+                out += u'\n';
+                lineStart = out.size();
+                ++at;
+            }
+            i = at;
+        }
+    }
+    return out;
+}
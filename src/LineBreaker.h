@@ -0,0 +1,15 @@
+#pragma once
+
+#include <QString>
+#include <QStringView>
+
+// Breaks HTML into lines of about a given width for the source pane. Word
+// often puts a whole document on a handful of lines, and an editor lays out
+// and highlights a line as one block. Once a line reaches the width it is
+// broken before the next block-level tag, or at the next space in text,
+// which renders the same. The contents of <pre>, <textarea>, <script> and
+// <style>, comments and tags themselves are copied unchanged.
+class LineBreaker {
+public:
+    static QString breakLines(QStringView html, int width);
+};
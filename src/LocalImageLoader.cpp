@@ -0,0 +1,97 @@
+#include "LocalImageLoader.h"
+#include "ImageStore.h"
+#include "ImgScanner.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMimeDatabase>
+#include <QSet>
+#include <QThreadPool>
+#include <QUrl>
+#include <QtConcurrent/QtConcurrentMap>
+
+static bool isRemoteOrHandle(QStringView src) {
+    return src.startsWith(u"http:", Qt::CaseInsensitive)
+        || src.startsWith(u"https:", Qt::CaseInsensitive)
+        || ImageStore::isHandle(src);
+}
+
+QStringList LocalImageLoader::collectSources(QStringView html) {
+    QStringList srcs;
+    QSet<QString> seen;
+    ImgScanner scanner(html);
+    ImgScanner::Tag t;
+    while (scanner.next(t)) {
+        if (!t.hasSrc()) continue;
+        const QStringView src = html.mid(t.srcStart, t.srcEnd - t.srcStart);
+        if (isRemoteOrHandle(src)) continue;
+        QString s = src.toString();
+        if (seen.contains(s)) continue;
+        seen.insert(s);
+        srcs << s;
+    }
+    return srcs;
+}
+
+QString LocalImageLoader::load(const QString &src, ImageStore &store, const QString &baseDir, Files files) {
+    if (src.startsWith(u"data:", Qt::CaseInsensitive))
+        return store.insertDataUri(src);
+    if (files == UnderBaseDir && baseDir.isEmpty())
+        return {};
+
+    QUrl url(src);
+    QString raw = url.isLocalFile() ? url.toLocalFile() : QString(src).replace('\\','/');
+    if (!baseDir.isEmpty() && QDir::isRelativePath(raw))
+        raw = QDir(baseDir).filePath(raw);
+    QFileInfo fi(raw);
+    // Saved HTML percent-encodes relative paths ("image%20001.png")
+    if (!fi.exists() && raw.contains('%'))
+        fi.setFile(QUrl::fromPercentEncoding(raw.toUtf8()));
+    if (!fi.exists()) return {};
+    if (files == UnderBaseDir) {
+        // After symlinks and "..", so nothing leads out of baseDir
+        const QString root = QDir(baseDir).canonicalPath();
+        if (root.isEmpty() || !fi.canonicalFilePath().startsWith(root + '/'))
+            return {};
+    }
+    QFile f(fi.absoluteFilePath());
+    if (!f.open(QIODevice::ReadOnly)) return {};
+
+    // QMimeDatabase shares one global, thread-safe database between instances.
+    QString mime = QMimeDatabase().mimeTypeForFile(fi).name();
+
+    if (f.size() >= MapThreshold) {
+        if (uchar *p = f.map(0, f.size())) {
+            const QByteArray mapped =
+                QByteArray::fromRawData(reinterpret_cast<const char *>(p), f.size());
+            const QString key = ImageStore::keyFor(mapped);
+            // The copy detaches the bytes from the mapping before unmap().
+            QString handle = store.contains(key)
+                           ? ImageStore::handleFor(key)
+                           : store.insert(key, QByteArray(mapped.constData(), mapped.size()), mime);
+            f.unmap(p);
+            return handle;
+        }
+    }
+    QByteArray bytes = f.readAll();
+    if (bytes.isEmpty()) return {};
+    return store.insert(bytes, mime);
+}
+
+QHash<QString, QString> LocalImageLoader::loadAll(const QStringList &srcs, ImageStore &store,
+                                                  const QString &baseDir, QThreadPool *pool, Files files) {
+    QHash<QString, QString> handles;
+    if (srcs.isEmpty()) return handles;
+
+    const QStringList loaded = QtConcurrent::blockingMapped<QStringList>(
+        pool ? pool : QThreadPool::globalInstance(), srcs,
+        [&store, &baseDir, files](const QString &src) { return load(src, store, baseDir, files); });
+
+    handles.reserve(srcs.size());
+    for (qsizetype i = 0; i < srcs.size(); ++i) {
+        if (!loaded[i].isNull())
+            handles.insert(srcs[i], loaded[i]);
+    }
+    return handles;
+}
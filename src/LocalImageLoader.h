@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+
+class ImageStore;
+class QThreadPool;
+
+// Moves the images referenced by <img src> into an ImageStore: local files
+// and inline base64 data URIs. Reading, MIME sniffing, hashing and decoding
+// run on a thread pool; files above a size threshold are memory-mapped and
+// only copied when the store does not hold them yet.
+class LocalImageLoader {
+public:
+    // Which local files may be read. UnderBaseDir is for documents from
+    // someone else: only files inside baseDir, and none when it is empty.
+    enum Files { AnyFile, UnderBaseDir };
+
+    // Distinct src values in the document that can be ingested.
+    static QStringList collectSources(QStringView html);
+
+    // Store handle for src, or a null QString if it could not be loaded or
+    // is a file that may not be read. Relative paths are resolved against
+    // baseDir.
+    static QString load(const QString &src, ImageStore &store, const QString &baseDir = QString(),
+                        Files files = AnyFile);
+
+    // src -> store handle for every source that could be loaded.
+    static QHash<QString, QString> loadAll(const QStringList &srcs, ImageStore &store,
+                                           const QString &baseDir = QString(),
+                                           QThreadPool *pool = nullptr, Files files = AnyFile);
+
+private:
+    static constexpr qint64 MapThreshold = 1024 * 1024;
+};
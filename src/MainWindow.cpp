@@ -1,5 +1,11 @@
 #include "MainWindow.h"
-#include <QTextEdit>
+#include "Config.h"
+#include "Converter.h"
+#include "ImageMarkerHighlighter.h"
+#include "LazyMimeData.h"
+#include "PreviewBrowser.h"
+#include "Trace.h"
+#include <QPlainTextEdit>
 #include <QTextBrowser>
 #include <QPushButton>
 #include <QSplitter>
@@ -12,11 +18,11 @@
 #include <QProgressDialog>
 #include <QMessageBox>
 #include <QFile>
+#include <QFileDialog>
 #include <QFileInfo>
 #include <QMimeDatabase>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QEventLoop>
 #include <QtNetwork/QHttpMultiPart>
 #include <QtNetwork/QNetworkReply>
 #include <QDateTime>
@@ -28,34 +34,10 @@
 #include <QCryptographicHash>
 #include <QMessageAuthenticationCode>
 #include <QtNetwork/QHttpPart>
-#include <QDebug>
+#include <QRandomGenerator>
 #include <QTimer>
 #include <QSet>
-#include <QRandomGenerator>
-
-#include <QSettings>
-
-// Load endpoints from config file (e.g., config.ini in the application directory)
-static QSettings settings(QStringLiteral("config.ini"), QSettings::IniFormat);
-
-static const QString STS_URL        = settings.value("oss/sts_url").toString();
-static const QString OSS_UPLOAD_URL = settings.value("oss/oss_upload_url").toString();
-static const QString OSS_BASE_URL   = settings.value("oss/oss_base_url").toString();
-
-ImageMarkerHighlighter::ImageMarkerHighlighter(QTextDocument *doc)
-    : QSyntaxHighlighter(doc),
-      _pattern(QStringLiteral("\\[Image omitted #\\d+\\]"))
-{
-    _format.setBackground(Qt::yellow);
-}
-
-void ImageMarkerHighlighter::highlightBlock(const QString &text) {
-    auto it = _pattern.globalMatch(text);
-    while (it.hasNext()) {
-        auto m = it.next();
-        setFormat(m.capturedStart(), m.capturedLength(), _format);
-    }
-}
+#include <memory>
 
 MainWindow::MainWindow(QWidget *parent)
     : QWidget(parent)
@@ -65,8 +47,8 @@ MainWindow::MainWindow(QWidget *parent)
     auto *splitter = new QSplitter(Qt::Horizontal, this);
 
     // Left pane
-    _srcEdit = new QTextEdit;
-    _srcEdit->setAcceptRichText(false);
+    // Plain text layout stays fast on documents of many megabytes
+    _srcEdit = new QPlainTextEdit;
     new ImageMarkerHighlighter(_srcEdit->document());
     auto *leftW = new QWidget;
     auto *lLayout = new QVBoxLayout(leftW);
@@ -75,13 +57,16 @@ MainWindow::MainWindow(QWidget *parent)
     lLayout->addWidget(_srcEdit);
 
     // Right pane
-    _preview = new QTextBrowser;
+    _preview = new PreviewBrowser;
+    _preview->setImageStore(&_images);
+    _preview->setExternalLoader(&_external);
     _preview->setOpenExternalLinks(true);
     _preview->setReadOnly(false);
     auto *rightW = new QWidget;
     auto *rLayout = new QVBoxLayout(rightW);
     rLayout->setContentsMargins(0,0,0,0);
-    rLayout->addWidget(new QLabel("Rendered Preview:"));
+    _previewLabel = new QLabel("Rendered Preview:");
+    rLayout->addWidget(_previewLabel);
     rLayout->addWidget(_preview);
 
     splitter->addWidget(leftW);
@@ -90,14 +75,16 @@ MainWindow::MainWindow(QWidget *parent)
     // Buttons
     auto *buttonLayout = new QHBoxLayout;
     QPushButton *pasteBtn     = new QPushButton("Paste from Word");
-    QPushButton *copyHtmlBtn  = new QPushButton("Copy as HTML");
-    QPushButton *copyRtfBtn   = new QPushButton("Copy as Rich Text");
+    QPushButton *openBtn      = new QPushButton("Open .docx");
+    QPushButton *copyBtn      = new QPushButton("Copy");
     QPushButton *confirmBtn   = new QPushButton("Confirm");
     buttonLayout->addWidget(pasteBtn);
-    buttonLayout->addWidget(copyHtmlBtn);
-    buttonLayout->addWidget(copyRtfBtn);
+    buttonLayout->addWidget(openBtn);
+    buttonLayout->addWidget(copyBtn);
     buttonLayout->addWidget(confirmBtn);
     buttonLayout->addStretch();
+    _status = new QLabel;
+    buttonLayout->addWidget(_status);
 
     auto *mainLayout = new QVBoxLayout(this);
     mainLayout->addWidget(splitter);
@@ -105,408 +92,247 @@ MainWindow::MainWindow(QWidget *parent)
 
     // Connections
     connect(pasteBtn,    &QPushButton::clicked, this, &MainWindow::pasteFromWord);
-    connect(copyHtmlBtn, &QPushButton::clicked, this, &MainWindow::copyHtml);
-    connect(copyRtfBtn,  &QPushButton::clicked, this, &MainWindow::copyRtf);
+    connect(openBtn,     &QPushButton::clicked, this, &MainWindow::openDocx);
+    connect(copyBtn,     &QPushButton::clicked, this, &MainWindow::copy);
     connect(confirmBtn,  &QPushButton::clicked, this, &MainWindow::confirmAndUpload);
-    connect(_srcEdit,    &QTextEdit::textChanged, this, &MainWindow::syncFromSource);
+    connect(_srcEdit,    &QPlainTextEdit::textChanged, this, &MainWindow::scheduleSyncFromSource);
     connect(_preview,    &QTextBrowser::textChanged, this, &MainWindow::syncFromPreview);
-}
 
-std::pair<QString, QString> MainWindow::inlineAndMask(const QString &html) {
-    QString inl = html;
-    QRegularExpression reImg(R"(<img\b[^>]+src=['"]([^'"]+)['"][^>]*>)",
-                             QRegularExpression::CaseInsensitiveOption);
-    int pos = 0;
-    QRegularExpressionMatch m;
-    while ((m = reImg.match(inl, pos)).hasMatch()) {
-        QString header;
-        QByteArray data = fetchLocalImage(m.captured(1), header);
-        if (!data.isEmpty()) {
-            QString tag = m.captured(0);
-            tag.replace(m.captured(1), header + QString::fromLatin1(data.toBase64()));
-            inl.replace(m.capturedStart(), m.capturedLength(), tag);
-            pos = m.capturedStart() + tag.length();
-        } else {
-            pos = m.capturedEnd();
-        }
-    }
-
-    _imgTags = inl.split(QRegularExpression(R"(<img\b[^>]*>)"), Qt::SkipEmptyParts);
-
-    QString masked;
-    int count = 0;
-    QRegularExpression reAll(R"(<img\b[^>]*>)",
-                             QRegularExpression::CaseInsensitiveOption);
-    pos = 0;
-    while ((m = reAll.match(inl, pos)).hasMatch()) {
-        masked += inl.mid(pos, m.capturedStart() - pos);
-        masked += QString("\n[Image omitted #%1]\n").arg(++count);
-        pos = m.capturedEnd();
-    }
-    masked += inl.mid(pos);
-    return { inl, masked };
+    // Coalesce keystrokes into one preview update
+    _renderer.setDocument(_preview->document());
+    _sourceSync.setSingleShot(true);
+    _sourceSync.setInterval(Config::previewSyncDelayMs());
+    connect(&_sourceSync, &QTimer::timeout, this, &MainWindow::syncFromSource);
+    connect(&_paste, &QFutureWatcher<PastePipeline::Result>::finished, this, &MainWindow::pasteFinished);
+
+    if (Config::uploadCacheEnabled())
+        _uploads.setCache(&_uploadCache);
+    if (Config::uploadJournalEnabled())
+        _uploads.setJournal(&_uploadJournal);
 }
 
-QByteArray MainWindow::fetchLocalImage(const QString &src, QString &header) {
-    QUrl url(src);
-    QString raw = url.isLocalFile() ? url.toLocalFile() : QString(src).replace('\\','/');
-    QFileInfo fi(raw);
-    if (!fi.exists()) return {};
-    QFile f(fi.absoluteFilePath());
-    if (!f.open(QIODevice::ReadOnly)) return {};
-    QByteArray bytes = f.readAll();
-    QString mime = QMimeDatabase().mimeTypeForFile(fi).name();
-    header = QString("data:%1;base64,").arg(mime);
-    return bytes;
+HtmlDocument MainWindow::inlineAndMask(const QString &html) {
+    return HtmlDocument(Converter::inlineAndMask(html, _images).html);
 }
 
 void MainWindow::pasteFromWord() {
+    if (_paste.isRunning()) return;
     auto *cb = QGuiApplication::clipboard();
-    QString raw = cb->mimeData()->hasHtml()
-                ? cb->mimeData()->html()
-                : cb->mimeData()->hasText()
-                  ? cb->mimeData()->text()
-                  : QString();
+    const QString raw = cb->mimeData()->hasHtml()
+                      ? cb->mimeData()->html()
+                      : cb->mimeData()->hasText()
+                        ? cb->mimeData()->text()
+                        : QString();
     if (raw.isEmpty()) return;
-    auto [inl, masked] = inlineAndMask(raw);
-    _fullHtml = inl;
+    startPipeline(PastePipeline::start(raw, PastePipeline::configured()), "Pasting…");
+}
+
+void MainWindow::openDocx() {
+    if (_paste.isRunning()) return;
+    const QString path = QFileDialog::getOpenFileName(this, "Open Word document", QString(),
+                                                      "Word documents (*.docx)");
+    if (path.isEmpty()) return;
+    startPipeline(PastePipeline::open(path, PastePipeline::configured()), "Opening…");
+}
+
+void MainWindow::startPipeline(const QFuture<PastePipeline::Result> &future, const QString &label) {
+    // Only shown if it takes a noticeable time
+    auto *pd = new QProgressDialog(label, "Cancel", 0, PastePipeline::Stages, this);
+    pd->setWindowModality(Qt::WindowModal);
+    pd->setMinimumDuration(300);
+    pd->setAttribute(Qt::WA_DeleteOnClose);
+    connect(pd, &QProgressDialog::canceled, &_paste, &QFutureWatcherBase::cancel);
+    connect(&_paste, &QFutureWatcherBase::progressValueChanged, pd, &QProgressDialog::setValue);
+    connect(&_paste, &QFutureWatcherBase::progressTextChanged, pd, &QProgressDialog::setLabelText);
+    connect(&_paste, &QFutureWatcherBase::finished, pd, &QProgressDialog::close);
+
+    _paste.setFuture(future);
+}
+
+void MainWindow::pasteFinished() {
+    if (_paste.isCanceled() || _paste.future().resultCount() == 0) {
+        _status->setText("Canceled");
+        _paste.setFuture(QFuture<PastePipeline::Result>());
+        return;
+    }
+    PastePipeline::Result r = _paste.future().takeResult();
+    _paste.setFuture(QFuture<PastePipeline::Result>());
+    if (!r.error.isEmpty()) {
+        QMessageBox::warning(this, "Open .docx", r.error);
+        return;
+    }
+
+    _images.swap(*r.images);
+    _doc = std::move(r.doc);
+    _external.forgetFailures();
+    if (r.optimized)
+        _status->setText(QString("Images: %1 of %2 optimized, %3 KiB → %4 KiB")
+                         .arg(r.report.optimized).arg(r.report.images)
+                         .arg(r.report.bytesBefore / 1024).arg(r.report.bytesAfter / 1024));
+    else
+        _status->clear();
+
+    // The document is final; the preview only shows it, it is not read back
     _syncing = true;
-    _srcEdit->setPlainText(masked);
-    _preview->setHtml(inl);
+    _srcEdit->setPlainText(_doc.masked());
+    {
+        const Trace::Scope trace("render");
+        _preview->setHtml(_doc.html());
+    }
+    _renderer.reset();
+    _sourceSync.stop();
     _syncing = false;
-    // Load external images after syncing is done
-    loadExternalImages();
+    showPreviewStats();
+}
 
-    // use html from preview
-    MainWindow::syncFromPreview();
+void MainWindow::scheduleSyncFromSource() {
+    if (_syncing) return;
+    _sourceSync.start();
 }
 
 void MainWindow::syncFromSource() {
     if (_syncing) return;
     _syncing = true;
-    QString text = _srcEdit->toPlainText();
-    QString out;
-    auto parts = text.split(QRegularExpression(R"(\[Image omitted #\d+\])"),
-                            Qt::KeepEmptyParts);
-    for (const auto &p : parts) {
-        QRegularExpression re(R"(\[Image omitted #(\d+)\])");
-        auto m = re.match(p);
-        if (m.hasMatch()) {
-            int idx = m.captured(1).toInt() - 1;
-            if (idx >= 0 && idx < _imgTags.size())
-                out += _imgTags[idx];
-        } else {
-            out += p;
-        }
+    {
+        const Trace::Scope trace("render");
+        // Markers keep pointing at the same tags, so only the text changes
+        _doc.setMasked(_srcEdit->toPlainText());
+        _renderer.render(_doc.html());
     }
-    _preview->setHtml(out);
     _syncing = false;
-    // Load external images after syncing is done
-    loadExternalImages();
+    showPreviewStats();
 }
 
-void MainWindow::loadExternalImages() {
-    if (_syncing) {
-        qDebug() << "Skipping loadExternalImages() - syncing in progress";
-        return;
-    }
-    
-    qDebug() << "loadExternalImages() called";
-    auto *doc = _preview->document();
-    const QString html = _preview->toHtml();
-
-    // Regex to find all distinct http(s) image URLs
-    QRegularExpression re(
-        R"(<img\b[^>]*\bsrc=['"](https?://[^'"]+)['"][^>]*>)",
-        QRegularExpression::CaseInsensitiveOption
-    );
-
-    QSet<QString> seen;
-    auto it = re.globalMatch(html);
-    int imageCount = 0;
-    int loadedCount = 0;
-    while (it.hasNext()) {
-        QString url = it.next().captured(1);
-        if (seen.contains(url)) continue;
-        seen.insert(url);
-        imageCount++;
-
-        qDebug() << "Loading external image:" << url;
-
-        // Synchronous fetch with timeout and error handling
-        QNetworkRequest req((QUrl(url)));
-        req.setRawHeader("User-Agent", "convertrt/1.0");
-        req.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
-        
-        QNetworkReply *reply = _networkManager.get(req);
-        QEventLoop loop;
-        QTimer timer;
-        timer.setSingleShot(true);
-        timer.setInterval(10000); // 10 second timeout
-        
-        // Set up connections
-        connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-        connect(&timer, &QTimer::timeout, [&loop, reply]() {
-            reply->abort(); // Abort the request on timeout
-            loop.quit();
-        });
-        
-        timer.start();
-        loop.exec();
-        timer.stop();
-
-        if (reply->error() == QNetworkReply::NoError) {
-            QByteArray data = reply->readAll();
-            QImage img;
-            if (img.loadFromData(data)) {
-                doc->addResource(QTextDocument::ImageResource, QUrl(url), img);
-                qDebug() << "Successfully loaded image:" << url;
-                loadedCount++;
-            } else {
-                qDebug() << "Failed to decode image data for:" << url;
-            }
-        } else if (reply->error() == QNetworkReply::OperationCanceledError) {
-            qDebug() << "Timeout loading image:" << url;
-        } else {
-            qDebug() << "Network error loading image:" << url << "Error:" << reply->errorString();
-        }
-        reply->deleteLater();
-    }
-
-    qDebug() << "Found" << imageCount << "external images, loaded" << loadedCount << "successfully";
-    
-    // Only re-apply HTML if we loaded any images
-    if (loadedCount > 0) {
-        _syncing = true;
-        _preview->setHtml(html);
-        _syncing = false;
-    }
-    qDebug() << "loadExternalImages() completed";
+void MainWindow::showPreviewStats() {
+    // For tuning [preview] image_cache_mb; shown when hovering the title
+    const DecodedImageCache::Stats s = _preview->imageCache().stats();
+    _previewLabel->setToolTip(QString("Decoded images: %1, %2 of %3 MiB, %4% hits (%5 decoded)")
+                              .arg(s.images)
+                              .arg(s.bytes / (1024.0 * 1024.0), 0, 'f', 1)
+                              .arg(s.maxBytes / (1024 * 1024))
+                              .arg(qRound(s.hitRate() * 100))
+                              .arg(s.misses));
 }
 
 void MainWindow::syncFromPreview() {
     if (_syncing) return;
     _syncing = true;
-    auto [inl, masked] = inlineAndMask(_preview->toHtml());
-    _fullHtml = inl;
-    _srcEdit->setPlainText(masked);
+    _doc = inlineAndMask(_preview->toHtml());
+    _srcEdit->setPlainText(_doc.masked());
+    // The preview was edited directly; the renderer's chunks are stale
+    _renderer.reset();
+    _sourceSync.stop();
     _syncing = false;
-    // Load external images after syncing is done
-    loadExternalImages();
 }
 
-void MainWindow::copyHtml() {
-    QGuiApplication::clipboard()->setText(_fullHtml);
-}
-
-void MainWindow::copyRtf() {
-    QTextEdit tmp;
-    tmp.setHtml(_fullHtml);
-    tmp.selectAll();
-    tmp.copy();
+void MainWindow::copy() {
+    // Each format is built when a program asks for it
+    QGuiApplication::clipboard()->setMimeData(new LazyMimeData(_doc, _images));
 }
 
 void MainWindow::confirmAndUpload() {
-    QRegularExpression re(R"(data:image/[^;]+;base64,[^"']+)");
-    auto it = re.globalMatch(_fullHtml);
-    
-    // Store each image instance separately, even if they're identical
-    QList<QString> allDataUris;
-    QList<QString> uploadedUrls;
-    
-    while (it.hasNext()) {
-        auto match = it.next();
-        allDataUris.append(match.captured(0));
+    if (_uploads.isRunning() || _rehost.isRunning()) return;
+
+    // One upload per image the text still refers to, and one copy per
+    // distinct image linked from another host when re-hosting is on
+    QStringList allHandles;
+    QStringList remote;
+    QSet<QString> seen;
+    const bool rehost = Config::rehostRemoteImages();
+    _uploading.clear();
+    for (int image : _doc.usedImages()) {
+        const QString src = _doc.src(image);
+        if (ImageStore::isHandle(src)) {
+            allHandles << src;
+            _uploading << image;
+        } else if (rehost && RemoteRehoster::isRemote(src) && !seen.contains(src)) {
+            seen.insert(src);
+            remote << src;
+        }
     }
-    
-    int total = allDataUris.size();
+
+    int total = allHandles.size() + remote.size();
     if (!total) return;
 
-    qDebug() << "Found" << total << "images to upload";
-
-    QProgressDialog pd("Uploading images…", "Cancel", 0, total, this);
-    pd.setWindowModality(Qt::WindowModal);
-    pd.show();
-
-    int success = 0;
-    uploadedUrls.resize(total); // Pre-allocate to match allDataUris size
-    
-    // Upload each image individually, creating unique URLs for each instance
-    for (int i = 0; i < allDataUris.size(); ++i) {
-        if (pd.wasCanceled()) break;
-        
-        QString uri = allDataUris[i];
-        QString header = uri.section(',', 0, 0) + ",";
-        QByteArray data = QByteArray::fromBase64(uri.section(',', 1).toLatin1());
-        
-        qDebug() << "Uploading image" << (i+1) << "of" << total << "- size:" << data.size() << "bytes";
-        
-        try {
-            QString uploadedUrl = uploadToOss(header, data);
-            uploadedUrls[i] = uploadedUrl;
-            ++success;
-            qDebug() << "Successfully uploaded image" << (i+1) << "to:" << uploadedUrl;
-        } catch (const QString &error) {
-            qDebug() << "Failed to upload image" << (i+1) << ":" << error;
-            uploadedUrls[i] = QString(); // Mark as failed
-        } catch (...) {
-            qDebug() << "Failed to upload image" << (i+1) << ": Unknown error";
-            uploadedUrls[i] = QString(); // Mark as failed
-        }
-        
-        pd.setValue(i + 1);
-        pd.setLabelText(QString("%1/%2 — %3 succeeded")
-                        .arg(i+1).arg(total).arg(success));
-        QCoreApplication::processEvents();
+    // Window-modal so the document cannot change under the batch
+    auto *pd = new QProgressDialog("Uploading images…", "Cancel", 0, total, this);
+    pd->setWindowModality(Qt::WindowModal);
+    pd->setAutoClose(false);
+    pd->setAutoReset(false);
+    pd->setMinimumDuration(0);
+    pd->show();
+
+    // Uploads and copies run side by side; the dialog shows their sum
+    struct Tally {
+        int uploaded = 0, uploadedOk = 0;
+        int rehosted = 0, rehostedOk = 0;
+        int running = 2;
+    };
+    auto tally = std::make_shared<Tally>();
+    auto showProgress = [pd, tally, total]() {
+        const int done = tally->uploaded + tally->rehosted;
+        pd->setValue(done);
+        pd->setLabelText(QString("%1/%2 — %3 succeeded")
+                         .arg(done).arg(total).arg(tally->uploadedOk + tally->rehostedOk));
+    };
+    auto showRetry = [pd](int index, int attempt, int delayMs, const QString &) {
+        pd->setLabelText(QString("Connection problem — retrying image %1 in %2 s (attempt %3)")
+                         .arg(index + 1).arg(delayMs / 1000.0, 0, 'f', 1).arg(attempt));
+    };
+    auto batchFinished = [this, pd, tally, total]() {
+        if (--tally->running) return;
+        pd->deleteLater();
+        uploadsFinished(tally->uploadedOk + tally->rehostedOk, total);
+    };
+
+    connect(pd, &QProgressDialog::canceled, &_uploads, &UploadQueue::cancel);
+    connect(pd, &QProgressDialog::canceled, &_rehost, &RemoteRehoster::cancel);
+    connect(&_uploads, &UploadQueue::progress, pd, [tally, showProgress](int done, int, int succeeded) {
+        tally->uploaded = done;
+        tally->uploadedOk = succeeded;
+        showProgress();
+    });
+    connect(&_rehost, &RemoteRehoster::progress, pd, [tally, showProgress](int done, int, int succeeded) {
+        tally->rehosted = done;
+        tally->rehostedOk = succeeded;
+        showProgress();
+    });
+    connect(&_uploads, &UploadQueue::imageRetrying, pd, showRetry);
+    connect(&_rehost, &RemoteRehoster::imageRetrying, pd, showRetry);
+    connect(&_uploads, &UploadQueue::finished, pd, batchFinished);
+    connect(&_rehost, &RemoteRehoster::finished, pd, batchFinished);
+
+    // An empty batch finishes on its own, after this returns
+    _uploads.start(allHandles, _images);
+    _rehost.start(remote);
+}
+
+void MainWindow::uploadsFinished(int success, int total) {
+    // One table entry per image; failed uploads keep their handle
+    const QStringList urls = _uploads.urls();
+    for (qsizetype i = 0; i < urls.size() && i < _uploading.size(); ++i) {
+        if (!urls[i].isEmpty())
+            _doc.setSrc(_uploading[i], urls[i]);
     }
-    pd.close();
-    
-    // Replace data URIs one by one, in order
-    QString newHtml = _fullHtml;
-    for (int i = 0; i < allDataUris.size(); ++i) {
-        if (!uploadedUrls[i].isEmpty()) {
-            QString dataUri = allDataUris[i];
-            QString uploadedUrl = uploadedUrls[i];
-            
-            // Replace the first occurrence of this data URI
-            int pos = newHtml.indexOf(dataUri);
-            if (pos != -1) {
-                newHtml.replace(pos, dataUri.length(), uploadedUrl);
-                qDebug() << "Replaced image" << (i+1) << "with" << uploadedUrl;
-            }
-        }
+    _uploading.clear();
+    // Every tag that links a copied image, and only the copied ones
+    for (int image = 0; image < _doc.imageCount(); ++image) {
+        const QString url = _rehost.urlFor(_doc.src(image));
+        if (!url.isNull())
+            _doc.setSrc(image, url);
     }
 
-    _fullHtml = newHtml;
+    // Split again, so every tag stays an image piece: a failed upload keeps
+    // its img: handle for the next Confirm and for Copy
+    _doc = HtmlDocument(_doc.html());
     _syncing = true;
-    _srcEdit->setPlainText(newHtml);
-    _preview->setHtml(newHtml);
+    _srcEdit->setPlainText(_doc.masked());
+    _preview->setHtml(_doc.html());
+    _renderer.reset();
+    _sourceSync.stop();
     _syncing = false;
-    // Load external images after syncing is done
-    loadExternalImages();
+    showPreviewStats();
 
     QMessageBox::information(this, "Upload Complete",
         QString("Uploaded %1 of %2 images successfully.").arg(success).arg(total));
 }
-
-QJsonObject MainWindow::fetchSts() {
-    QNetworkRequest req((QUrl(STS_URL)));
-    // auto *reply = _networkManager.get(req);
-    QNetworkReply *reply = _networkManager.get(req);
-    QEventLoop loop;
-    connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-    loop.exec();
-    if (reply->error() != QNetworkReply::NoError)
-        throw QString(reply->errorString());
-    QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
-    return doc.object().value("data").toObject();
-}
-
-QString MainWindow::uploadToOss(const QString &header, const QByteArray &data) {
-    // Debug: Check if URLs are loaded correctly
-    qDebug() << "STS_URL:" << STS_URL;
-    qDebug() << "OSS_UPLOAD_URL:" << OSS_UPLOAD_URL;
-    qDebug() << "OSS_BASE_URL:" << OSS_BASE_URL;
-    
-    if (STS_URL.isEmpty() || OSS_UPLOAD_URL.isEmpty() || OSS_BASE_URL.isEmpty()) {
-        throw QString("Configuration not loaded properly. Check config.ini file.");
-    }
-
-    auto creds = fetchSts();
-    qDebug() << "STS credentials fetched successfully";
-    
-    qint64 expire = QDateTime::currentSecsSinceEpoch() + 3600;
-    
-    QJsonObject policy;
-    // Use UTC time format like in Python version
-    policy["expiration"] = QDateTime::fromSecsSinceEpoch(expire).toUTC().toString("yyyy-MM-ddThh:mm:ssZ");
-    QJsonArray inner;
-    inner << QJsonValue(QStringLiteral("content-length-range"))
-          << QJsonValue(0)
-          << QJsonValue(1024*1024*1024);
-    QJsonArray conditions;
-    conditions << QJsonValue(inner);
-    policy["conditions"] = conditions;
-    QByteArray p64 = QJsonDocument(policy).toJson(QJsonDocument::Compact).toBase64();
-    
-    // Use HMAC-SHA1 for signature (proper HMAC implementation)
-    QByteArray key = creds["accessKeySecret"].toString().toUtf8();
-    QByteArray sig = QMessageAuthenticationCode::hash(p64, key, QCryptographicHash::Sha1).toBase64();
-
-    qDebug() << "Policy (base64):" << p64;
-    qDebug() << "Signature:" << sig;
-    qDebug() << "AccessKeyId:" << creds["accessKeyId"].toString();
-
-    QString mime = header.section(';',0,0).section(':',1,1);
-    QString ext  = mime.section('/',1,1).toLower();
-    // if (ext == "jpeg") ext = "jpg";
-    
-    // Compute SHA1 of the first few bytes of the document for uniqueness
-    QByteArray shaInput = data.left(128); // first 128 bytes
-    QByteArray sha1 = QCryptographicHash::hash(shaInput, QCryptographicHash::Sha1).toHex();
-
-    // Add microsecond precision and random component to ensure uniqueness for each upload
-    static int uploadCounter = 0;
-    uploadCounter++;
-    
-    QString objectKey = QString("pc/course/dev/%1.%2.%3.%4.%5")
-        .arg(QString::fromUtf8(sha1.left(8))) // first 8 hex chars of sha1
-        .arg(QString::number(QDateTime::currentMSecsSinceEpoch())) // millisecond precision
-        .arg(uploadCounter) // incremental counter
-        .arg(QRandomGenerator::global()->bounded(10000)) // random component
-        .arg(ext);
-
-    qDebug() << "Uploading to key:" << objectKey;
-    qDebug() << "MIME type:" << mime;
-
-    // Try manual multipart construction to match Python version exactly
-    QByteArray boundary = "----formdata-qt-" + QString::number(QDateTime::currentMSecsSinceEpoch()).toUtf8();
-    QByteArray multipartData;
-    
-    auto addFormField = [&](const QByteArray &name, const QByteArray &value) {
-        multipartData += "--" + boundary + "\r\n";
-        multipartData += "Content-Disposition: form-data; name=\"" + name + "\"\r\n\r\n";
-        multipartData += value + "\r\n";
-    };
-    
-    // Add form fields in exact order as Python
-    addFormField("key", objectKey.toUtf8());
-    addFormField("policy", p64);
-    addFormField("OSSAccessKeyId", creds["accessKeyId"].toString().toUtf8());
-    addFormField("signature", sig);
-    addFormField("x-oss-security-token", creds["securityToken"].toString().toUtf8());
-    addFormField("success_action_status", "200");
-    
-    // Add file part
-    multipartData += "--" + boundary + "\r\n";
-    multipartData += "Content-Disposition: form-data; name=\"file\"; filename=\"image." + ext.toUtf8() + "\"\r\n";
-    multipartData += "Content-Type: " + mime.toUtf8() + "\r\n\r\n";
-    multipartData += data;
-    multipartData += "\r\n--" + boundary + "--\r\n";
-
-    QNetworkRequest req((QUrl(OSS_UPLOAD_URL)));
-    req.setHeader(QNetworkRequest::ContentTypeHeader, "multipart/form-data; boundary=" + boundary);
-    req.setHeader(QNetworkRequest::ContentLengthHeader, multipartData.size());
-    
-    qDebug() << "Content-Type:" << req.header(QNetworkRequest::ContentTypeHeader).toString();
-    qDebug() << "Content-Length:" << multipartData.size();
-    
-    QNetworkReply *reply = _networkManager.post(req, multipartData);
-
-    QEventLoop loop;
-    connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-    loop.exec();
-
-    // Debug output
-    qDebug() << "Upload response status:" << reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-    qDebug() << "Upload response:" << reply->readAll();
-
-    if (reply->error() != QNetworkReply::NoError) {
-        QString errorMsg = QString("Upload failed: %1 (HTTP %2)")
-                          .arg(reply->errorString())
-                          .arg(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt());
-        throw errorMsg;
-    }
-
-    return OSS_BASE_URL + "/" + objectKey;
-}
\ No newline at end of file
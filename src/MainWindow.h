@@ -1,27 +1,26 @@
 #pragma once
 
 #include <QWidget>
-#include <QRegularExpression>
+#include <QFutureWatcher>
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtNetwork/QNetworkReply>
 #include <QtNetwork/QNetworkRequest>
-#include <QSyntaxHighlighter>
-#include <QTextCharFormat>
+#include <QTimer>
 
-class QTextEdit;
-class QTextBrowser;
-class QProgressDialog;
+#include "ExternalImageLoader.h"
+#include "HtmlDocument.h"
+#include "ImageStore.h"
+#include "PastePipeline.h"
+#include "PreviewRenderer.h"
+#include "RemoteRehoster.h"
+#include "UploadCache.h"
+#include "UploadJournal.h"
+#include "UploadQueue.h"
 
-class ImageMarkerHighlighter : public QSyntaxHighlighter {
-    Q_OBJECT
-public:
-    explicit ImageMarkerHighlighter(QTextDocument *doc);
-protected:
-    void highlightBlock(const QString &text) override;
-private:
-    QRegularExpression _pattern;
-    QTextCharFormat   _format;
-};
+class QLabel;
+class QPlainTextEdit;
+class PreviewBrowser;
+class QProgressDialog;
 
 class MainWindow : public QWidget {
     Q_OBJECT
@@ -30,23 +29,36 @@ public:
 
 private slots:
     void pasteFromWord();
-    void copyHtml();
-    void copyRtf();
+    void openDocx();
+    void copy();
     void confirmAndUpload();
+    void scheduleSyncFromSource();
     void syncFromSource();
     void syncFromPreview();
 
 private:
-    std::pair<QString, QString> inlineAndMask(const QString &html);
-    QByteArray fetchLocalImage(const QString &src, QString &header);
-    QJsonObject fetchSts();
-    QString uploadToOss(const QString &header, const QByteArray &data);
-    void loadExternalImages();
+    void startPipeline(const QFuture<PastePipeline::Result> &future, const QString &label);
+    void pasteFinished();
+    HtmlDocument inlineAndMask(const QString &html);
+    void uploadsFinished(int success, int total);
+    void showPreviewStats();
 
-    QTextEdit          *_srcEdit;
-    QTextBrowser       *_preview;
-    QString             _fullHtml;
-    QStringList         _imgTags;
+    QPlainTextEdit     *_srcEdit;
+    PreviewBrowser     *_preview;
+    QLabel             *_previewLabel;
+    QLabel             *_status;
+    HtmlDocument        _doc;
+    QList<int>          _uploading;  // image of each handle in the batch
+    ImageStore          _images;
+    ExternalImageLoader _external;
     bool                _syncing = false;
+    PreviewRenderer     _renderer;
+    QFutureWatcher<PastePipeline::Result> _paste;
+    QTimer              _sourceSync;
     QNetworkAccessManager _networkManager;
+    StsCache            _sts{ &_networkManager };
+    UploadCache         _uploadCache;
+    UploadJournal       _uploadJournal;
+    UploadQueue         _uploads{ &_networkManager, &_sts };
+    RemoteRehoster      _rehost{ &_networkManager, &_sts };
 };
\ No newline at end of file
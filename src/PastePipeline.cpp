@@ -0,0 +1,90 @@
+#include "PastePipeline.h"
+#include "Config.h"
+#include "Converter.h"
+#include "DocxReader.h"
+#include "LineBreaker.h"
+#include "Trace.h"
+
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+PastePipeline::Options PastePipeline::configured() {
+    Options opt;
+    opt.clean = Config::cleanWordHtml();
+    opt.cleanOptions = WordCleaner::configured();
+    opt.lineWidth = Config::sourceLineWidth();
+    opt.optimize = Config::optimizeImages();
+    opt.optimizeOptions = ImageOptimizer::configured();
+    return opt;
+}
+
+QFuture<PastePipeline::Result> PastePipeline::start(const QString &html, const Options &opt,
+                                                    QThreadPool *pool) {
+    return QtConcurrent::run(pool ? pool : QThreadPool::globalInstance(), &PastePipeline::run, html, opt);
+}
+
+QFuture<PastePipeline::Result> PastePipeline::open(const QString &docxPath, const Options &opt,
+                                                   QThreadPool *pool) {
+    return QtConcurrent::run(pool ? pool : QThreadPool::globalInstance(), &PastePipeline::runDocx,
+                             docxPath, opt);
+}
+
+void PastePipeline::run(QPromise<Result> &promise, const QString &html, const Options &opt) {
+    const Trace::Scope trace("paste");
+    promise.setProgressRange(0, Stages);
+
+    QString cleaned = html;
+    if (opt.clean) {
+        promise.setProgressValueAndText(Clean, QStringLiteral("Cleaning up Word markup…"));
+        const Trace::Scope trace("clean");
+        cleaned = WordCleaner::clean(html, opt.cleanOptions);
+    }
+    if (promise.isCanceled()) return;
+
+    Result r;
+    r.images = std::make_shared<ImageStore>();
+    finish(promise, r, std::move(cleaned), opt);
+}
+
+void PastePipeline::runDocx(QPromise<Result> &promise, const QString &docxPath, const Options &opt) {
+    const Trace::Scope trace("open");
+    promise.setProgressRange(0, Stages);
+    promise.setProgressValueAndText(Clean, QStringLiteral("Reading the document…"));
+
+    Result r;
+    r.images = std::make_shared<ImageStore>();
+    // Already clean HTML, with the images in the store
+    DocxReader::Result docx = DocxReader::read(docxPath, *r.images);
+    if (!docx.error.isEmpty()) {
+        r.error = docx.error;
+        promise.addResult(std::move(r));
+        return;
+    }
+    if (promise.isCanceled()) return;
+    finish(promise, r, std::move(docx.html), opt);
+}
+
+void PastePipeline::finish(QPromise<Result> &promise, Result &r, QString html, const Options &opt) {
+    if (opt.lineWidth > 0) {
+        const Trace::Scope trace("break");
+        html = LineBreaker::breakLines(html, opt.lineWidth);
+    }
+
+    promise.setProgressValueAndText(Inline, QStringLiteral("Inlining images…"));
+    Converter::Document doc = Converter::inlineAndMask(html, *r.images, opt.baseDir);
+    html.clear();
+    if (promise.isCanceled()) return;
+
+    // Optimize once, on paste; later re-inlining keeps the smaller images
+    if (opt.optimize && doc.images > 0) {
+        promise.setProgressValueAndText(Optimize, QStringLiteral("Optimizing images…"));
+        r.report = Converter::optimizeImages(doc, *r.images, opt.optimizeOptions);
+        r.optimized = true;
+        if (promise.isCanceled()) return;
+    }
+
+    promise.setProgressValueAndText(Build, QStringLiteral("Preparing the document…"));
+    r.doc = HtmlDocument(doc.html);
+    promise.setProgressValue(Stages);
+    promise.addResult(std::move(r));
+}
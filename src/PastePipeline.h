@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QFuture>
+#include <QPromise>
+#include <QString>
+#include <memory>
+
+#include "HtmlDocument.h"
+#include "ImageOptimizer.h"
+#include "ImageStore.h"
+#include "WordCleaner.h"
+
+class QThreadPool;
+
+// The work behind a paste, off the GUI thread: Word cleanup, breaking long
+// lines for the source pane, pulling the images into a store of its own,
+// optional optimization and splitting the document at its images. The
+// result is complete and is not touched again, so the window only has to
+// show it, and a canceled paste leaves nothing behind. Progress is reported
+// per stage; cancellation is checked between stages. A .docx opened from
+// disk takes the same path, with DocxReader in place of the cleanup.
+class PastePipeline {
+public:
+    enum Stage { Clean, Inline, Optimize, Build, Stages };
+
+    struct Options {
+        bool    clean = true;
+        WordCleaner::Options cleanOptions;
+        int     lineWidth = 0;  // LineBreaker width, 0 to keep the lines
+        bool    optimize = false;
+        ImageOptimizer::Options optimizeOptions;
+        QString baseDir;
+    };
+
+    struct Result {
+        HtmlDocument doc;
+        std::shared_ptr<ImageStore> images;
+        bool optimized = false;
+        ImageOptimizer::Report report;
+        QString error;  // the input could not be read
+    };
+
+    // From config.ini; Config is not safe to read from the worker.
+    static Options configured();
+
+    static QFuture<Result> start(const QString &html, const Options &opt, QThreadPool *pool = nullptr);
+    static QFuture<Result> open(const QString &docxPath, const Options &opt, QThreadPool *pool = nullptr);
+    static void run(QPromise<Result> &promise, const QString &html, const Options &opt);
+    static void runDocx(QPromise<Result> &promise, const QString &docxPath, const Options &opt);
+
+private:
+    // Line breaking, inlining, optimization and the split into an HtmlDocument
+    static void finish(QPromise<Result> &promise, Result &r, QString html, const Options &opt);
+};
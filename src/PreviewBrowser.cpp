@@ -0,0 +1,93 @@
+#include "PreviewBrowser.h"
+#include "Config.h"
+#include "ExternalImageLoader.h"
+#include "ImageStore.h"
+
+#include <QImage>
+#include <QSignalBlocker>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextFragment>
+#include <QtMath>
+#include <utility>
+
+PreviewBrowser::PreviewBrowser(QWidget *parent)
+    : QTextBrowser(parent),
+      _decoded(Config::previewImageCacheMb() * 1024 * 1024),
+      _thumbnails(Config::previewThumbnails())
+{
+    // Coalesce images that arrive close together into one relayout
+    _relayout.setSingleShot(true);
+    _relayout.setInterval(50);
+    connect(&_relayout, &QTimer::timeout, this, &PreviewBrowser::relayoutArrived);
+}
+
+void PreviewBrowser::setImageStore(const ImageStore *store) {
+    _store = store;
+}
+
+void PreviewBrowser::setExternalLoader(ExternalImageLoader *loader) {
+    if (_external)
+        disconnect(_external, nullptr, this, nullptr);
+    _external = loader;
+    if (_external)
+        connect(_external, &ExternalImageLoader::imageLoaded, this, &PreviewBrowser::externalImageLoaded);
+}
+
+void PreviewBrowser::setThumbnails(bool on) {
+    _thumbnails = on;
+}
+
+// Viewport width in device pixels, rounded up to a multiple of 256 so that
+// resizing the window does not decode every image again.
+int PreviewBrowser::thumbnailWidth() const {
+    const qreal dpr = devicePixelRatioF();
+    const int width = qCeil(viewport()->width() * dpr);
+    return qMax(256, (width + 255) / 256 * 256);
+}
+
+QVariant PreviewBrowser::loadResource(int type, const QUrl &name) {
+    if (type == QTextDocument::ImageResource) {
+        const QString src = name.toString();
+        if (_store && ImageStore::isHandle(src)) {
+            QImage img = _decoded.image(*_store, src, _thumbnails ? thumbnailWidth() : 0);
+            if (!img.isNull()) {
+                // Whether scaled down or not, anything wider than the
+                // viewport is laid out viewport-wide; narrower images keep
+                // their size
+                const int viewportWidth = viewport()->width();
+                if (_thumbnails && viewportWidth > 0 && img.width() > viewportWidth)
+                    img.setDevicePixelRatio(qreal(img.width()) / viewportWidth);
+                return img;
+            }
+        }
+        if (_external && ExternalImageLoader::isRemote(name)) {
+            QImage img = _external->image(name);
+            if (!img.isNull())
+                return img;
+            return {};
+        }
+    }
+    return QTextBrowser::loadResource(type, name);
+}
+
+void PreviewBrowser::externalImageLoaded(const QUrl &url, const QImage &image) {
+    document()->addResource(QTextDocument::ImageResource, url, image);
+    _arrived.insert(url);
+    _relayout.start();
+}
+
+void PreviewBrowser::relayoutArrived() {
+    const QSet<QUrl> arrived = std::exchange(_arrived, {});
+    QTextDocument *doc = document();
+    // Only a relayout; this is not an edit of the preview
+    const QSignalBlocker blocker(this);
+    for (QTextBlock b = doc->begin(); b.isValid(); b = b.next()) {
+        for (auto it = b.begin(); !it.atEnd(); ++it) {
+            const QTextFragment f = it.fragment();
+            const QTextCharFormat fmt = f.charFormat();
+            if (fmt.isImageFormat() && arrived.contains(QUrl(fmt.toImageFormat().name())))
+                doc->markContentsDirty(f.position(), f.length());
+        }
+    }
+}
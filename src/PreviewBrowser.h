@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QSet>
+#include <QTextBrowser>
+#include <QTimer>
+#include <QUrl>
+
+#include "DecodedImageCache.h"
+
+class ExternalImageLoader;
+class ImageStore;
+class QImage;
+
+// Rendered preview. Resolves "img:<key>" handles from an ImageStore so the
+// document never has to carry the images as data URIs, and http(s) images
+// through an ExternalImageLoader, laying out again only the images that
+// arrive. Stored images are decoded once into a DecodedImageCache; with
+// thumbnails on, images wider than the viewport are decoded at its width.
+class PreviewBrowser : public QTextBrowser {
+    Q_OBJECT
+public:
+    explicit PreviewBrowser(QWidget *parent = nullptr);
+
+    void setImageStore(const ImageStore *store);
+    void setExternalLoader(ExternalImageLoader *loader);
+
+    void setThumbnails(bool on);
+    bool thumbnails() const { return _thumbnails; }
+    DecodedImageCache &imageCache() { return _decoded; }
+
+    QVariant loadResource(int type, const QUrl &name) override;
+
+private:
+    void externalImageLoaded(const QUrl &url, const QImage &image);
+    void relayoutArrived();
+    int thumbnailWidth() const;
+
+    const ImageStore    *_store = nullptr;
+    ExternalImageLoader *_external = nullptr;
+    DecodedImageCache    _decoded;
+    bool                 _thumbnails = false;
+    QSet<QUrl>           _arrived;
+    QTimer               _relayout;
+};
@@ -0,0 +1,203 @@
+#include "PreviewRenderer.h"
+
+#include <QHash>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <initializer_list>
+
+static bool isOneOf(QStringView name, std::initializer_list<QStringView> names) {
+    for (QStringView n : names) {
+        if (name.compare(n, Qt::CaseInsensitive) == 0) return true;
+    }
+    return false;
+}
+
+// Elements that must stay inside a single chunk.
+static bool isContainer(QStringView name) {
+    return isOneOf(name, { u"table", u"ul", u"ol", u"dl", u"pre", u"blockquote" });
+}
+
+// Elements whose closing tag can end a chunk at the top level.
+static bool isBlock(QStringView name) {
+    return isContainer(name)
+        || isOneOf(name, { u"p", u"div", u"h1", u"h2", u"h3", u"h4", u"h5", u"h6", u"center" });
+}
+
+PreviewRenderer::PreviewRenderer(QTextDocument *doc)
+    : _doc(doc)
+{
+}
+
+void PreviewRenderer::setDocument(QTextDocument *doc) {
+    _doc = doc;
+    reset();
+}
+
+void PreviewRenderer::reset() {
+    _head.clear();
+    _tail.clear();
+    _chunks.clear();
+}
+
+PreviewRenderer::Parsed PreviewRenderer::parse(const QString &html) {
+    Parsed p;
+    qsizetype bodyStart = 0;
+    const qsizetype bodyOpen = html.indexOf(QLatin1String("<body"), 0, Qt::CaseInsensitive);
+    if (bodyOpen >= 0) {
+        const qsizetype gt = html.indexOf(u'>', bodyOpen);
+        if (gt >= 0) bodyStart = gt + 1;
+    }
+    qsizetype bodyEnd = html.lastIndexOf(QLatin1String("</body"), -1, Qt::CaseInsensitive);
+    if (bodyEnd < bodyStart) bodyEnd = html.size();
+
+    p.head = html.left(bodyStart);
+    p.tail = html.mid(bodyEnd);
+    const QStringView body = QStringView(html).mid(bodyStart, bodyEnd - bodyStart);
+    const qsizetype n = body.size();
+
+    qsizetype chunkStart = 0;  // start of the chunk being collected
+    qsizetype blockStart = 0;  // start of the block since the last boundary
+    int depth = 0;
+    qsizetype i = 0;
+    while ((i = body.indexOf(u'<', i)) >= 0) {
+        if (body.mid(i, 4) == u"<!--") {
+            const qsizetype e = body.indexOf(u"-->", i + 4);
+            i = e < 0 ? n : e + 3;
+            continue;
+        }
+        const bool closing = i + 1 < n && body[i + 1] == u'/';
+        const qsizetype nameStart = i + (closing ? 2 : 1);
+        qsizetype nameEnd = nameStart;
+        while (nameEnd < n && body[nameEnd].isLetterOrNumber()) ++nameEnd;
+        const qsizetype gt = body.indexOf(u'>', nameEnd);
+        if (gt < 0) break;
+        const QStringView name = body.mid(nameStart, nameEnd - nameStart);
+        i = gt + 1;
+
+        if (isContainer(name)) {
+            if (closing) depth = qMax(0, depth - 1);
+            else if (body[gt - 1] != u'/') ++depth;
+        }
+        if (!closing || depth > 0 || !isBlock(name))
+            continue;
+
+        qsizetype end = i;
+        while (end < n && body[end].isSpace()) ++end;
+        // Split after roughly one block in four, decided by the block's own
+        // content so boundaries elsewhere survive an edit.
+        const size_t h = qHash(body.mid(blockStart, end - blockStart));
+        blockStart = end;
+        if ((h & 3) == 0) {
+            p.chunks << body.mid(chunkStart, end - chunkStart).toString();
+            chunkStart = end;
+        }
+        i = end;
+    }
+
+    const QStringView rest = body.mid(chunkStart);
+    if (p.chunks.isEmpty() || !rest.trimmed().isEmpty())
+        p.chunks << rest.toString();
+    else
+        p.chunks.last() += rest;
+    return p;
+}
+
+QString PreviewRenderer::styleSheet(QStringView head) {
+    QString css;
+    qsizetype i = 0;
+    while ((i = head.indexOf(u"<style", i, Qt::CaseInsensitive)) >= 0) {
+        const qsizetype gt = head.indexOf(u'>', i);
+        if (gt < 0) break;
+        qsizetype end = head.indexOf(u"</style", gt, Qt::CaseInsensitive);
+        if (end < 0) end = head.size();
+        css += head.mid(gt + 1, end - gt - 1);
+        css += u'\n';
+        i = end;
+    }
+    return css;
+}
+
+int PreviewRenderer::render(const QString &html) {
+    if (!_doc) return 0;
+    Parsed p = parse(html);
+    if (_chunks.isEmpty() || p.head != _head || p.tail != _tail) {
+        renderAll(p);
+        return _chunks.size();
+    }
+
+    const int oldN = _chunks.size();
+    const int newN = p.chunks.size();
+    int pre = 0;
+    while (pre < oldN && pre < newN && _chunks[pre].html == p.chunks[pre]) ++pre;
+    int suf = 0;
+    while (suf < oldN - pre && suf < newN - pre
+           && _chunks[oldN - 1 - suf].html == p.chunks[newN - 1 - suf]) ++suf;
+
+    int oldCount = oldN - pre - suf;
+    int newCount = newN - pre - suf;
+    if (oldCount == 0 && newCount == 0) return 0;
+    // Pure insertions and deletions still rebuild one neighbour, so there
+    // is always an existing block to anchor the edit on.
+    if (oldCount == 0 || newCount == 0) {
+        if (pre > 0) --pre;
+        ++oldCount;
+        ++newCount;
+    }
+    replace(pre, oldCount, p.chunks, pre, newCount);
+    return newCount;
+}
+
+void PreviewRenderer::renderAll(const Parsed &p) {
+    _doc->clear();
+    _doc->setDefaultStyleSheet(styleSheet(p.head));
+    _chunks.clear();
+    _chunks.reserve(p.chunks.size());
+
+    QTextCursor c(_doc);
+    c.beginEditBlock();
+    for (qsizetype i = 0; i < p.chunks.size(); ++i) {
+        if (i > 0) c.insertBlock();
+        Chunk chunk;
+        chunk.html = p.chunks[i];
+        chunk.start = c.position();
+        c.insertHtml(chunk.html);
+        chunk.end = c.position();
+        _chunks << chunk;
+    }
+    c.endEditBlock();
+
+    _head = p.head;
+    _tail = p.tail;
+}
+
+void PreviewRenderer::replace(int from, int oldCount, const QStringList &chunks, int newFrom, int newCount) {
+    const int oldEnd = _chunks[from + oldCount - 1].end;
+
+    QTextCursor c(_doc);
+    c.beginEditBlock();
+    c.setPosition(_chunks[from].start);
+    c.setPosition(oldEnd, QTextCursor::KeepAnchor);
+    c.removeSelectedText();
+
+    QList<Chunk> fresh;
+    fresh.reserve(newCount);
+    for (int i = 0; i < newCount; ++i) {
+        if (i > 0) c.insertBlock();
+        Chunk chunk;
+        chunk.html = chunks[newFrom + i];
+        chunk.start = c.position();
+        c.insertHtml(chunk.html);
+        chunk.end = c.position();
+        fresh << chunk;
+    }
+    c.endEditBlock();
+
+    const int delta = fresh.last().end - oldEnd;
+    for (int i = from + oldCount; i < _chunks.size(); ++i) {
+        _chunks[i].start += delta;
+        _chunks[i].end += delta;
+    }
+    _chunks.remove(from, oldCount);
+    for (int i = 0; i < newCount; ++i)
+        _chunks.insert(from + i, fresh[i]);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringView>
+
+class QTextDocument;
+
+// Renders HTML into a QTextDocument in chunks and, on the next render,
+// rebuilds only the chunks whose markup changed. Chunk boundaries fall
+// after top-level block elements and are chosen from the content of the
+// block itself, so an edit moves at most the boundaries next to it.
+//
+// The document must not be modified behind the renderer's back; call
+// reset() after any other setHtml() or edit so the next render is full.
+class PreviewRenderer {
+public:
+    explicit PreviewRenderer(QTextDocument *doc = nullptr);
+
+    void setDocument(QTextDocument *doc);
+
+    // Returns the number of chunks that were rebuilt.
+    int render(const QString &html);
+    void reset();
+
+    int chunkCount() const { return _chunks.size(); }
+
+private:
+    struct Chunk {
+        QString html;
+        int     start = 0;  // document position of its first block
+        int     end = 0;    // document position after its last character
+    };
+
+    struct Parsed {
+        QString     head;   // everything before the body content
+        QString     tail;   // everything after it
+        QStringList chunks;
+    };
+
+    static Parsed parse(const QString &html);
+    static QString styleSheet(QStringView head);
+
+    void renderAll(const Parsed &p);
+    void replace(int from, int oldCount, const QStringList &chunks, int newFrom, int newCount);
+
+    QTextDocument *_doc;
+    QString        _head;
+    QString        _tail;
+    QList<Chunk>   _chunks;
+};
@@ -0,0 +1,350 @@
+#include "RemoteRehoster.h"
+#include "Config.h"
+#include "ImgScanner.h"
+#include "Trace.h"
+#include "UploadQueue.h"
+
+#include <QCryptographicHash>
+#include <QTimer>
+#include <QUrl>
+#include <QtNetwork/QHostAddress>
+#include <QtNetwork/QHostInfo>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+#include <algorithm>
+#include <utility>
+
+// Download bytes held per image while its upload catches up
+static constexpr qint64 ReadBufferSize = 256 * 1024;
+
+static bool isRemoteSrc(QStringView src, const QString &ossBase) {
+    if (!src.startsWith(u"http://", Qt::CaseInsensitive) && !src.startsWith(u"https://", Qt::CaseInsensitive))
+        return false;
+    return ossBase.isEmpty() || !src.startsWith(ossBase);
+}
+
+// Neither this machine nor the networks around it
+static bool isPublic(QHostAddress a) {
+    bool v4 = false;
+    const quint32 ip = a.toIPv4Address(&v4);  // also for ::ffff:a.b.c.d
+    if (v4) a = QHostAddress(ip);
+    if (a.isNull() || a.isLoopback() || a.isLinkLocal() || a.isSiteLocal() || a.isUniqueLocalUnicast()
+        || a.isMulticast() || a.isBroadcast() || a == QHostAddress::AnyIPv4 || a == QHostAddress::AnyIPv6)
+        return false;
+    static const char *const Reserved[] = { "0.0.0.0/8", "10.0.0.0/8", "100.64.0.0/10", "127.0.0.0/8",
+                                            "169.254.0.0/16", "172.16.0.0/12", "192.168.0.0/16",
+                                            "198.18.0.0/15", "240.0.0.0/4" };
+    for (const char *subnet : Reserved) {
+        if (a.isInSubnet(QHostAddress::parseSubnet(QLatin1String(subnet))))
+            return false;
+    }
+    return true;
+}
+
+RemoteRehoster::RemoteRehoster(QNetworkAccessManager *network, StsCache *sts, QObject *parent)
+    : QObject(parent),
+      _network(network),
+      _sts(sts),
+      _maxInFlight(Config::uploadConcurrency()),
+      _retries(Config::uploadRetries()),
+      _retryBaseMs(Config::uploadRetryBaseMs()),
+      _retryMaxMs(Config::uploadRetryMaxMs()),
+      _timeoutMs(Config::uploadTimeoutSecs() * 1000),
+      _maxBytes(Config::rehostMaxMb() * 1024 * 1024)
+{
+}
+
+RemoteRehoster::~RemoteRehoster() {
+    const auto indices = _transfers.keys();
+    for (int index : indices)
+        drop(index);
+}
+
+bool RemoteRehoster::isRemote(QStringView src) {
+    return isRemoteSrc(src, Config::ossBaseUrl());
+}
+
+QStringList RemoteRehoster::remoteSources(QStringView html) {
+    const QString ossBase = Config::ossBaseUrl();
+    QStringList sources;
+    QSet<QString> seen;
+    ImgScanner scanner(html);
+    ImgScanner::Tag tag;
+    while (scanner.next(tag)) {
+        if (!tag.hasSrc()) continue;
+        const QStringView src = html.sliced(tag.srcStart, tag.srcEnd - tag.srcStart);
+        if (!isRemoteSrc(src, ossBase)) continue;
+        const QString s = src.toString();
+        if (!seen.contains(s)) {
+            seen.insert(s);
+            sources << s;
+        }
+    }
+    return sources;
+}
+
+void RemoteRehoster::setMaxInFlight(int n) {
+    _maxInFlight = qMax(1, n);
+}
+
+void RemoteRehoster::start(const QStringList &sources) {
+    if (_running) return;
+    _sources = sources;
+    _urls = QStringList(sources.size());
+    _attempts = QList<int>(sources.size(), 0);
+    _index.clear();
+    for (int i = 0; i < sources.size(); ++i)
+        _index.insert(sources[i], i);
+    _retrying.clear();
+    _next = _active = _done = _succeeded = 0;
+    _canceled = false;
+    _running = true;
+    ++_batch;
+
+    QMetaObject::invokeMethod(this, [this, batch = _batch]() {
+        if (batch == _batch) pump();
+    }, Qt::QueuedConnection);
+}
+
+QString RemoteRehoster::urlFor(QStringView source) const {
+    return _urls.value(_index.value(source.toString(), -1));
+}
+
+QString RemoteRehoster::rewrite(QStringView html) const {
+    return ImgScanner::rewrite(html, [this](QStringView src) { return urlFor(src); });
+}
+
+void RemoteRehoster::cancel() {
+    if (!_running || _canceled) return;
+    _canceled = true;
+    const auto moving = _transfers.keys();
+    for (int index : moving) {
+        drop(index);
+        finishJob(index, {}, "Canceled");
+    }
+    const QSet<int> backingOff = std::exchange(_retrying, {});
+    for (int index : backingOff)
+        finishJob(index, {}, "Canceled");
+    QMetaObject::invokeMethod(this, &RemoteRehoster::pump, Qt::QueuedConnection);
+}
+
+void RemoteRehoster::pump() {
+    if (!_running) return;
+    while (!_canceled && _active < _maxInFlight && _next < _sources.size()) {
+        const int index = _next++;
+        ++_active;
+        if (Config::stsUrl().isEmpty() || Config::ossUploadUrl().isEmpty() || Config::ossBaseUrl().isEmpty())
+            finishJob(index, {}, "Configuration not loaded properly. Check config.ini file.");
+        else
+            fetch(index);
+    }
+    if (_active == 0 && (_canceled || _next >= _sources.size())) {
+        _running = false;
+        emit finished(_succeeded, _sources.size());
+    }
+}
+
+void RemoteRehoster::fetch(int index) {
+    if (!_publicOnly) {
+        download(index);
+        return;
+    }
+    // Look the host up first; a URL that leads inside is not fetched
+    const QString host = QUrl(_sources[index]).host();
+    _retrying.insert(index);
+    QHostInfo::lookupHost(host, this, [this, index, host, batch = _batch](const QHostInfo &info) {
+        if (batch != _batch || !_retrying.remove(index)) return;
+        const QList<QHostAddress> addresses = info.addresses();
+        const bool allowed = !addresses.isEmpty() && std::all_of(addresses.begin(), addresses.end(), isPublic);
+        if (allowed)
+            download(index);
+        else
+            finishJob(index, {}, info.error() != QHostInfo::NoError
+                                 ? QString("Host lookup failed: %1").arg(info.errorString())
+                                 : QString("Refused: %1 is not a public address").arg(host));
+    });
+}
+
+void RemoteRehoster::download(int index) {
+    // Entities are how the src sits in the HTML, not part of the URL
+    QNetworkRequest req(QUrl(QString(_sources[index]).replace(QLatin1String("&amp;"), QLatin1String("&"))));
+    req.setRawHeader("User-Agent", "convertrt/1.0");
+    // The body goes to OSS as it comes, so Content-Length must count the
+    // bytes of the image itself
+    req.setRawHeader("Accept-Encoding", "identity");
+    // A redirect could point anywhere, past the address check
+    req.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                     _publicOnly ? QNetworkRequest::ManualRedirectPolicy
+                                 : QNetworkRequest::NoLessSafeRedirectPolicy);
+    req.setTransferTimeout(_timeoutMs);
+
+    Transfer &t = _transfers[index];
+    t = Transfer();
+    t.get = _network->get(req);
+    t.get->setReadBufferSize(ReadBufferSize);
+    Trace::begin("rehost", quintptr(t.get));
+    connect(t.get, &QNetworkReply::metaDataChanged, this, [this, index]() { headersArrived(index); });
+    connect(t.get, &QNetworkReply::finished, this, [this, index]() { fetchFinished(index); });
+}
+
+void RemoteRehoster::headersArrived(int index) {
+    Transfer &t = _transfers[index];
+    const int status = t.get->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    // Redirects are followed by the reply, other errors end up in finished()
+    if (!t.mime.isEmpty() || status != 200) return;
+
+    const QByteArray mime = t.get->rawHeader("Content-Type").split(';').first().trimmed().toLower();
+    if (!mime.startsWith("image/")) {
+        drop(index);
+        finishJob(index, {}, QString("Not an image: %1").arg(QString::fromLatin1(mime)));
+        return;
+    }
+    t.mime = mime;
+    bool ok = false;
+    const qint64 length = t.get->header(QNetworkRequest::ContentLengthHeader).toLongLong(&ok);
+    if (ok && length > _maxBytes) {
+        drop(index);
+        finishJob(index, {}, QString("Larger than %1 MiB").arg(_maxBytes / (1024 * 1024)));
+        return;
+    }
+    if (!ok) {
+        // Nothing to give the upload as its length: collect the whole body,
+        // up to the limit, and upload it once the download is done
+        t.get->setReadBufferSize(0);
+        connect(t.get, &QNetworkReply::readyRead, this, [this, index]() {
+            const auto it = _transfers.constFind(index);
+            if (it == _transfers.cend() || it->get->bytesAvailable() <= _maxBytes) return;
+            drop(index);
+            finishJob(index, {}, QString("Larger than %1 MiB").arg(_maxBytes / (1024 * 1024)));
+        });
+        return;
+    }
+    t.length = length;
+    send(index);
+}
+
+void RemoteRehoster::fetchFinished(int index) {
+    Transfer &t = _transfers[index];
+    if (t.get->error() != QNetworkReply::NoError) {
+        failed(index, t.get, "Download failed", false);
+        return;
+    }
+    if (t.mime.isEmpty()) {
+        const int status = t.get->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        drop(index);
+        finishJob(index, {}, QString("Download failed: HTTP %1").arg(status));
+        return;
+    }
+    if (t.length < 0) {
+        t.length = t.get->bytesAvailable();
+        send(index);
+    }
+    // Otherwise the upload, running or about to start, reads the rest
+}
+
+void RemoteRehoster::send(int index) {
+    _transfers[index].awaitingSts = true;
+    _sts->acquire(this, [this, index, batch = _batch](const StsCredentials &creds, const QString &error) {
+        const auto it = _transfers.find(index);
+        if (batch != _batch || it == _transfers.end() || !it->awaitingSts) return;
+        it->awaitingSts = false;
+        if (!error.isEmpty()) {
+            drop(index);
+            retry(index, error);
+        } else {
+            put(index, creds);
+        }
+    });
+}
+
+// Named after the source, so a retry or a later run overwrites its copy
+QString RemoteRehoster::objectKey(int index) const {
+    const QByteArray sha1 = QCryptographicHash::hash(_sources[index].toUtf8(), QCryptographicHash::Sha1).toHex();
+    const QString ext = QString::fromLatin1(_transfers.value(index).mime).section('/', 1, 1);
+    return QString("%1/%2.%3").arg(Config::objectKeyPrefix(), QString::fromLatin1(sha1.left(16)), ext);
+}
+
+void RemoteRehoster::put(int index, const StsCredentials &creds) {
+    Transfer &t = _transfers[index];
+    const QString object = objectKey(index);
+    QNetworkRequest req = UploadQueue::signedRequest(creds, "PUT", object, {}, t.mime, _timeoutMs);
+    req.setHeader(QNetworkRequest::ContentLengthHeader, t.length);
+    // Read the download as it arrives instead of collecting it first
+    req.setAttribute(QNetworkRequest::DoNotBufferUploadDataAttribute, true);
+    t.put = _network->put(req, t.get);
+    const QString url = Config::ossBaseUrl() + "/" + object;
+    connect(t.put, &QNetworkReply::finished, this, [this, index, url]() { putFinished(index, url); });
+}
+
+void RemoteRehoster::putFinished(int index, const QString &url) {
+    Transfer &t = _transfers[index];
+    if (t.put->error() != QNetworkReply::NoError) {
+        failed(index, t.put, "Upload failed", true);
+        return;
+    }
+    Trace::count("rehosted_bytes", t.length);
+    Trace::count("rehosted_images");
+    drop(index);
+    finishJob(index, url, {});
+}
+
+void RemoteRehoster::failed(int index, QNetworkReply *reply, const QString &what, bool upload) {
+    const QNetworkReply::NetworkError code = reply->error();
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const QString error = QString("%1: %2 (HTTP %3)").arg(what, reply->errorString()).arg(status);
+    drop(index);
+    if (_canceled) {
+        finishJob(index, {}, "Canceled");
+        return;
+    }
+    // A 403 from OSS is a rejected token; from the image host, a refusal
+    if (upload && status == 403)
+        _sts->invalidate();
+    if (!UploadQueue::isTransient(code, status) || (!upload && status == 403)) {
+        finishJob(index, {}, error);
+        return;
+    }
+    retry(index, error);
+}
+
+// Both halves start over: the download was fed to the upload and is gone
+void RemoteRehoster::retry(int index, const QString &error) {
+    const int attempt = ++_attempts[index];
+    if (attempt > _retries) {
+        finishJob(index, {}, error);
+        return;
+    }
+    const int delay = UploadQueue::retryDelayMs(attempt, _retryBaseMs, _retryMaxMs);
+    _retrying.insert(index);
+    Trace::count("rehost_retries");
+    emit imageRetrying(index, attempt, delay, error);
+    QTimer::singleShot(delay, this, [this, index, batch = _batch]() {
+        if (batch == _batch && _retrying.remove(index))
+            fetch(index);
+    });
+}
+
+// Ends the transfer, aborting whatever is still running. The upload reads
+// from the download, so it goes first.
+void RemoteRehoster::drop(int index) {
+    const Transfer t = _transfers.take(index);
+    for (QNetworkReply *reply : { t.put, t.get }) {
+        if (!reply) continue;
+        disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+    }
+    if (t.get)
+        Trace::end("rehost", quintptr(t.get));
+}
+
+void RemoteRehoster::finishJob(int index, const QString &url, const QString &error) {
+    --_active;
+    ++_done;
+    _urls[index] = url;
+    if (!url.isEmpty()) ++_succeeded;
+    emit imageFinished(index, url, error);
+    emit progress(_done, _sources.size(), _succeeded);
+    QMetaObject::invokeMethod(this, &RemoteRehoster::pump, Qt::QueuedConnection);
+}
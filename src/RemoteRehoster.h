@@ -0,0 +1,113 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QStringView>
+
+#include "StsCache.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+// Copies http(s) images from other hosts to OSS, so the document no longer
+// breaks when they go away. Each download is piped into its upload as it
+// arrives: once the response headers are in, a PUT starts that reads the
+// download reply itself, whose small read buffer holds the download to the
+// pace of the upload. Nothing is decoded or base64-encoded on the way, and
+// downloads and uploads of all images overlap. A response without a
+// Content-Length is collected first and then uploaded; one larger than
+// Config::rehostMaxMb() fails, with or without a length.
+//
+// At most maxInFlight() images are moving at once. A failed download or
+// upload is retried as a whole, with the backoff of UploadQueue. Objects are
+// named after the source URL, so a retry or a later run overwrites its copy.
+class RemoteRehoster : public QObject {
+    Q_OBJECT
+public:
+    RemoteRehoster(QNetworkAccessManager *network, StsCache *sts, QObject *parent = nullptr);
+    ~RemoteRehoster() override;
+
+    // An http(s) src not already under the OSS base URL.
+    static bool isRemote(QStringView src);
+    // Distinct remote srcs of the <img> tags in html, in document order.
+    static QStringList remoteSources(QStringView html);
+
+    void setMaxInFlight(int n);
+    int maxInFlight() const { return _maxInFlight; }
+    // Only copies from hosts whose addresses are all public: no loopback,
+    // private, link-local or multicast ones, and no redirects. For URLs
+    // that come from someone else.
+    void setPublicOnly(bool on) { _publicOnly = on; }
+
+    // sources are src values as they appear in the HTML.
+    void start(const QStringList &sources);
+    bool isRunning() const { return _running; }
+
+    const QStringList &sources() const { return _sources; }
+    // OSS URL per source, empty for failed or canceled ones.
+    const QStringList &urls() const { return _urls; }
+    // The OSS URL a source was copied to; null if it was not.
+    QString urlFor(QStringView source) const;
+    // html with every copied src replaced, in one pass.
+    QString rewrite(QStringView html) const;
+
+public slots:
+    // Aborts every transfer; images not yet started are skipped.
+    void cancel();
+
+signals:
+    void imageFinished(int index, const QString &url, const QString &error);
+    void imageRetrying(int index, int attempt, int delayMs, const QString &error);
+    void progress(int done, int total, int succeeded);
+    void finished(int succeeded, int total);
+
+private:
+    // The download and upload of one image
+    struct Transfer {
+        QNetworkReply *get = nullptr;
+        QNetworkReply *put = nullptr;
+        QByteArray     mime;
+        qint64         length = -1;   // of the body, -1 until known
+        bool           awaitingSts = false;
+    };
+
+    void pump();
+    void fetch(int index);
+    void download(int index);
+    void headersArrived(int index);
+    void fetchFinished(int index);
+    void send(int index);
+    void put(int index, const StsCredentials &creds);
+    void putFinished(int index, const QString &url);
+    QString objectKey(int index) const;
+    void failed(int index, QNetworkReply *reply, const QString &what, bool upload);
+    void retry(int index, const QString &error);
+    void drop(int index);
+    void finishJob(int index, const QString &url, const QString &error);
+
+    QNetworkAccessManager *_network;
+    StsCache              *_sts;
+    QStringList            _sources;
+    QStringList            _urls;
+    QHash<QString, int>    _index;      // source to index
+    QHash<int, Transfer>   _transfers;
+    QSet<int>              _retrying;   // waiting out a backoff or a host lookup
+    QList<int>             _attempts;
+    quint64 _batch = 0;
+    int  _maxInFlight;
+    int  _retries;
+    int  _retryBaseMs;
+    int  _retryMaxMs;
+    int  _timeoutMs;
+    qint64 _maxBytes;
+    int  _next = 0;
+    int  _active = 0;
+    int  _done = 0;
+    int  _succeeded = 0;
+    bool _running = false;
+    bool _canceled = false;
+    bool _publicOnly = false;
+};
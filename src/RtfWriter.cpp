@@ -0,0 +1,719 @@
+#include "RtfWriter.h"
+#include "Base64.h"
+#include "ImageStore.h"
+
+#include <QBuffer>
+#include <QImage>
+#include <QImageReader>
+#include <initializer_list>
+
+static constexpr qsizetype FlushBytes = 64 * 1024;
+static constexpr int TableTwips = 9000;  // text width of an A4/Letter page
+
+static bool isSpace(QChar c) {
+    return c == u' ' || c == u'\t' || c == u'\n' || c == u'\r' || c == u'\f';
+}
+
+static bool is(QStringView a, QStringView b) {
+    return a.compare(b, Qt::CaseInsensitive) == 0;
+}
+
+static bool oneOf(const QString &name, std::initializer_list<QStringView> names) {
+    for (QStringView n : names)
+        if (name == n) return true;
+    return false;
+}
+
+static bool isBlock(const QString &name) {
+    return oneOf(name, { u"p", u"div", u"h1", u"h2", u"h3", u"h4", u"h5", u"h6", u"li", u"ul", u"ol",
+                         u"blockquote", u"pre", u"table", u"tr", u"td", u"th", u"center", u"dl",
+                         u"dt", u"dd", u"address", u"section", u"article", u"header", u"footer",
+                         u"body", u"html", u"caption" });
+}
+
+static bool isVoid(const QString &name) {
+    return oneOf(name, { u"img", u"br", u"hr", u"meta", u"link", u"input", u"col", u"wbr",
+                         u"area", u"base", u"source", u"param", u"embed" });
+}
+
+// Offset of the '>' ending the tag, skipping quoted values; -1 if none.
+static qsizetype tagEnd(QStringView html, qsizetype from) {
+    QChar quote;
+    for (qsizetype i = from; i < html.size(); ++i) {
+        const QChar c = html[i];
+        if (!quote.isNull()) {
+            if (c == quote) quote = QChar();
+        } else if (c == u'"' || c == u'\'') {
+            quote = c;
+        } else if (c == u'>') {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Value of attribute name in the attribute part of a tag; empty if absent.
+static QStringView attribute(QStringView attrs, QStringView name) {
+    qsizetype i = 0;
+    const qsizetype n = attrs.size();
+    while (i < n) {
+        while (i < n && (isSpace(attrs[i]) || attrs[i] == u'/')) ++i;
+        const qsizetype nameStart = i;
+        while (i < n && !isSpace(attrs[i]) && attrs[i] != u'=' && attrs[i] != u'/') ++i;
+        const QStringView attr = attrs.mid(nameStart, i - nameStart);
+        while (i < n && isSpace(attrs[i])) ++i;
+        if (i >= n || attrs[i] != u'=') {
+            if (attr.isEmpty()) ++i;
+            continue;
+        }
+        ++i;
+        while (i < n && isSpace(attrs[i])) ++i;
+        qsizetype valStart = i, valEnd;
+        if (i < n && (attrs[i] == u'"' || attrs[i] == u'\'')) {
+            const QChar quote = attrs[i];
+            valStart = i + 1;
+            valEnd = attrs.indexOf(quote, valStart);
+            if (valEnd < 0) valEnd = n;
+            i = valEnd + 1;
+        } else {
+            while (i < n && !isSpace(attrs[i])) ++i;
+            valEnd = i;
+        }
+        if (is(attr, name)) return attrs.mid(valStart, valEnd - valStart);
+    }
+    return {};
+}
+
+// Value of a declaration in a style attribute; empty if absent.
+static QStringView cssValue(QStringView style, QStringView property) {
+    for (qsizetype i = 0; i < style.size();) {
+        qsizetype semi = style.indexOf(u';', i);
+        if (semi < 0) semi = style.size();
+        const QStringView decl = style.mid(i, semi - i);
+        i = semi + 1;
+        const qsizetype colon = decl.indexOf(u':');
+        if (colon > 0 && is(decl.left(colon).trimmed(), property))
+            return decl.mid(colon + 1).trimmed();
+    }
+    return {};
+}
+
+static int pixels(QStringView value) {
+    value = value.trimmed();
+    if (value.endsWith(u"px", Qt::CaseInsensitive)) value.chop(2);
+    bool ok = false;
+    const int n = value.toInt(&ok);
+    return ok && n > 0 ? n : 0;
+}
+
+// Half-points from a CSS font-size; 0 if it is not an absolute size.
+static int halfPoints(QStringView value) {
+    value = value.trimmed();
+    qreal factor = 0;
+    if (value.endsWith(u"pt", Qt::CaseInsensitive)) factor = 2;
+    else if (value.endsWith(u"px", Qt::CaseInsensitive)) factor = 1.5;
+    if (factor == 0) return 0;
+    bool ok = false;
+    const qreal n = value.chopped(2).toDouble(&ok);
+    return ok && n > 0 ? qRound(n * factor) : 0;
+}
+
+static QString decodeEntities(QStringView s) {
+    static const struct { const char16_t *name; char16_t c; } Named[] = {
+        { u"amp", u'&' }, { u"lt", u'<' }, { u"gt", u'>' }, { u"quot", u'"' }, { u"apos", u'\'' },
+        { u"trade", 0x2122 }, { u"hellip", 0x2026 }, { u"mdash", 0x2014 }, { u"ndash", 0x2013 },
+        { u"lsquo", 0x2018 }, { u"rsquo", 0x2019 }, { u"ldquo", 0x201C }, { u"rdquo", 0x201D },
+        { u"bull", 0x2022 }, { u"euro", 0x20AC },
+    };
+    // U+00A0 to U+00FF, in order
+    static const char16_t *const Latin1[] = {
+        u"nbsp", u"iexcl", u"cent", u"pound", u"curren", u"yen", u"brvbar", u"sect",
+        u"uml", u"copy", u"ordf", u"laquo", u"not", u"shy", u"reg", u"macr",
+        u"deg", u"plusmn", u"sup2", u"sup3", u"acute", u"micro", u"para", u"middot",
+        u"cedil", u"sup1", u"ordm", u"raquo", u"frac14", u"frac12", u"frac34", u"iquest",
+        u"Agrave", u"Aacute", u"Acirc", u"Atilde", u"Auml", u"Aring", u"AElig", u"Ccedil",
+        u"Egrave", u"Eacute", u"Ecirc", u"Euml", u"Igrave", u"Iacute", u"Icirc", u"Iuml",
+        u"ETH", u"Ntilde", u"Ograve", u"Oacute", u"Ocirc", u"Otilde", u"Ouml", u"times",
+        u"Oslash", u"Ugrave", u"Uacute", u"Ucirc", u"Uuml", u"Yacute", u"THORN", u"szlig",
+        u"agrave", u"aacute", u"acirc", u"atilde", u"auml", u"aring", u"aelig", u"ccedil",
+        u"egrave", u"eacute", u"ecirc", u"euml", u"igrave", u"iacute", u"icirc", u"iuml",
+        u"eth", u"ntilde", u"ograve", u"oacute", u"ocirc", u"otilde", u"ouml", u"divide",
+        u"oslash", u"ugrave", u"uacute", u"ucirc", u"uuml", u"yacute", u"thorn", u"yuml",
+    };
+    QString out;
+    out.reserve(s.size());
+    for (qsizetype i = 0; i < s.size(); ++i) {
+        const qsizetype semi = s[i] == u'&' ? s.indexOf(u';', i + 1) : -1;
+        if (semi < 0 || semi - i > 10) {
+            out += s[i];
+            continue;
+        }
+        const QStringView name = s.mid(i + 1, semi - i - 1);
+        char32_t c = 0;
+        if (name.startsWith(u'#')) {
+            bool ok = false;
+            const bool hex = name.size() > 1 && (name[1] == u'x' || name[1] == u'X');
+            c = hex ? name.mid(2).toUInt(&ok, 16) : name.mid(1).toUInt(&ok);
+            if (!ok || c == 0 || c > 0x10FFFF) c = 0;
+        } else {
+            for (const auto &e : Named)
+                if (name == QStringView(e.name)) c = e.c;
+            for (int k = 0; !c && k < 96; ++k)
+                if (name == QStringView(Latin1[k])) c = 0xA0 + k;
+        }
+        if (c == 0) {
+            out += s[i];
+            continue;
+        }
+        out += QString::fromUcs4(&c, 1);
+        i = semi;
+    }
+    return out;
+}
+
+RtfWriter::RtfWriter(QIODevice *out, const ImageStore *store)
+    : _out(out), _store(store)
+{
+}
+
+QByteArray RtfWriter::toRtf(QStringView html, const ImageStore *store) {
+    QByteArray rtf;
+    QBuffer buf(&rtf);
+    buf.open(QIODevice::WriteOnly);
+    RtfWriter(&buf, store).write(html);
+    return rtf;
+}
+
+void RtfWriter::reset() {
+    _open.clear();
+    _lists.clear();
+    _paragraphOpen = false;
+    _breakPending = false;
+    _space = true;
+    _tableDepth = 0;
+    _rowOpen = _cellOpen = false;
+    _cells = _cellsWritten = 0;
+}
+
+bool RtfWriter::write(QStringView html) {
+    // The colour table comes first, so one quick pass collects the colours
+    _colors.clear();
+    _collecting = true;
+    reset();
+    run(html);
+    _collecting = false;
+    reset();
+
+    _ok = true;
+    put("{\\rtf1\\ansi\\ansicpg1252\\deff0\\uc1\n"
+        "{\\fonttbl{\\f0\\fswiss\\fcharset0 Calibri;}{\\f1\\fmodern\\fcharset0 Courier New;}}\n"
+        "{\\colortbl ;\\red5\\green99\\blue193;");
+    for (const QColor &c : _colors)
+        put(QByteArray("\\red") + QByteArray::number(c.red()) + "\\green" + QByteArray::number(c.green())
+            + "\\blue" + QByteArray::number(c.blue()) + ';');
+    put("}\n\\viewkind4\\f0\\fs22\n");
+
+    run(html);
+    while (!_open.isEmpty())
+        closeElement(_open.takeLast());
+    if (_paragraphOpen) put("\\par");
+    put("\n}\n");
+    flush(true);
+    return _ok;
+}
+
+void RtfWriter::run(QStringView html) {
+    const qsizetype n = html.size();
+    qsizetype i = 0;
+    while (i < n) {
+        const qsizetype lt = html.indexOf(u'<', i);
+        if (lt < 0) {
+            text(html.mid(i));
+            break;
+        }
+        if (lt > i) text(html.mid(i, lt - i));
+        i = lt;
+
+        if (html.mid(i, 4) == u"<!--") {
+            const qsizetype end = html.indexOf(u"-->", i + 4);
+            i = end < 0 ? n : end + 3;
+            continue;
+        }
+        if (html.mid(i, 2) == u"<!" || html.mid(i, 2) == u"<?") {
+            const qsizetype gt = html.indexOf(u'>', i);
+            i = gt < 0 ? n : gt + 1;
+            continue;
+        }
+
+        const bool closing = i + 1 < n && html[i + 1] == u'/';
+        const qsizetype nameStart = i + (closing ? 2 : 1);
+        qsizetype nameEnd = nameStart;
+        while (nameEnd < n && (html[nameEnd].isLetterOrNumber() || html[nameEnd] == u':'))
+            ++nameEnd;
+        if (nameEnd == nameStart) {
+            text(u"<");
+            ++i;
+            continue;
+        }
+        const qsizetype gt = tagEnd(html, nameEnd);
+        if (gt < 0) break;
+        const QString name = html.mid(nameStart, nameEnd - nameStart).toString().toLower();
+
+        if (closing) {
+            endTag(name);
+        } else if (oneOf(name, { u"head", u"style", u"script", u"title", u"xml", u"noscript" })) {
+            // Nothing in these is shown
+            const qsizetype end = html.indexOf(QString("</" + name), gt, Qt::CaseInsensitive);
+            const qsizetype endGt = end < 0 ? -1 : html.indexOf(u'>', end);
+            i = endGt < 0 ? n : endGt + 1;
+            continue;
+        } else {
+            const qsizetype attrsEnd = html[gt - 1] == u'/' ? gt - 1 : gt;
+            startTag(html, name, html.mid(nameEnd, qMax<qsizetype>(0, attrsEnd - nameEnd)), gt + 1);
+        }
+        i = gt + 1;
+    }
+}
+
+// HTML lets <p>, <li>, <tr> and cells end where the next one starts.
+void RtfWriter::closeImplied(const QString &name) {
+    QStringList targets;
+    QStringList barriers;
+    if (name == u"li") {
+        targets = { "li" };
+        barriers = { "ul", "ol" };
+    } else if (name == u"td" || name == u"th") {
+        targets = { "td", "th" };
+        barriers = { "tr", "table" };
+    } else if (name == u"tr") {
+        targets = { "tr" };
+        barriers = { "table" };
+    } else if (isBlock(name)) {
+        targets = { "p" };
+        barriers = { "td", "th", "li", "div", "blockquote", "table" };
+    }
+    if (targets.isEmpty()) return;
+    for (qsizetype k = _open.size() - 1; k >= 0; --k) {
+        if (targets.contains(_open[k].name)) {
+            endTag(_open[k].name);
+            return;
+        }
+        if (barriers.contains(_open[k].name)) return;
+    }
+}
+
+void RtfWriter::startTag(QStringView html, const QString &name, QStringView attrs, qsizetype after) {
+    closeImplied(name);
+
+    if (name == u"br") {
+        startParagraph();
+        put("\\line ");
+        _space = true;
+        return;
+    }
+    if (name == u"hr") {
+        breakParagraph();
+        startParagraph();
+        put("\\brdrb\\brdrs\\brdrw10\\brsp20 ");
+        breakParagraph();
+        return;
+    }
+    if (name == u"img") {
+        startParagraph();
+        image(attribute(attrs, u"src"), attribute(attrs, u"width"), attribute(attrs, u"height"));
+        return;
+    }
+    if (isVoid(name)) return;
+
+    const QStringView style = attribute(attrs, u"style");
+    Element e;
+    e.name = name;
+    e.block = isBlock(name);
+    e.pre = name == u"pre";
+    if (e.block) {
+        QStringView align = cssValue(style, u"text-align");
+        if (align.isEmpty()) align = attribute(attrs, u"align");
+        if (name == u"center" || is(align, u"center")) e.align = 1;
+        else if (is(align, u"right")) e.align = 2;
+        else if (is(align, u"justify")) e.align = 3;
+        else if (is(align, u"left")) e.align = 0;
+        breakParagraph();
+    }
+
+    if (name == u"table") {
+        ++_tableDepth;
+        if (_tableDepth == 1) {
+            const QStringView border = attribute(attrs, u"border");
+            const QStringView css = cssValue(style, u"border");
+            _borders = (!border.isEmpty() && border != u"0")
+                    || (!css.isEmpty() && !css.contains(u"none", Qt::CaseInsensitive));
+        }
+    } else if (name == u"tr" && _tableDepth == 1) {
+        e.row = true;
+        startRow(html, after);
+    } else if ((name == u"td" || name == u"th") && _tableDepth == 1 && _rowOpen) {
+        e.cell = true;
+        _cellOpen = true;
+        ++_cellsWritten;
+        _paragraphOpen = _breakPending = false;
+    } else if (name == u"ul" || name == u"ol") {
+        _lists.append({ name == u"ol", 1 });
+    }
+
+    const QByteArray fmt = charFormat(name, style, attribute(attrs, u"color"));
+    if (!fmt.isEmpty()) {
+        // \par takes the paragraph properties in effect where it is, so
+        // they must not be set inside the group
+        if (e.block && !oneOf(name, { u"table", u"tr", u"ul", u"ol", u"dl", u"body", u"html" }))
+            startParagraph();
+        put("{" + fmt + " ");
+        e.group = true;
+    }
+    if (name == u"a") {
+        const QString href = decodeEntities(attribute(attrs, u"href"));
+        if (!href.isEmpty()) {
+            startParagraph();
+            put("{\\field{\\*\\fldinst{HYPERLINK \"");
+            putText(href);
+            put("\"}}{\\fldrslt{\\ul\\cf1 ");
+            e.link = true;
+        }
+    }
+    _open.append(e);
+
+    if (name == u"li") {
+        startParagraph();
+        if (!_lists.isEmpty() && _lists.last().ordered)
+            put(QByteArray::number(_lists.last().next++) + ".\\tab ");
+        else
+            put("\\bullet\\tab ");
+        _space = true;
+    }
+}
+
+void RtfWriter::endTag(const QString &name) {
+    qsizetype k = _open.size() - 1;
+    while (k >= 0 && _open[k].name != name) --k;
+    if (k < 0) {
+        if (name == u"table" && _tableDepth > 0) --_tableDepth;
+        return;
+    }
+    while (_open.size() > k)
+        closeElement(_open.takeLast());
+}
+
+void RtfWriter::closeElement(const Element &e) {
+    if (e.link) put("}}}");
+    if (e.group) put("}");
+    if (e.cell) endCell();
+    if (e.row) endRow();
+    if (e.name == u"table") {
+        if (_tableDepth == 1 && _rowOpen) endRow();
+        if (_tableDepth > 0) --_tableDepth;
+    } else if ((e.name == u"ul" || e.name == u"ol") && !_lists.isEmpty()) {
+        _lists.removeLast();
+    }
+    if (e.block) breakParagraph();
+}
+
+void RtfWriter::startRow(QStringView html, qsizetype from) {
+    // Count this row's cells; a nested table's cells are its own
+    int cells = 0, depth = 0;
+    for (qsizetype i = html.indexOf(u'<', from); i >= 0; i = html.indexOf(u'<', i + 1)) {
+        const QStringView tag = html.mid(i + 1, 7);
+        const bool end = tag.startsWith(u'/');
+        const QStringView name = end ? tag.mid(1) : tag;
+        auto starts = [&name](QStringView n) {
+            return name.size() > n.size() && name.startsWith(n, Qt::CaseInsensitive)
+                && !name[n.size()].isLetterOrNumber();
+        };
+        if (starts(u"table")) {
+            depth += end ? -1 : 1;
+            if (depth < 0) break;
+        } else if (depth == 0) {
+            if (starts(u"tr")) break;
+            if (!end && (starts(u"td") || starts(u"th"))) ++cells;
+        }
+    }
+    _cells = qMax(1, cells);
+    _cellsWritten = 0;
+
+    if (_paragraphOpen) put("\\par\n");
+    _paragraphOpen = _breakPending = false;
+    put("\\trowd\\trgaph108\\trleft0");
+    const int width = TableTwips / _cells;
+    for (int c = 1; c <= _cells; ++c) {
+        if (_borders)
+            put("\\clbrdrt\\brdrs\\brdrw10\\clbrdrl\\brdrs\\brdrw10"
+                "\\clbrdrb\\brdrs\\brdrw10\\clbrdrr\\brdrs\\brdrw10");
+        put("\\cellx" + QByteArray::number(width * c));
+    }
+    put("\n");
+    _rowOpen = true;
+}
+
+void RtfWriter::endCell() {
+    if (!_paragraphOpen) startParagraph();
+    put("\\cell\n");
+    _cellOpen = false;
+    _paragraphOpen = _breakPending = false;
+}
+
+void RtfWriter::endRow() {
+    if (_cellOpen) endCell();
+    // Word drops a row with fewer cells than it defines
+    while (_cellsWritten < _cells) {
+        _cellOpen = true;
+        ++_cellsWritten;
+        endCell();
+    }
+    put("\\row\n");
+    _rowOpen = false;
+    _paragraphOpen = _breakPending = false;
+}
+
+void RtfWriter::breakParagraph() {
+    if (_paragraphOpen) _breakPending = true;
+}
+
+bool RtfWriter::inPre() const {
+    for (const Element &e : _open)
+        if (e.pre) return true;
+    return false;
+}
+
+void RtfWriter::startParagraph() {
+    if (_paragraphOpen && !_breakPending) return;
+    QByteArray props = _breakPending ? "\\par\n\\pard" : "\\pard";
+    if (_cellOpen) props += "\\intbl";
+
+    int indent = 0;
+    int align = -1;
+    bool item = false;
+    for (const Element &e : _open) {
+        if (e.name == u"blockquote" || e.name == u"dd") indent += 720;
+        if (e.name == u"li") item = true;
+        if (e.align >= 0) align = e.align;
+    }
+    indent += 360 * int(_lists.size());
+    if (item) props += "\\fi-360";
+    if (indent) props += "\\li" + QByteArray::number(indent) + "\\tx" + QByteArray::number(indent);
+    static const char *const Align[] = { "\\ql", "\\qc", "\\qr", "\\qj" };
+    if (align >= 0) props += Align[align];
+    props += ' ';
+    put(props);
+
+    _paragraphOpen = true;
+    _breakPending = false;
+    _space = true;
+}
+
+void RtfWriter::text(QStringView s) {
+    if (_rowOpen && !_cellOpen) return;  // whitespace between cells
+    const QString decoded = s.contains(u'&') ? decodeEntities(s) : s.toString();
+
+    if (inPre()) {
+        startParagraph();
+        qsizetype from = 0;
+        for (qsizetype nl = decoded.indexOf(u'\n'); nl >= 0; nl = decoded.indexOf(u'\n', from)) {
+            putText(QStringView(decoded).mid(from, nl - from));
+            put("\\line ");
+            from = nl + 1;
+        }
+        putText(QStringView(decoded).mid(from));
+        return;
+    }
+
+    bool visible = false;
+    for (QChar c : decoded) {
+        if (!isSpace(c)) {
+            visible = true;
+            break;
+        }
+    }
+    if (!visible) {
+        // A space between words, never at the start of a paragraph
+        if (!decoded.isEmpty() && _paragraphOpen && !_breakPending && !_space) {
+            put(" ");
+            _space = true;
+        }
+        return;
+    }
+
+    startParagraph();
+    QString collapsed;
+    collapsed.reserve(decoded.size());
+    for (QChar c : decoded) {
+        if (isSpace(c)) {
+            if (!_space) collapsed += u' ';
+            _space = true;
+        } else {
+            collapsed += c;
+            _space = false;
+        }
+    }
+    putText(collapsed);
+}
+
+void RtfWriter::image(QStringView src, QStringView width, QStringView height) {
+    if (_collecting) return;
+    if (_store && ImageStore::isHandle(src)) {
+        const StoredImage img = _store->image(src);
+        if (!img.isNull()) pict(img.bytes, width, height);
+        return;
+    }
+    if (src.startsWith(u"data:", Qt::CaseInsensitive)) {
+        const qsizetype comma = src.indexOf(u',');
+        if (comma > 0 && src.left(comma).endsWith(u";base64", Qt::CaseInsensitive))
+            pict(Base64::decode(src.mid(comma + 1).toLatin1()), width, height);
+        return;
+    }
+    if (src.startsWith(u"http://", Qt::CaseInsensitive) || src.startsWith(u"https://", Qt::CaseInsensitive)) {
+        // Word fetches linked pictures itself
+        put("{\\field{\\*\\fldinst INCLUDEPICTURE \"");
+        putText(decodeEntities(src));
+        put("\" \\\\d}{\\fldrslt }}");
+        _space = false;
+    }
+}
+
+void RtfWriter::pict(const QByteArray &bytes, QStringView width, QStringView height) {
+    QByteArray data = bytes;
+    const char *blip = nullptr;
+    if (data.startsWith("\x89PNG\r\n\x1a\n")) blip = "\\pngblip";
+    else if (data.startsWith("\xff\xd8\xff")) blip = "\\jpegblip";
+    if (!blip) {
+        // RTF only carries PNG and JPEG; anything else is converted once
+        const QImage img = QImage::fromData(bytes);
+        if (img.isNull()) return;
+        data.clear();
+        QBuffer out(&data);
+        out.open(QIODevice::WriteOnly);
+        img.save(&out, "PNG");
+        blip = "\\pngblip";
+    }
+
+    QBuffer in;
+    in.setData(data);
+    in.open(QIODevice::ReadOnly);
+    const QSize size = QImageReader(&in).size();  // reads the header only
+    if (!size.isValid()) return;
+    int w = pixels(width), h = pixels(height);
+    if (!w && !h) {
+        w = size.width();
+        h = size.height();
+    } else if (!w) {
+        w = qRound(qreal(h) * size.width() / size.height());
+    } else if (!h) {
+        h = qRound(qreal(w) * size.height() / size.width());
+    }
+
+    put(QByteArray("{\\pict") + blip + "\\picw" + QByteArray::number(size.width())
+        + "\\pich" + QByteArray::number(size.height())
+        + "\\picwgoal" + QByteArray::number(w * 15) + "\\pichgoal" + QByteArray::number(h * 15) + '\n');
+    static const char Hex[] = "0123456789abcdef";
+    const char *p = data.constData();
+    const qsizetype n = data.size();
+    for (qsizetype i = 0; i < n; i += 64) {
+        const qsizetype end = qMin(n, i + 64);
+        char line[129];
+        qsizetype o = 0;
+        for (qsizetype j = i; j < end; ++j) {
+            line[o++] = Hex[uchar(p[j]) >> 4];
+            line[o++] = Hex[uchar(p[j]) & 15];
+        }
+        line[o++] = '\n';
+        _buf.append(line, o);
+        flush();
+    }
+    put("}");
+    _space = false;
+}
+
+int RtfWriter::colorIndex(const QColor &c) {
+    const qsizetype i = _colors.indexOf(c);
+    if (i >= 0) return int(i) + 2;
+    if (!_collecting) return 0;
+    _colors.append(c);
+    return int(_colors.size()) + 1;
+}
+
+QByteArray RtfWriter::charFormat(const QString &name, QStringView style, QStringView color) {
+    QByteArray f;
+    static const int Heading[] = { 48, 36, 28, 24, 20, 16 };
+    if (name.size() == 2 && name[0] == u'h' && name[1] >= u'1' && name[1] <= u'6')
+        f += "\\b\\fs" + QByteArray::number(Heading[name[1].unicode() - u'1']);
+    else if (oneOf(name, { u"b", u"strong", u"th" })) f += "\\b";
+    else if (oneOf(name, { u"i", u"em", u"cite", u"var" })) f += "\\i";
+    else if (oneOf(name, { u"u", u"ins" })) f += "\\ul";
+    else if (oneOf(name, { u"s", u"strike", u"del" })) f += "\\strike";
+    else if (name == u"sub") f += "\\sub";
+    else if (name == u"sup") f += "\\super";
+    else if (oneOf(name, { u"code", u"kbd", u"samp", u"tt", u"pre" })) f += "\\f1";
+
+    const QStringView weight = cssValue(style, u"font-weight");
+    if (is(weight, u"bold") || is(weight, u"bolder") || weight.toInt() >= 600) f += "\\b";
+    else if (is(weight, u"normal")) f += "\\b0";
+    const QStringView fontStyle = cssValue(style, u"font-style");
+    if (is(fontStyle, u"italic") || is(fontStyle, u"oblique")) f += "\\i";
+    else if (is(fontStyle, u"normal")) f += "\\i0";
+    const QStringView decoration = cssValue(style, u"text-decoration");
+    if (decoration.contains(u"underline", Qt::CaseInsensitive)) f += "\\ul";
+    if (decoration.contains(u"line-through", Qt::CaseInsensitive)) f += "\\strike";
+    if (is(decoration, u"none")) f += "\\ulnone";
+    const QStringView family = cssValue(style, u"font-family");
+    if (family.contains(u"courier", Qt::CaseInsensitive) || family.contains(u"monospace", Qt::CaseInsensitive))
+        f += "\\f1";
+    if (const int size = halfPoints(cssValue(style, u"font-size")))
+        f += "\\fs" + QByteArray::number(size);
+
+    QStringView colorValue = cssValue(style, u"color");
+    if (colorValue.isEmpty()) colorValue = color;
+    if (!colorValue.isEmpty()) {
+        const QColor c(colorValue.toString());
+        if (c.isValid()) {
+            if (const int index = colorIndex(c.toRgb()))
+                f += "\\cf" + QByteArray::number(index);
+        }
+    }
+    return f;
+}
+
+void RtfWriter::put(const char *s) {
+    if (_collecting) return;
+    _buf.append(s);
+    flush();
+}
+
+void RtfWriter::put(const QByteArray &s) {
+    if (_collecting) return;
+    _buf.append(s);
+    flush();
+}
+
+void RtfWriter::putText(QStringView s) {
+    if (_collecting) return;
+    for (QChar c : s) {
+        const char16_t u = c.unicode();
+        if (u == u'\\' || u == u'{' || u == u'}') {
+            _buf.append('\\');
+            _buf.append(char(u));
+        } else if (u == u'\t') {
+            _buf.append("\\tab ");
+        } else if (u == 0x00A0) {
+            _buf.append("\\~");
+        } else if (u >= 0x20 && u < 0x80) {
+            _buf.append(char(u));
+        } else if (u >= 0x80) {
+            // Signed 16-bit code unit, then the fallback for \uc1 readers
+            _buf.append("\\u" + QByteArray::number(qint16(u)) + '?');
+        }
+    }
+    flush();
+}
+
+void RtfWriter::flush(bool all) {
+    if (_buf.size() < FlushBytes && !(all && !_buf.isEmpty())) return;
+    if (_out->write(_buf) != _buf.size()) _ok = false;
+    _buf.clear();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QByteArray>
+#include <QColor>
+#include <QList>
+#include <QString>
+#include <QStringView>
+
+class ImageStore;
+class QIODevice;
+
+// Writes HTML as RTF without laying the document out. The markup is read
+// twice, front to back: a first pass that writes nothing collects the
+// colours for the \colortbl in the header, and the second writes the RTF
+// to the device as it goes: paragraphs, headings, lists, tables, links,
+// bold/italic/underline, colour and size. Images are only encoded on the
+// second pass. Images from the store (or data URIs) become \pict groups
+// holding the PNG or JPEG bytes as they are; only other formats are
+// converted to PNG. The output depends on nothing but the input, on every
+// platform.
+class RtfWriter {
+public:
+    explicit RtfWriter(QIODevice *out, const ImageStore *store = nullptr);
+
+    // Writes one complete RTF document; false if the device failed.
+    bool write(QStringView html);
+
+    static QByteArray toRtf(QStringView html, const ImageStore *store = nullptr);
+
+private:
+    struct Element {
+        QString name;
+        bool    group = false;     // opened an RTF group to close
+        bool    block = false;
+        int     align = -1;        // 0 left, 1 centre, 2 right, 3 justified
+        bool    pre = false;
+        bool    link = false;
+        bool    row = false;       // a row or cell of an RTF table
+        bool    cell = false;
+    };
+
+    struct List {
+        bool ordered = false;
+        int  next = 1;
+    };
+
+    void reset();
+    void run(QStringView html);
+    void startTag(QStringView html, const QString &name, QStringView attrs, qsizetype after);
+    void endTag(const QString &name);
+    void closeImplied(const QString &name);
+    void closeElement(const Element &e);
+    void text(QStringView s);
+    void image(QStringView src, QStringView width, QStringView height);
+    void pict(const QByteArray &bytes, QStringView width, QStringView height);
+    void startRow(QStringView html, qsizetype from);
+    void endCell();
+    void endRow();
+
+    void breakParagraph();
+    void startParagraph();
+    bool inPre() const;
+    void put(const char *s);
+    void put(const QByteArray &s);
+    void putText(QStringView s);
+    int colorIndex(const QColor &c);
+    QByteArray charFormat(const QString &name, QStringView style, QStringView color);
+    void flush(bool all = false);
+
+    QIODevice        *_out;
+    const ImageStore *_store;
+    QByteArray        _buf;
+    bool              _ok = true;
+    bool              _collecting = false;  // first pass: colours only
+
+    QList<Element> _open;
+    QList<List>    _lists;
+    QList<QColor>  _colors;        // \colortbl entries after auto and link blue
+    bool _paragraphOpen = false;   // text written since the last \par
+    bool _breakPending = false;
+    bool _space = true;            // last output was whitespace
+    int  _tableDepth = 0;
+    bool _rowOpen = false;
+    bool _cellOpen = false;
+    bool _borders = false;         // of the current table
+    int  _cells = 0;               // cells of the current row
+    int  _cellsWritten = 0;
+};
@@ -0,0 +1,117 @@
+#include "StsCache.h"
+#include "Config.h"
+#include "Trace.h"
+
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QMessageAuthenticationCode>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+#include <utility>
+
+static constexpr qint64 PolicyLifetimeSecs = 3600;
+
+StsCache::StsCache(QNetworkAccessManager *network, QObject *parent)
+    : QObject(parent),
+      _network(network),
+      _lifetimeSecs(Config::stsLifetimeSecs()),
+      _marginSecs(Config::stsRefreshMarginSecs())
+{
+}
+
+bool StsCache::isUsable(const QDateTime &now) const {
+    return !_creds.isNull() && now.secsTo(_creds.expires) > _marginSecs;
+}
+
+void StsCache::acquire(QObject *context, Callback done) {
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    if (isUsable(now)) {
+        if (now.secsTo(_creds.policyExpires) <= _marginSecs)
+            signPolicy(now);
+        // Refresh ahead of time so the next batch does not wait for it
+        if (now.secsTo(_creds.expires) <= 2 * _marginSecs)
+            refresh();
+        done(_creds, {});
+        return;
+    }
+    _waiters.append({ context, std::move(done) });
+    refresh();
+}
+
+void StsCache::invalidate() {
+    _creds = StsCredentials();
+}
+
+void StsCache::refresh() {
+    if (_pending) return;
+
+    _pending = _network->get(QNetworkRequest(QUrl(Config::stsUrl())));
+    Trace::begin("sts", quintptr(_pending));
+    connect(_pending, &QNetworkReply::finished, this, [this]() {
+        QNetworkReply *reply = _pending;
+        _pending = nullptr;
+        reply->deleteLater();
+        Trace::end("sts", quintptr(reply));
+
+        QString error;
+        if (reply->error() != QNetworkReply::NoError) {
+            error = reply->errorString();
+        } else {
+            const QJsonObject data =
+                QJsonDocument::fromJson(reply->readAll()).object().value("data").toObject();
+            StsCredentials creds;
+            creds.accessKeyId     = data["accessKeyId"].toString();
+            creds.accessKeySecret = data["accessKeySecret"].toString();
+            creds.securityToken   = data["securityToken"].toString();
+
+            const QDateTime now = QDateTime::currentDateTimeUtc();
+            QString expiration = data["expiration"].toString();
+            if (expiration.isEmpty()) expiration = data["Expiration"].toString();
+            creds.expires = QDateTime::fromString(expiration, Qt::ISODate);
+            if (!creds.expires.isValid())
+                creds.expires = now.addSecs(_lifetimeSecs);
+
+            if (creds.isNull()) {
+                error = "No STS data in response";
+            } else {
+                _creds = creds;
+                signPolicy(now);
+                emit refreshed();
+            }
+        }
+
+        // A background refresh can fail while the old credentials still work
+        const bool usable = isUsable(QDateTime::currentDateTimeUtc());
+        const QList<Waiter> waiters = std::exchange(_waiters, {});
+        for (const Waiter &w : waiters) {
+            if (!w.context) continue;
+            if (usable) w.done(_creds, {});
+            else w.done({}, error);
+        }
+    });
+}
+
+void StsCache::signPolicy(const QDateTime &now) {
+    const Trace::Scope trace("sign");
+    _creds.policyExpires = now.addSecs(PolicyLifetimeSecs);
+
+    QJsonObject policy;
+    // Use UTC time format like in Python version
+    policy["expiration"] = _creds.policyExpires.toString("yyyy-MM-ddThh:mm:ssZ");
+    QJsonArray inner;
+    inner << QJsonValue(QStringLiteral("content-length-range"))
+          << QJsonValue(0)
+          << QJsonValue(1024*1024*1024);
+    QJsonArray conditions;
+    conditions << QJsonValue(inner);
+    policy["conditions"] = conditions;
+    _creds.policy = QJsonDocument(policy).toJson(QJsonDocument::Compact).toBase64();
+
+    // Use HMAC-SHA1 for signature (proper HMAC implementation)
+    QByteArray key = _creds.accessKeySecret.toUtf8();
+    _creds.signature = QMessageAuthenticationCode::hash(_creds.policy, key, QCryptographicHash::Sha1).toBase64();
+}
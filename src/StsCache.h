@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <functional>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+// STS credentials together with the OSS POST policy signed with them.
+struct StsCredentials {
+    QString    accessKeyId;
+    QString    accessKeySecret;
+    QString    securityToken;
+    QDateTime  expires;
+    QByteArray policy;     // base64 policy document
+    QByteArray signature;  // base64 HMAC-SHA1 of policy
+    QDateTime  policyExpires;
+
+    bool isNull() const { return accessKeyId.isEmpty(); }
+};
+
+// Caches STS credentials until shortly before they expire and shares one
+// signed POST policy between all uploads made with them. Once the
+// credentials enter their last refresh window a new set is fetched in the
+// background while the current one keeps being handed out.
+class StsCache : public QObject {
+    Q_OBJECT
+public:
+    using Callback = std::function<void(const StsCredentials &creds, const QString &error)>;
+
+    explicit StsCache(QNetworkAccessManager *network, QObject *parent = nullptr);
+
+    // Calls done with usable credentials, immediately when cached. done is
+    // dropped if context is destroyed first.
+    void acquire(QObject *context, Callback done);
+
+    // Drops the cached credentials, e.g. after OSS rejected them.
+    void invalidate();
+
+    const StsCredentials &current() const { return _creds; }
+
+signals:
+    void refreshed();
+
+private:
+    struct Waiter {
+        QPointer<QObject> context;
+        Callback          done;
+    };
+
+    bool isUsable(const QDateTime &now) const;
+    void refresh();
+    void signPolicy(const QDateTime &now);
+
+    QNetworkAccessManager *_network;
+    StsCredentials _creds;
+    QList<Waiter>  _waiters;
+    QNetworkReply *_pending = nullptr;
+    qint64 _lifetimeSecs;
+    qint64 _marginSecs;
+};
@@ -0,0 +1,231 @@
+#include "Trace.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+struct Event {
+    const char *name;
+    char        phase;   // X complete, b/e async, C counter
+    qint64      ts;
+    qint64      dur;     // X: duration; b/e: id; C: running total
+    int         tid;
+};
+
+struct Stage {
+    qint64 count = 0;
+    qint64 totalUs = 0;
+    qint64 maxUs = 0;
+};
+
+// Enough for a long session; later events only reach the summary
+constexpr qsizetype MaxEvents = 1 << 20;
+
+struct State {
+    QMutex        lock;
+    QElapsedTimer clock;
+    QString       path;
+    QList<Event>  events;
+    qint64        dropped = 0;
+    // By name, not by pointer: the same literal in two translation units
+    // need not have one address
+    QHash<QByteArray, Stage>  stages;
+    QHash<QByteArray, qint64> counters;
+    QHash<QPair<QByteArray, quint64>, qint64> open;  // async spans by name and id
+    QList<QByteArray> order;  // stages and counters in first-seen order
+};
+
+State &state() {
+    static State s;
+    return s;
+}
+
+// Names are literals, so the bytes can be used without a copy
+QByteArray key(const char *name) {
+    return QByteArray::fromRawData(name, qstrlen(name));
+}
+
+int threadIndex() {
+    static std::atomic<int> next{ 0 };
+    thread_local const int index = ++next;
+    return index;
+}
+
+// Caller holds the lock.
+void record(State &s, const Event &e) {
+    if (s.events.size() < MaxEvents) s.events.append(e);
+    else ++s.dropped;
+}
+
+void addStage(State &s, const char *name, qint64 us) {
+    const QByteArray k = key(name);
+    auto it = s.stages.find(k);
+    if (it == s.stages.end()) {
+        it = s.stages.insert(k, {});
+        s.order << k;
+    }
+    ++it->count;
+    it->totalUs += us;
+    it->maxUs = std::max(it->maxUs, us);
+}
+
+} // namespace
+
+std::atomic<bool> Trace::_enabled{ false };
+
+qint64 Trace::now() {
+    return state().clock.nsecsElapsed() / 1000;
+}
+
+void Trace::start(const QString &path) {
+    State &s = state();
+    QMutexLocker locker(&s.lock);
+    s.path = path;
+    s.events.clear();
+    s.dropped = 0;
+    s.stages.clear();
+    s.counters.clear();
+    s.open.clear();
+    s.order.clear();
+    s.clock.start();
+    _enabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::finish() {
+    if (!enabled()) return;
+    _enabled.store(false, std::memory_order_relaxed);
+    QString path;
+    {
+        QMutexLocker locker(&state().lock);
+        path = state().path;
+    }
+    QString error;
+    if (!path.isEmpty() && !write(path, &error))
+        std::fprintf(stderr, "trace: cannot write %s: %s\n", qPrintable(path), qPrintable(error));
+    std::fputs(qPrintable(summary()), stderr);
+}
+
+void Trace::complete(const char *name, qint64 start, qint64 end) {
+    State &s = state();
+    const int tid = threadIndex();
+    QMutexLocker locker(&s.lock);
+    record(s, { name, 'X', start, end - start, tid });
+    addStage(s, name, end - start);
+}
+
+void Trace::count(const char *name, qint64 delta) {
+    if (!enabled()) return;
+    State &s = state();
+    const qint64 ts = now();
+    const int tid = threadIndex();
+    QMutexLocker locker(&s.lock);
+    const QByteArray k = key(name);
+    auto it = s.counters.find(k);
+    if (it == s.counters.end()) {
+        it = s.counters.insert(k, 0);
+        s.order << k;
+    }
+    *it += delta;
+    record(s, { name, 'C', ts, *it, tid });
+}
+
+void Trace::begin(const char *name, quint64 id) {
+    if (!enabled()) return;
+    State &s = state();
+    const qint64 ts = now();
+    const int tid = threadIndex();
+    QMutexLocker locker(&s.lock);
+    s.open.insert({ key(name), id }, ts);
+    record(s, { name, 'b', ts, qint64(id), tid });
+}
+
+void Trace::end(const char *name, quint64 id) {
+    if (!enabled()) return;
+    State &s = state();
+    const qint64 ts = now();
+    const int tid = threadIndex();
+    QMutexLocker locker(&s.lock);
+    const auto it = s.open.constFind({ key(name), id });
+    if (it == s.open.cend()) return;  // began before start()
+    addStage(s, name, ts - *it);
+    s.open.erase(it);
+    record(s, { name, 'e', ts, qint64(id), tid });
+}
+
+QString Trace::summary() {
+    State &s = state();
+    QMutexLocker locker(&s.lock);
+    QString out = QString("%1 %2 %3 %4 %5\n")
+                  .arg("stage", -16).arg("count", 8).arg("total ms", 12).arg("mean ms", 10).arg("max ms", 10);
+    for (const QByteArray &name : s.order) {
+        const auto st = s.stages.constFind(name);
+        if (st == s.stages.cend()) continue;
+        out += QString("%1 %2 %3 %4 %5\n")
+               .arg(QString::fromLatin1(name), -16)
+               .arg(st->count, 8)
+               .arg(st->totalUs / 1000.0, 12, 'f', 2)
+               .arg(st->totalUs / 1000.0 / st->count, 10, 'f', 2)
+               .arg(st->maxUs / 1000.0, 10, 'f', 2);
+    }
+    for (const QByteArray &name : s.order) {
+        const auto c = s.counters.constFind(name);
+        if (c != s.counters.cend())
+            out += QString("%1 %2\n").arg(QString::fromLatin1(name), -16).arg(*c, 8);
+    }
+    if (s.dropped)
+        out += QString("(%1 events past the first %2 not in the trace file)\n").arg(s.dropped).arg(MaxEvents);
+    return out;
+}
+
+bool Trace::write(const QString &path, QString *error) {
+    State &s = state();
+    QJsonArray events;
+    {
+        QMutexLocker locker(&s.lock);
+        for (const Event &e : s.events) {
+            QJsonObject o;
+            o["name"] = QString::fromLatin1(e.name);
+            o["ph"] = QString(QChar::fromLatin1(e.phase));
+            o["ts"] = e.ts;
+            o["pid"] = 1;
+            o["tid"] = e.tid;
+            switch (e.phase) {
+            case 'X':
+                o["cat"] = "stage";
+                o["dur"] = e.dur;
+                break;
+            case 'b':
+            case 'e':
+                o["cat"] = "async";
+                o["id"] = QString::number(quint64(e.dur), 16).prepend("0x");
+                break;
+            case 'C':
+                o["args"] = QJsonObject{ { "total", e.dur } };
+                break;
+            }
+            events.append(o);
+        }
+    }
+    QJsonObject root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (error) *error = f.errorString();
+        return false;
+    }
+    f.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QString>
+#include <atomic>
+
+// Stage timings and counters for the conversion pipeline. Off by default;
+// while off, a Scope costs one relaxed atomic load and nothing is stored.
+// finish() writes the recorded events as Chrome trace-event JSON (open it
+// in chrome://tracing or Perfetto) and prints a per-stage summary.
+//
+// Names must be string literals; only the pointer is kept. Stages and
+// counters are told apart by the text of the name.
+class Trace {
+public:
+    static bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+
+    // Starts recording. With a path, finish() writes the trace there.
+    static void start(const QString &path = QString());
+    // Stops recording, writes the trace file if one was given and prints
+    // the summary to stderr.
+    static void finish();
+
+    // Adds delta to a running total, shown in the summary and as a counter
+    // track in the trace.
+    static void count(const char *name, qint64 delta = 1);
+
+    // A span that starts and ends in different calls, such as a network
+    // request; id tells overlapping spans of the same name apart.
+    static void begin(const char *name, quint64 id);
+    static void end(const char *name, quint64 id);
+
+    // Per-stage count, total, mean and max, and the counter totals.
+    static QString summary();
+    static bool write(const QString &path, QString *error = nullptr);
+
+    // Times the enclosing block.
+    class Scope {
+    public:
+        explicit Scope(const char *name)
+            : _name(enabled() ? name : nullptr), _start(_name ? now() : 0) {}
+        ~Scope() { if (_name) complete(_name, _start, now()); }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        const char *_name;
+        qint64      _start;
+    };
+
+private:
+    static qint64 now();  // microseconds since start()
+    static void complete(const char *name, qint64 start, qint64 end);
+
+    static std::atomic<bool> _enabled;
+};
@@ -0,0 +1,41 @@
+#include "UploadCache.h"
+#include "Config.h"
+
+#include <QCryptographicHash>
+
+UploadCache::UploadCache()
+    : UploadCache(Config::dataPath(QStringLiteral("upload_cache.ini")))
+{
+}
+
+UploadCache::UploadCache(const QString &path)
+    : _settings(path, QSettings::IniFormat)
+{
+}
+
+QString UploadCache::endpoint() {
+    const QByteArray endpoint = (Config::ossUploadUrl() + '\n' + Config::ossBaseUrl() + '\n'
+                                 + Config::objectKeyPrefix()).toUtf8();
+    return QString::fromLatin1(QCryptographicHash::hash(endpoint, QCryptographicHash::Sha1).toHex().left(16));
+}
+
+// urls/<endpoint>/<key>
+QString UploadCache::entry(const QString &key) {
+    return "urls/" + endpoint() + '/' + key;
+}
+
+QString UploadCache::url(const QString &key) const {
+    return _settings.value(entry(key)).toString();
+}
+
+void UploadCache::insert(const QString &key, const QString &url) {
+    _settings.setValue(entry(key), url);
+}
+
+void UploadCache::remove(const QString &key) {
+    _settings.remove(entry(key));
+}
+
+void UploadCache::sync() {
+    _settings.sync();
+}
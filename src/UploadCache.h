@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QSettings>
+#include <QString>
+
+// Persistent map from image content key (ImageStore::keyFor) to the URL it
+// was uploaded to. Lives in upload_cache.ini next to config.ini. Entries
+// are kept apart per bucket, public base URL and key prefix, so a config
+// that points elsewhere starts with no hits.
+class UploadCache {
+public:
+    UploadCache();
+    explicit UploadCache(const QString &path);
+
+    QString url(const QString &key) const;
+    void insert(const QString &key, const QString &url);
+    void remove(const QString &key);
+    void sync();
+
+    // Short hash of where uploads go: upload URL, base URL and key prefix
+    static QString endpoint();
+
+private:
+    static QString entry(const QString &key);
+
+    mutable QSettings _settings;
+};
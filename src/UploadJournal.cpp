@@ -0,0 +1,105 @@
+#include "UploadJournal.h"
+#include "Config.h"
+#include "UploadCache.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+
+UploadJournal::UploadJournal()
+    : UploadJournal(Config::dataPath(QStringLiteral("upload_journal.jsonl")))
+{
+}
+
+UploadJournal::UploadJournal(const QString &path)
+    : _file(path)
+{
+    load();
+}
+
+void UploadJournal::load() {
+    if (!_file.open(QIODevice::ReadOnly)) return;
+    while (!_file.atEnd()) {
+        const QByteArray line = _file.readLine();
+        _tornTail = !line.endsWith('\n');
+        const QJsonObject r = QJsonDocument::fromJson(line).object();
+        const QString op = r["op"].toString();
+        const QString key = r["key"].toString();
+        if (key.isEmpty()) continue;  // torn or unknown line
+        if (op == "done") {
+            _urls.insert(key, r["url"].toString());
+            _multiparts.remove(key);
+        } else if (op == "init") {
+            const qint64 partSize = r["part_size"].toInteger();
+            if (partSize > 0)
+                _multiparts.insert(key, { r["object"].toString(), r["upload"].toString(), partSize, {} });
+        } else if (op == "part") {
+            auto it = _multiparts.find(key);
+            if (it != _multiparts.end() && it->uploadId == r["upload"].toString())
+                it->etags.insert(r["part"].toInt(), r["etag"].toString().toLatin1());
+        } else if (op == "drop") {
+            _multiparts.remove(key);
+        }
+    }
+    _file.close();
+}
+
+// <endpoint>/<key>, the same endpoint hash UploadCache keeps its entries under
+QString UploadJournal::scoped(const QString &key) {
+    return UploadCache::endpoint() + '/' + key;
+}
+
+QString UploadJournal::url(const QString &key) const {
+    return _urls.value(scoped(key));
+}
+
+UploadJournal::Multipart UploadJournal::multipart(const QString &key) const {
+    return _multiparts.value(scoped(key));
+}
+
+void UploadJournal::finished(const QString &k, const QString &url) {
+    const QString key = scoped(k);
+    _urls.insert(key, url);
+    _multiparts.remove(key);
+    append({ { "op", "done" }, { "key", key }, { "url", url } });
+}
+
+void UploadJournal::multipartStarted(const QString &k, const Multipart &upload) {
+    const QString key = scoped(k);
+    _multiparts.insert(key, { upload.object, upload.uploadId, upload.partSize, {} });
+    append({ { "op", "init" }, { "key", key }, { "object", upload.object }, { "upload", upload.uploadId },
+             { "part_size", upload.partSize } });
+}
+
+void UploadJournal::partFinished(const QString &k, int part, const QByteArray &etag) {
+    const QString key = scoped(k);
+    auto it = _multiparts.find(key);
+    if (it == _multiparts.end()) return;
+    it->etags.insert(part, etag);
+    append({ { "op", "part" }, { "key", key }, { "upload", it->uploadId }, { "part", part },
+             { "etag", QString::fromLatin1(etag) } });
+}
+
+void UploadJournal::multipartDropped(const QString &k) {
+    const QString key = scoped(k);
+    if (_multiparts.remove(key))
+        append({ { "op", "drop" }, { "key", key } });
+}
+
+void UploadJournal::clear() {
+    _urls.clear();
+    _multiparts.clear();
+    _tornTail = false;
+    _file.close();
+    _file.remove();
+}
+
+void UploadJournal::append(const QJsonObject &record) {
+    if (!_file.isOpen() && !_file.open(QIODevice::WriteOnly | QIODevice::Append))
+        return;
+    QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n';
+    // A torn line left by a crash must not swallow this one
+    if (_tornTail) line.prepend('\n');
+    _tornTail = false;
+    _file.write(line);
+    _file.flush();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QString>
+
+class QJsonObject;
+
+// Progress of the current upload batch, kept in upload_journal.jsonl next
+// to config.ini: images that finished, keyed by endpoint and content key
+// like UploadCache, and the parts of multipart uploads still under way.
+// Every record is one JSON line, flushed as it is written, so a crash loses
+// at most the line in progress; a torn last line is skipped on load. An
+// interrupted batch resumes from here, and the journal is cleared once a
+// batch has fully succeeded.
+class UploadJournal {
+public:
+    struct Multipart {
+        QString object;                  // OSS object key
+        QString uploadId;
+        qint64  partSize = 0;
+        QMap<int, QByteArray> etags;     // part number to ETag
+
+        bool isNull() const { return uploadId.isEmpty(); }
+    };
+
+    UploadJournal();
+    explicit UploadJournal(const QString &path);
+
+    QString url(const QString &key) const;
+    Multipart multipart(const QString &key) const;
+    bool isEmpty() const { return _urls.isEmpty() && _multiparts.isEmpty(); }
+
+    void finished(const QString &key, const QString &url);
+    void multipartStarted(const QString &key, const Multipart &upload);
+    void partFinished(const QString &key, int part, const QByteArray &etag);
+    // The upload ID is gone on the server; the next attempt starts over.
+    void multipartDropped(const QString &key);
+
+    void clear();
+
+private:
+    static QString scoped(const QString &key);
+    void load();
+    void append(const QJsonObject &record);
+
+    QFile _file;
+    QHash<QString, QString>   _urls;
+    QHash<QString, Multipart> _multiparts;
+    bool _tornTail = false;  // the file does not end in a newline
+};
@@ -0,0 +1,508 @@
+#include "UploadQueue.h"
+#include "Config.h"
+#include "Trace.h"
+#include "UploadCache.h"
+#include "UploadJournal.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QLocale>
+#include <QMessageAuthenticationCode>
+#include <QRandomGenerator>
+#include <QTimer>
+#include <QXmlStreamReader>
+#include <QtNetwork/QHttpMultiPart>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+#include <utility>
+
+UploadQueue::UploadQueue(QNetworkAccessManager *network, StsCache *sts, QObject *parent)
+    : QObject(parent),
+      _network(network),
+      _sts(sts),
+      _maxInFlight(Config::uploadConcurrency()),
+      _retries(Config::uploadRetries()),
+      _retryBaseMs(Config::uploadRetryBaseMs()),
+      _retryMaxMs(Config::uploadRetryMaxMs()),
+      _timeoutMs(Config::uploadTimeoutSecs() * 1000),
+      _multipartThreshold(Config::multipartThresholdMb() * 1024 * 1024),
+      _partSize(Config::multipartPartMb() * 1024 * 1024),
+      _contentAddressed(Config::contentAddressedKeys())
+{
+}
+
+UploadQueue::~UploadQueue() {
+    // Parts are sent straight from the stored bytes, which go with us
+    const auto replies = _replies.keys();
+    for (QNetworkReply *reply : replies) {
+        disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+void UploadQueue::setMaxInFlight(int n) {
+    _maxInFlight = qMax(1, n);
+}
+
+void UploadQueue::setCache(UploadCache *cache) {
+    _cache = cache;
+}
+
+void UploadQueue::setJournal(UploadJournal *journal) {
+    _journal = journal;
+}
+
+void UploadQueue::setContentAddressed(bool on) {
+    _contentAddressed = on;
+}
+
+void UploadQueue::start(const QStringList &handles, const ImageStore &store) {
+    if (_running) return;
+    _images.clear();
+    _keys.clear();
+    _queue.clear();
+    _followers.clear();
+    _retrying.clear();
+    _multiparts.clear();
+    _attempts = QList<int>(handles.size(), 0);
+    _urls = QStringList(handles.size());
+    _next = _active = _done = _succeeded = 0;
+    _canceled = false;
+    _running = true;
+    ++_batch;
+
+    QList<int> hits;
+    QHash<QString, int> leaders;
+    QSet<QString> resumed;
+    for (int i = 0; i < handles.size(); ++i) {
+        const QString key = ImageStore::keyOf(handles[i]);
+        _images << store.image(handles[i]);
+        _keys << key;
+
+        // Without the cache only unfinished multipart uploads are resumed
+        QString cached = _cache ? _cache->url(key) : QString();
+        if (cached.isEmpty() && _cache && _journal)
+            cached = _journal->url(key);
+        if (!cached.isEmpty()) {
+            _urls[i] = cached;
+            hits << i;
+        } else if (_contentAddressed && leaders.contains(key)) {
+            _followers[leaders.value(key)] << i;
+        } else {
+            leaders.insert(key, i);
+            _queue << i;
+            // Pick up an interrupted multipart upload where it stopped
+            const UploadJournal::Multipart m = _journal ? _journal->multipart(key) : UploadJournal::Multipart();
+            if (!m.isNull() && !resumed.contains(key)) {
+                resumed.insert(key);
+                const qint64 size = _images[i].bytes.size();
+                _multiparts.insert(i, { m.object, m.uploadId, m.partSize,
+                                        int((size + m.partSize - 1) / m.partSize), m.etags });
+            }
+        }
+    }
+
+    QMetaObject::invokeMethod(this, [this, hits, batch = _batch]() {
+        if (batch == _batch) reportCached(hits);
+    }, Qt::QueuedConnection);
+}
+
+void UploadQueue::reportCached(const QList<int> &hits) {
+    if (!_running) return;
+    for (int index : hits) {
+        ++_done;
+        ++_succeeded;
+        emit imageFinished(index, _urls[index], {});
+    }
+    if (!hits.isEmpty())
+        emit progress(_done, _urls.size(), _succeeded);
+    pump();
+}
+
+void UploadQueue::cancel() {
+    if (!_running || _canceled) return;
+    _canceled = true;
+    // abort() emits finished() on each reply, which fails its job.
+    const auto replies = _replies.keys();
+    for (QNetworkReply *reply : replies)
+        reply->abort();
+    const QSet<int> waiting = std::exchange(_awaitingSts, {});
+    for (int index : waiting)
+        finishJob(index, {}, "Canceled");
+    const QSet<int> backingOff = std::exchange(_retrying, {});
+    for (int index : backingOff)
+        finishJob(index, {}, "Canceled");
+    QMetaObject::invokeMethod(this, &UploadQueue::pump, Qt::QueuedConnection);
+}
+
+void UploadQueue::pump() {
+    if (!_running) return;
+    while (!_canceled && _active < _maxInFlight && _next < _queue.size())
+        startJob(_queue[_next++]);
+    if (_active == 0 && (_canceled || _next >= _queue.size())) {
+        _running = false;
+        _images.clear();
+        if (_cache) _cache->sync();
+        // Nothing left to resume
+        if (_journal && _succeeded == _urls.size())
+            _journal->clear();
+        emit finished(_succeeded, _urls.size());
+    }
+}
+
+QNetworkReply *UploadQueue::track(QNetworkReply *reply, int index) {
+    _replies.insert(reply, index);
+    return reply;
+}
+
+void UploadQueue::startJob(int index) {
+    ++_active;
+    if (Config::stsUrl().isEmpty() || Config::ossUploadUrl().isEmpty() || Config::ossBaseUrl().isEmpty()) {
+        finishJob(index, {}, "Configuration not loaded properly. Check config.ini file.");
+        return;
+    }
+
+    send(index);
+}
+
+// Every request of a job starts here, so each one gets credentials that
+// are still valid, however long the job has been running.
+void UploadQueue::send(int index) {
+    _awaitingSts.insert(index);
+    const quint64 batch = _batch;
+    _sts->acquire(this, [this, index, batch](const StsCredentials &creds, const QString &error) {
+        if (batch != _batch || !_awaitingSts.remove(index)) return;
+        if (!error.isEmpty())
+            retry(index, error);
+        else if (_images[index].bytes.size() > _multipartThreshold || _multiparts.contains(index))
+            sendMultipart(index, creds);
+        else
+            postImage(index, creds);
+    });
+}
+
+QString UploadQueue::objectKey(int index) const {
+    const StoredImage &img = _images[index];
+    QString ext = img.mime.section('/',1,1).toLower();
+
+    if (_contentAddressed)
+        return QString("%1/%2.%3").arg(Config::objectKeyPrefix(), _keys[index], ext);
+
+    // Compute SHA1 of the first few bytes of the document for uniqueness
+    QByteArray shaInput = img.bytes.left(128); // first 128 bytes
+    QByteArray sha1 = QCryptographicHash::hash(shaInput, QCryptographicHash::Sha1).toHex();
+
+    // Add microsecond precision and random component to ensure uniqueness for each upload
+    static int uploadCounter = 0;
+    uploadCounter++;
+
+    return QString("%1/%2.%3.%4.%5.%6")
+        .arg(Config::objectKeyPrefix())
+        .arg(QString::fromUtf8(sha1.left(8))) // first 8 hex chars of sha1
+        .arg(QString::number(QDateTime::currentMSecsSinceEpoch())) // millisecond precision
+        .arg(uploadCounter) // incremental counter
+        .arg(QRandomGenerator::global()->bounded(10000)) // random component
+        .arg(ext);
+}
+
+void UploadQueue::postImage(int index, const StsCredentials &creds) {
+    if (_canceled) {
+        finishJob(index, {}, "Canceled");
+        return;
+    }
+    const StoredImage &img = _images[index];
+    const QString key = objectKey(index);
+    const QString ext = img.mime.section('/',1,1).toLower();
+
+    // Fields in the same order as the Python version; OSS wants the file
+    // last. The file part shares the stored bytes and QHttpMultiPart reads
+    // the parts in sequence, so the body is never assembled in memory.
+    auto *form = new QHttpMultiPart(QHttpMultiPart::FormDataType);
+    auto addFormField = [form](const QByteArray &name, const QByteArray &value) {
+        QHttpPart part;
+        part.setRawHeader("Content-Disposition", "form-data; name=\"" + name + "\"");
+        part.setBody(value);
+        form->append(part);
+    };
+    addFormField("key", key.toUtf8());
+    addFormField("policy", creds.policy);
+    addFormField("OSSAccessKeyId", creds.accessKeyId.toUtf8());
+    addFormField("signature", creds.signature);
+    addFormField("x-oss-security-token", creds.securityToken.toUtf8());
+    addFormField("success_action_status", "200");
+
+    QHttpPart file;
+    file.setRawHeader("Content-Disposition",
+                      "form-data; name=\"file\"; filename=\"image." + ext.toUtf8() + "\"");
+    file.setRawHeader("Content-Type", img.mime.toUtf8());
+    file.setBody(img.bytes);
+    form->append(file);
+
+    QNetworkRequest req((QUrl(Config::ossUploadUrl())));
+    req.setTransferTimeout(_timeoutMs);
+    QNetworkReply *reply = track(_network->post(req, form), index);
+    form->setParent(reply);
+    Trace::begin("upload", quintptr(reply));
+    const QString url = Config::ossBaseUrl() + "/" + key;
+    const qint64 bytes = img.bytes.size();
+    connect(reply, &QNetworkReply::finished, this, [this, reply, index, url, bytes]() {
+        _replies.remove(reply);
+        reply->deleteLater();
+        Trace::end("upload", quintptr(reply));
+        if (reply->error() != QNetworkReply::NoError) {
+            requestFailed(index, reply, "Upload failed");
+            return;
+        }
+        Trace::count("uploaded_bytes", bytes);
+        uploaded(index, url);
+    });
+}
+
+// Next step of the image's multipart upload: start it, send the first part
+// the server does not have, or put the parts together.
+void UploadQueue::sendMultipart(int index, const StsCredentials &creds) {
+    if (_canceled) {
+        finishJob(index, {}, "Canceled");
+        return;
+    }
+    const auto it = _multiparts.constFind(index);
+    if (it == _multiparts.constEnd()) {
+        initiateMultipart(index, creds);
+        return;
+    }
+    for (int part = 1; part <= it->parts; ++part) {
+        if (!it->etags.contains(part)) {
+            uploadPart(index, part, creds);
+            return;
+        }
+    }
+    completeMultipart(index, creds);
+}
+
+// OSS header signature (version 1). The multipart API takes no form
+// uploads, so these requests are signed with the STS secret directly.
+QNetworkRequest UploadQueue::signedRequest(const StsCredentials &creds, const QByteArray &verb,
+                                           const QString &object, const QString &subresource,
+                                           const QByteArray &contentType, int timeoutMs) {
+    // The bucket is the first label of bucket.oss-region.aliyuncs.com
+    const QString bucket = QUrl(Config::ossUploadUrl()).host().section('.', 0, 0);
+    const QByteArray date = QLocale::c().toString(QDateTime::currentDateTimeUtc(),
+                                                  "ddd, dd MMM yyyy hh:mm:ss 'GMT'").toLatin1();
+    const QByteArray token = creds.securityToken.toUtf8();
+
+    QByteArray toSign = verb + "\n\n" + contentType + "\n" + date + "\n";
+    if (!token.isEmpty())
+        toSign += "x-oss-security-token:" + token + "\n";
+    toSign += "/" + bucket.toUtf8() + "/" + object.toUtf8();
+    if (!subresource.isEmpty())
+        toSign += "?" + subresource.toUtf8();
+    const QByteArray signature = QMessageAuthenticationCode::hash(
+        toSign, creds.accessKeySecret.toUtf8(), QCryptographicHash::Sha1).toBase64();
+
+    QUrl url(Config::ossUploadUrl() + "/" + object);
+    url.setQuery(subresource);
+    QNetworkRequest req(url);
+    req.setHeader(QNetworkRequest::ContentTypeHeader, contentType);
+    req.setRawHeader("Date", date);
+    if (!token.isEmpty())
+        req.setRawHeader("x-oss-security-token", token);
+    req.setRawHeader("Authorization", "OSS " + creds.accessKeyId.toUtf8() + ":" + signature);
+    req.setTransferTimeout(timeoutMs);
+    return req;
+}
+
+void UploadQueue::initiateMultipart(int index, const StsCredentials &creds) {
+    const QString object = objectKey(index);
+    const QNetworkRequest req = signedRequest(creds, "POST", object, "uploads", _images[index].mime.toUtf8(),
+                                                _timeoutMs);
+    QNetworkReply *reply = track(_network->post(req, QByteArray()), index);
+    Trace::begin("upload", quintptr(reply));
+    connect(reply, &QNetworkReply::finished, this, [this, reply, index, object]() {
+        _replies.remove(reply);
+        reply->deleteLater();
+        Trace::end("upload", quintptr(reply));
+        if (reply->error() != QNetworkReply::NoError) {
+            requestFailed(index, reply, "Starting multipart upload failed");
+            return;
+        }
+        QString uploadId;
+        QXmlStreamReader xml(reply->readAll());
+        while (!xml.atEnd() && uploadId.isEmpty()) {
+            if (xml.readNext() == QXmlStreamReader::StartElement && xml.name() == u"UploadId")
+                uploadId = xml.readElementText();
+        }
+        if (uploadId.isEmpty()) {
+            finishJob(index, {}, "Starting multipart upload failed: no upload ID in the response");
+            return;
+        }
+        const qint64 size = _images[index].bytes.size();
+        const Multipart m{ object, uploadId, _partSize, int((size + _partSize - 1) / _partSize), {} };
+        _multiparts.insert(index, m);
+        if (_journal)
+            _journal->multipartStarted(_keys[index], { m.object, m.uploadId, m.partSize, {} });
+        _attempts[index] = 0;
+        send(index);
+    });
+}
+
+void UploadQueue::uploadPart(int index, int part, const StsCredentials &creds) {
+    const Multipart &m = _multiparts[index];
+    const QByteArray &bytes = _images[index].bytes;
+    const qint64 offset = (part - 1) * m.partSize;
+    const qint64 length = qMin(m.partSize, bytes.size() - offset);
+    // A view of the stored bytes, which outlive the reply
+    const QByteArray body = QByteArray::fromRawData(bytes.constData() + offset, length);
+    const QNetworkRequest req = signedRequest(
+        creds, "PUT", m.object, QString("partNumber=%1&uploadId=%2").arg(part).arg(m.uploadId),
+        "application/octet-stream", _timeoutMs);
+    QNetworkReply *reply = track(_network->put(req, body), index);
+    Trace::begin("upload", quintptr(reply));
+    connect(reply, &QNetworkReply::finished, this, [this, reply, index, part, length]() {
+        _replies.remove(reply);
+        reply->deleteLater();
+        Trace::end("upload", quintptr(reply));
+        if (reply->error() != QNetworkReply::NoError) {
+            requestFailed(index, reply, QString("Uploading part %1 failed").arg(part));
+            return;
+        }
+        const QByteArray etag = reply->rawHeader("ETag");
+        if (etag.isEmpty()) {
+            finishJob(index, {}, QString("Uploading part %1 failed: no ETag in the response").arg(part));
+            return;
+        }
+        _multiparts[index].etags.insert(part, etag);
+        if (_journal)
+            _journal->partFinished(_keys[index], part, etag);
+        Trace::count("uploaded_bytes", length);
+        _attempts[index] = 0;
+        send(index);
+    });
+}
+
+void UploadQueue::completeMultipart(int index, const StsCredentials &creds) {
+    const Multipart &m = _multiparts[index];
+    QByteArray body = "<CompleteMultipartUpload>";
+    for (int part = 1; part <= m.parts; ++part)
+        body += "<Part><PartNumber>" + QByteArray::number(part) + "</PartNumber><ETag>"
+              + m.etags.value(part) + "</ETag></Part>";
+    body += "</CompleteMultipartUpload>";
+    const QNetworkRequest req = signedRequest(creds, "POST", m.object, "uploadId=" + m.uploadId,
+                                              "application/xml", _timeoutMs);
+    QNetworkReply *reply = track(_network->post(req, body), index);
+    Trace::begin("upload", quintptr(reply));
+    const QString url = Config::ossBaseUrl() + "/" + m.object;
+    connect(reply, &QNetworkReply::finished, this, [this, reply, index, url]() {
+        _replies.remove(reply);
+        reply->deleteLater();
+        Trace::end("upload", quintptr(reply));
+        if (reply->error() != QNetworkReply::NoError) {
+            requestFailed(index, reply, "Completing multipart upload failed");
+            return;
+        }
+        _multiparts.remove(index);
+        uploaded(index, url);
+    });
+}
+
+// Worth another try: the connection failed or timed out, the server is
+// overloaded, or the token was rejected (the retry fetches a new one).
+bool UploadQueue::isTransient(QNetworkReply::NetworkError error, int status) {
+    if (status)
+        return status == 403 || status == 408 || status == 429
+            || status == 500 || status == 502 || status == 503 || status == 504;
+    switch (error) {
+    case QNetworkReply::ConnectionRefusedError:
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::OperationCanceledError:  // transfer timeout; cancel() is handled first
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::NetworkSessionFailedError:
+    case QNetworkReply::ProxyConnectionClosedError:
+    case QNetworkReply::ProxyTimeoutError:
+    case QNetworkReply::UnknownNetworkError:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Exponential backoff with equal jitter, so that requests that failed
+// together do not all come back at the same moment
+int UploadQueue::retryDelayMs(int attempt, int baseMs, int maxMs) {
+    const int backoff = int(qMin<qint64>(maxMs, qint64(baseMs) << qMin(attempt - 1, 20)));
+    return backoff / 2 + int(QRandomGenerator::global()->bounded(backoff / 2 + 1));
+}
+
+void UploadQueue::requestFailed(int index, QNetworkReply *reply, const QString &what) {
+    if (_canceled) {
+        finishJob(index, {}, "Canceled");
+        return;
+    }
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const QString error = QString("%1: %2 (HTTP %3)").arg(what, reply->errorString()).arg(status);
+    if (status == 403)
+        _sts->invalidate();
+    // The multipart upload is gone (aborted or already completed); start over
+    if (status == 404 && _multiparts.contains(index) && reply->readAll().contains("NoSuchUpload")) {
+        _multiparts.remove(index);
+        if (_journal) _journal->multipartDropped(_keys[index]);
+        retry(index, error);
+        return;
+    }
+    if (!isTransient(reply->error(), status)) {
+        finishJob(index, {}, error);
+        return;
+    }
+    bool ok = false;
+    const int retryAfterSecs = reply->rawHeader("Retry-After").toInt(&ok);
+    retry(index, error, ok ? retryAfterSecs * 1000 : -1);
+}
+
+void UploadQueue::retry(int index, const QString &error, int retryAfterMs) {
+    const int attempt = ++_attempts[index];
+    if (attempt > _retries) {
+        finishJob(index, {}, error);
+        return;
+    }
+    int delay = retryDelayMs(attempt, _retryBaseMs, _retryMaxMs);
+    if (retryAfterMs > delay)
+        delay = qMin(retryAfterMs, _retryMaxMs);
+    _retrying.insert(index);
+    Trace::count("upload_retries");
+    emit imageRetrying(index, attempt, delay, error);
+    QTimer::singleShot(delay, this, [this, index, batch = _batch]() {
+        if (batch == _batch && _retrying.remove(index))
+            send(index);
+    });
+}
+
+void UploadQueue::uploaded(int index, const QString &url) {
+    if (_cache)
+        _cache->insert(_keys[index], url);
+    if (_journal)
+        _journal->finished(_keys[index], url);
+    Trace::count("uploaded_images");
+    finishJob(index, url, {});
+}
+
+void UploadQueue::finishJob(int index, const QString &url, const QString &error) {
+    --_active;
+    complete(index, url, error);
+    const QList<int> followers = _followers.take(index);
+    for (int f : followers)
+        complete(f, url, error);
+    QMetaObject::invokeMethod(this, &UploadQueue::pump, Qt::QueuedConnection);
+}
+
+void UploadQueue::complete(int index, const QString &url, const QString &error) {
+    // Drop our reference so the bytes go once the store lets go of them too
+    _images[index] = StoredImage();
+    ++_done;
+    _urls[index] = url;
+    if (!url.isEmpty()) ++_succeeded;
+
+    emit imageFinished(index, url, error);
+    emit progress(_done, _urls.size(), _succeeded);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+
+#include "ImageStore.h"
+#include "StsCache.h"
+
+class QNetworkAccessManager;
+class UploadCache;
+class UploadJournal;
+
+// Uploads a batch of images to OSS without blocking the caller. At most
+// maxInFlight() images are between credential lookup and upload reply at a
+// time; results are reported per image and collected by index in urls().
+//
+// With a cache set, images uploaded before are answered from it without
+// touching the network. With content-addressed keys, instances of the same
+// image in one batch are uploaded once and share the URL.
+//
+// Requests that fail on the way (connection lost, timeout, 5xx, 429, a
+// rejected token) are retried with exponential backoff and jitter. Images
+// above the multipart threshold go up in parts, each retried on its own.
+// With a journal set, finished images and parts are recorded as they
+// complete, and the next batch after an interruption skips them.
+class UploadQueue : public QObject {
+    Q_OBJECT
+public:
+    UploadQueue(QNetworkAccessManager *network, StsCache *sts, QObject *parent = nullptr);
+    ~UploadQueue() override;
+
+    void setMaxInFlight(int n);
+    int maxInFlight() const { return _maxInFlight; }
+
+    void setCache(UploadCache *cache);
+    void setJournal(UploadJournal *journal);
+    void setContentAddressed(bool on);
+
+    // handles are ImageStore handles, one per image instance.
+    void start(const QStringList &handles, const ImageStore &store);
+    bool isRunning() const { return _running; }
+
+    // Uploaded URL per image, empty for failed or canceled ones.
+    const QStringList &urls() const { return _urls; }
+
+    // A request to OSS signed with the STS secret (header signature v1),
+    // for the APIs that take no form upload.
+    static QNetworkRequest signedRequest(const StsCredentials &creds, const QByteArray &verb,
+                                         const QString &object, const QString &subresource,
+                                         const QByteArray &contentType, int timeoutMs);
+    // Whether a failed request is worth another try, and the backoff before
+    // the given attempt: doubling from base up to max, with equal jitter.
+    static bool isTransient(QNetworkReply::NetworkError error, int status);
+    static int retryDelayMs(int attempt, int baseMs, int maxMs);
+
+public slots:
+    // Aborts every in-flight reply; images not yet started are skipped.
+    void cancel();
+
+signals:
+    void imageFinished(int index, const QString &url, const QString &error);
+    // A request for the image failed in a way worth retrying; the next
+    // attempt starts after delayMs.
+    void imageRetrying(int index, int attempt, int delayMs, const QString &error);
+    void progress(int done, int total, int succeeded);
+    void finished(int succeeded, int total);
+
+private:
+    // A multipart upload in progress
+    struct Multipart {
+        QString object;
+        QString uploadId;
+        qint64  partSize = 0;
+        int     parts = 0;
+        QMap<int, QByteArray> etags;
+    };
+
+    void reportCached(const QList<int> &hits);
+    void pump();
+    void startJob(int index);
+    void send(int index);
+    void postImage(int index, const StsCredentials &creds);
+    void sendMultipart(int index, const StsCredentials &creds);
+    void initiateMultipart(int index, const StsCredentials &creds);
+    void uploadPart(int index, int part, const StsCredentials &creds);
+    void completeMultipart(int index, const StsCredentials &creds);
+    QString objectKey(int index) const;
+    void requestFailed(int index, QNetworkReply *reply, const QString &what);
+    void retry(int index, const QString &error, int retryAfterMs = -1);
+    void uploaded(int index, const QString &url);
+    void finishJob(int index, const QString &url, const QString &error);
+    void complete(int index, const QString &url, const QString &error);
+    QNetworkReply *track(QNetworkReply *reply, int index);
+
+    QNetworkAccessManager *_network;
+    StsCache              *_sts;
+    UploadCache           *_cache = nullptr;
+    UploadJournal         *_journal = nullptr;
+    QList<StoredImage>     _images;
+    QStringList            _keys;
+    QStringList            _urls;
+    QList<int>             _queue;      // indices that need an upload
+    QHash<int, QList<int>> _followers;  // duplicates waiting on an upload
+    QHash<QNetworkReply *, int> _replies;
+    QSet<int>              _awaitingSts;
+    QSet<int>              _retrying;   // waiting out a backoff
+    QList<int>             _attempts;   // failures of the current request
+    QHash<int, Multipart>  _multiparts;
+    quint64 _batch = 0;
+    int  _maxInFlight = 8;
+    int  _retries;
+    int  _retryBaseMs;
+    int  _retryMaxMs;
+    int  _timeoutMs;
+    qint64 _multipartThreshold;
+    qint64 _partSize;
+    int  _next = 0;
+    int  _active = 0;
+    int  _done = 0;
+    int  _succeeded = 0;
+    bool _contentAddressed = false;
+    bool _running = false;
+    bool _canceled = false;
+};
@@ -0,0 +1,352 @@
+#include "WordCleaner.h"
+#include "Config.h"
+
+#include <QList>
+#include <initializer_list>
+
+static bool isSpace(QChar c) {
+    return c == u' ' || c == u'\t' || c == u'\n' || c == u'\r' || c == u'\f';
+}
+
+static bool isNameChar(QChar c) {
+    return c.isLetterOrNumber() || c == u':' || c == u'-' || c == u'_' || c == u'.';
+}
+
+static bool is(QStringView name, QStringView other) {
+    return name.compare(other, Qt::CaseInsensitive) == 0;
+}
+
+static bool startsWith(QStringView s, qsizetype at, QStringView prefix) {
+    return s.mid(at, prefix.size()).compare(prefix, Qt::CaseInsensitive) == 0;
+}
+
+// Appends s with every run of whitespace turned into one space.
+static void appendCollapsed(QString &out, QStringView s) {
+    bool space = false;
+    for (QChar c : s) {
+        if (isSpace(c)) {
+            space = true;
+            continue;
+        }
+        if (space && !out.isEmpty() && !out.endsWith(u' ')) out += u' ';
+        space = false;
+        out += c;
+    }
+}
+
+// Properties only Word acts on, besides the mso-* family.
+static bool isWordOnly(QStringView property) {
+    if (startsWith(property, 0, u"mso-")) return true;
+    for (QStringView p : { u"tab-stops", u"layout-grid-mode", u"text-autospace",
+                           u"punctuation-wrap", u"text-justify-trim", u"page" }) {
+        if (is(property, p)) return true;
+    }
+    return false;
+}
+
+// Offset of the '>' ending the tag that starts at from, skipping quoted
+// attribute values; -1 if the tag is not closed.
+static qsizetype tagEnd(QStringView html, qsizetype from) {
+    QChar quote;
+    for (qsizetype i = from; i < html.size(); ++i) {
+        const QChar c = html[i];
+        if (!quote.isNull()) {
+            if (c == quote) quote = QChar();
+        } else if (c == u'"' || c == u'\'') {
+            quote = c;
+        } else if (c == u'>') {
+            return i;
+        }
+    }
+    return -1;
+}
+
+WordCleaner::Options WordCleaner::configured() {
+    Options opt;
+    opt.officeMarkup = Config::cleanOfficeMarkup();
+    opt.comments = Config::cleanComments();
+    opt.msoStyles = Config::cleanMsoStyles();
+    opt.lang = Config::cleanLang();
+    opt.emptySpans = Config::cleanEmptySpans();
+    return opt;
+}
+
+QString WordCleaner::cleanStyle(QStringView declarations) {
+    QString out;
+    qsizetype i = 0;
+    const qsizetype n = declarations.size();
+    while (i < n) {
+        // Split at ';' outside quotes
+        qsizetype end = i;
+        QChar quote;
+        for (; end < n; ++end) {
+            const QChar c = declarations[end];
+            if (!quote.isNull()) {
+                if (c == quote) quote = QChar();
+            } else if (c == u'"' || c == u'\'') {
+                quote = c;
+            } else if (c == u';') {
+                break;
+            }
+        }
+        const QStringView decl = declarations.mid(i, end - i).trimmed();
+        i = end + 1;
+
+        const qsizetype colon = decl.indexOf(u':');
+        if (colon <= 0) continue;
+        const QStringView property = decl.left(colon).trimmed();
+        if (isWordOnly(property)) continue;
+        if (!out.isEmpty()) out += u';';
+        appendCollapsed(out, property);
+        out += u':';
+        appendCollapsed(out, decl.mid(colon + 1).trimmed());
+    }
+    return out;
+}
+
+QString WordCleaner::cleanStyleSheet(QStringView css) {
+    // Comments and the <!-- --> that hides the sheet from old browsers go
+    QString plain;
+    plain.reserve(css.size());
+    for (qsizetype i = 0; i < css.size();) {
+        if (startsWith(css, i, u"/*")) {
+            const qsizetype end = css.indexOf(u"*/", i + 2);
+            i = end < 0 ? css.size() : end + 2;
+            plain += u' ';
+        } else if (startsWith(css, i, u"<!--")) {
+            i += 4;
+        } else if (startsWith(css, i, u"-->")) {
+            i += 3;
+        } else {
+            plain += css[i++];
+        }
+    }
+
+    QString out;
+    const QStringView s(plain);
+    qsizetype i = 0;
+    while (i < s.size()) {
+        const qsizetype brace = s.indexOf(u'{', i);
+        const qsizetype semi = s.indexOf(u';', i);
+        // A statement such as @import ends at ';' before any block
+        if (brace < 0 || (semi >= 0 && semi < brace)) {
+            if (semi < 0) break;
+            const QStringView statement = s.mid(i, semi - i).trimmed();
+            if (!statement.isEmpty()) {
+                appendCollapsed(out, statement);
+                out += u";\n";
+            }
+            i = semi + 1;
+            continue;
+        }
+        const QStringView prelude = s.mid(i, brace - i).trimmed();
+        int depth = 1;
+        qsizetype close = brace + 1;
+        for (; close < s.size() && depth > 0; ++close) {
+            if (s[close] == u'{') ++depth;
+            else if (s[close] == u'}') --depth;
+        }
+        const QStringView body = s.mid(brace + 1, close - brace - 2);
+        i = close;
+
+        if (prelude.startsWith(u'@')) {
+            if (startsWith(prelude, 0, u"@font-face") || startsWith(prelude, 0, u"@page")
+                || startsWith(prelude, 0, u"@list"))
+                continue;
+            // Other at-rules (@media) are kept as they are
+            appendCollapsed(out, prelude);
+            out += u" {";
+            out += body;
+            out += u"}\n";
+            continue;
+        }
+        const QString decls = cleanStyle(body);
+        if (decls.isEmpty() || prelude.isEmpty()) continue;
+        appendCollapsed(out, prelude);
+        out += u" {";
+        out += decls;
+        out += u"}\n";
+    }
+    return out;
+}
+
+QString WordCleaner::clean(QStringView html) {
+    return clean(html, Options());
+}
+
+QString WordCleaner::clean(QStringView html, const Options &opt) {
+    QString out;
+    out.reserve(html.size() / 2);
+    QList<bool> spans;  // per open <span>: was its tag dropped?
+    const qsizetype n = html.size();
+    qsizetype i = 0;
+
+    while (i < n) {
+        const qsizetype lt = html.indexOf(u'<', i);
+        if (lt < 0) {
+            out += html.mid(i);
+            break;
+        }
+        out += html.mid(i, lt - i);
+        i = lt;
+
+        if (startsWith(html, i, u"<!--")) {
+            const qsizetype end = html.indexOf(u"-->", i + 4);
+            const qsizetype stop = end < 0 ? n : end + 3;
+            const bool conditional = startsWith(html, i, u"<!--[if") || startsWith(html, i, u"<!--[endif");
+            const bool drop = conditional ? opt.officeMarkup : opt.comments;
+            if (!drop) out += html.mid(i, stop - i);
+            i = stop;
+            continue;
+        }
+        if (startsWith(html, i, u"<![") || startsWith(html, i, u"<?")) {
+            // <![if !vml]>, <![endif]> and <?xml:namespace ...>; whatever
+            // they wrap is ordinary markup and stays
+            const qsizetype gt = html.indexOf(u'>', i);
+            const qsizetype stop = gt < 0 ? n : gt + 1;
+            if (!opt.officeMarkup) out += html.mid(i, stop - i);
+            i = stop;
+            continue;
+        }
+
+        const bool closing = i + 1 < n && html[i + 1] == u'/';
+        const qsizetype nameStart = i + (closing ? 2 : 1);
+        qsizetype nameEnd = nameStart;
+        while (nameEnd < n && isNameChar(html[nameEnd])) ++nameEnd;
+        if (nameEnd == nameStart) {
+            // <!DOCTYPE> or a stray '<'
+            const bool doctype = i + 1 < n && html[i + 1] == u'!';
+            const qsizetype gt = doctype ? html.indexOf(u'>', i) : -1;
+            const qsizetype stop = gt < 0 ? i + 1 : gt + 1;
+            out += html.mid(i, stop - i);
+            i = stop;
+            continue;
+        }
+        const QStringView name = html.mid(nameStart, nameEnd - nameStart);
+        const qsizetype gt = tagEnd(html, nameEnd);
+        if (gt < 0) {
+            out += html.mid(i);
+            break;
+        }
+        const qsizetype stop = gt + 1;
+
+        if (opt.officeMarkup) {
+            if (is(name, u"xml") && !closing) {
+                const qsizetype end = html.indexOf(u"</xml", stop, Qt::CaseInsensitive);
+                const qsizetype endGt = end < 0 ? -1 : html.indexOf(u'>', end);
+                i = endGt < 0 ? n : endGt + 1;
+                continue;
+            }
+            if (name.contains(u':') || is(name, u"meta") || is(name, u"link")) {
+                i = stop;
+                continue;
+            }
+        }
+
+        if (closing) {
+            if (is(name, u"span") && !spans.isEmpty() && spans.takeLast()) {
+                i = stop;
+                continue;
+            }
+            out += html.mid(i, stop - i);
+            i = stop;
+            continue;
+        }
+
+        if (is(name, u"style")) {
+            // The sheet is not markup; only the CSS cleaner looks inside
+            qsizetype end = html.indexOf(u"</style", stop, Qt::CaseInsensitive);
+            if (end < 0) end = n;
+            if (!opt.msoStyles) {
+                out += html.mid(i, end - i);
+                i = end;
+                continue;
+            }
+            const QString css = cleanStyleSheet(html.mid(stop, end - stop));
+            if (css.isEmpty()) {
+                // Nothing left: drop the element, closing tag included
+                const qsizetype endGt = end < n ? html.indexOf(u'>', end) : -1;
+                i = endGt < 0 ? n : endGt + 1;
+                continue;
+            }
+            out += html.mid(i, stop - i);
+            out += u'\n';
+            out += css;
+            i = end;
+            continue;
+        }
+
+        // Rebuild the start tag from the attributes worth keeping
+        QString tag = u'<' + name.toString();
+        int kept = 0;
+        qsizetype a = nameEnd;
+        const bool selfClosing = html[gt - 1] == u'/';
+        const qsizetype attrsEnd = selfClosing ? gt - 1 : gt;
+        while (a < attrsEnd) {
+            while (a < attrsEnd && (isSpace(html[a]) || html[a] == u'/')) ++a;
+            const qsizetype attrStart = a;
+            while (a < attrsEnd && !isSpace(html[a]) && html[a] != u'=' && html[a] != u'/') ++a;
+            const QStringView attr = html.mid(attrStart, a - attrStart);
+            qsizetype valStart = -1, valEnd = -1;
+            qsizetype probe = a;
+            while (probe < attrsEnd && isSpace(html[probe])) ++probe;
+            if (probe < attrsEnd && html[probe] == u'=') {
+                a = probe + 1;
+                while (a < attrsEnd && isSpace(html[a])) ++a;
+                if (a < attrsEnd && (html[a] == u'"' || html[a] == u'\'')) {
+                    const QChar quote = html[a];
+                    valStart = a + 1;
+                    valEnd = html.indexOf(quote, valStart);
+                    if (valEnd < 0 || valEnd > attrsEnd) valEnd = attrsEnd;
+                    a = qMin(valEnd + 1, attrsEnd);
+                } else {
+                    valStart = a;
+                    while (a < attrsEnd && !isSpace(html[a])) ++a;
+                    valEnd = a;
+                }
+            }
+            if (attr.isEmpty()) {
+                if (a == attrStart) ++a;
+                continue;
+            }
+
+            if (opt.officeMarkup && (attr.contains(u':') || is(attr, u"xmlns"))) continue;
+            if (opt.lang && is(attr, u"lang")) continue;
+            if (opt.msoStyles && is(attr, u"style") && valStart >= 0) {
+                const QString style = cleanStyle(html.mid(valStart, valEnd - valStart));
+                if (style.isEmpty()) continue;
+                const QChar quote = style.contains(u'"') ? u'\'' : u'"';
+                tag += u" style=";
+                tag += quote;
+                tag += style;
+                tag += quote;
+                ++kept;
+                continue;
+            }
+            tag += u' ';
+            if (valStart < 0) {
+                tag += attr;
+            } else {
+                const qsizetype rawEnd = valEnd < attrsEnd && (html[valEnd] == u'"' || html[valEnd] == u'\'')
+                                       ? valEnd + 1 : valEnd;
+                tag += attr;
+                tag += u'=';
+                tag += html.mid(probe + 1, rawEnd - probe - 1).trimmed();
+            }
+            ++kept;
+        }
+        tag += selfClosing ? QStringView(u"/>") : QStringView(u">");
+
+        if (is(name, u"span")) {
+            const bool drop = opt.emptySpans && kept == 0 && !selfClosing;
+            spans << drop;
+            if (drop) {
+                i = stop;
+                continue;
+            }
+        }
+        out += tag;
+        i = stop;
+    }
+    return out;
+}
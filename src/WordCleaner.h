@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QString>
+#include <QStringView>
+
+// Single-pass cleanup of clipboard HTML from Word. Keeps the markup that
+// changes how the document renders and drops what only Word reads:
+// conditional comments and their VML, o:p and other namespaced elements,
+// xmlns and prefixed attributes, mso-* style declarations, @font-face,
+// @page and @list rules, and spans left with no attributes. Text is copied
+// unchanged.
+class WordCleaner {
+public:
+    struct Options {
+        bool officeMarkup = true;  // conditional comments, namespaced tags and attributes, <xml>, <meta>, <link>
+        bool comments = true;      // all other comments
+        bool msoStyles = true;     // Word-only CSS in style attributes and <style> blocks
+        bool lang = true;          // lang attributes
+        bool emptySpans = true;    // <span> tags without attributes
+    };
+
+    // Options from the [clean] section of config.ini.
+    static Options configured();
+
+    static QString clean(QStringView html);
+    static QString clean(QStringView html, const Options &opt);
+
+    // Declarations of a style attribute without the Word-only ones.
+    static QString cleanStyle(QStringView declarations);
+    // A <style> block without Word-only rules and declarations.
+    static QString cleanStyleSheet(QStringView css);
+};
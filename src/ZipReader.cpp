@@ -0,0 +1,130 @@
+#include "ZipReader.h"
+#include "Inflate.h"
+
+#include <QtEndian>
+#include <array>
+
+static constexpr quint32 EndOfDirectorySignature = 0x06054b50;
+static constexpr quint32 DirectorySignature = 0x02014b50;
+static constexpr quint32 LocalHeaderSignature = 0x04034b50;
+
+static quint16 le16(const uchar *p) { return qFromLittleEndian<quint16>(p); }
+static quint32 le32(const uchar *p) { return qFromLittleEndian<quint32>(p); }
+
+ZipReader::ZipReader(const QString &path) : _file(path) {}
+
+bool ZipReader::open() {
+    if (!_file.open(QIODevice::ReadOnly)) {
+        _error = _file.errorString();
+        return false;
+    }
+    _size = _file.size();
+    _data = _file.map(0, _size);
+    if (!_data) {
+        _buffer = _file.readAll();
+        _data = reinterpret_cast<const uchar *>(_buffer.constData());
+    }
+
+    // The end-of-directory record is last, followed by a comment of at most 64 KiB
+    qint64 eocd = -1;
+    for (qint64 at = _size - 22; at >= 0 && at >= _size - 22 - 0xffff; --at) {
+        if (le32(_data + at) == EndOfDirectorySignature) {
+            eocd = at;
+            break;
+        }
+    }
+    if (eocd < 0) {
+        _error = QStringLiteral("not a ZIP archive");
+        return false;
+    }
+    const int count = le16(_data + eocd + 10);
+    const qint64 dirSize = le32(_data + eocd + 12);
+    qint64 at = le32(_data + eocd + 16);
+    if (count == 0xffff || at == 0xffffffff || at + dirSize > eocd) {
+        _error = QStringLiteral("ZIP64 archives are not supported");
+        return false;
+    }
+
+    _entries.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        if (at + 46 > eocd || le32(_data + at) != DirectorySignature) {
+            _error = QStringLiteral("corrupt ZIP directory");
+            return false;
+        }
+        const uchar *h = _data + at;
+        const int nameLength = le16(h + 28);
+        const int extraLength = le16(h + 30);
+        const int commentLength = le16(h + 32);
+        if (at + 46 + nameLength > eocd) {
+            _error = QStringLiteral("corrupt ZIP directory");
+            return false;
+        }
+        Entry e;
+        e.method = le16(h + 10);
+        e.crc = le32(h + 16);
+        e.compressedSize = le32(h + 20);
+        e.size = le32(h + 24);
+        e.headerOffset = le32(h + 42);
+        const char *name = reinterpret_cast<const char *>(h + 46);
+        // OOXML part names are ASCII, so UTF-8 covers them whatever the flags say
+        _entries.insert(QString::fromUtf8(name, nameLength), e);
+        at += 46 + nameLength + extraLength + commentLength;
+    }
+    return true;
+}
+
+qint64 ZipReader::size(const QString &name) const {
+    const auto it = _entries.constFind(name);
+    return it == _entries.constEnd() ? -1 : it->size;
+}
+
+QByteArray ZipReader::read(const QString &name, QString *error) const {
+    auto fail = [&](const QString &why) {
+        if (error) *error = QStringLiteral("%1: %2").arg(name, why);
+        return QByteArray();
+    };
+    const auto it = _entries.constFind(name);
+    if (it == _entries.constEnd()) return fail(QStringLiteral("not in the archive"));
+    const Entry &e = *it;
+    // The local header repeats the name and may carry a different extra field
+    if (e.headerOffset + 30 > _size || le32(_data + e.headerOffset) != LocalHeaderSignature)
+        return fail(QStringLiteral("corrupt local header"));
+    const qint64 start = e.headerOffset + 30 + le16(_data + e.headerOffset + 26)
+                       + le16(_data + e.headerOffset + 28);
+    if (start + e.compressedSize > _size) return fail(QStringLiteral("truncated"));
+    const QByteArrayView raw(reinterpret_cast<const char *>(_data + start), e.compressedSize);
+
+    QByteArray bytes;
+    if (e.method == 0) {
+        bytes = raw.toByteArray();
+    } else if (e.method == 8) {
+        // The sizes are untrusted: the entry may not inflate past the size it
+        // declares, and the hint is capped by the compressed size
+        if (!Inflate::inflate(raw, bytes, e.size, e.size))
+            return fail(QStringLiteral("corrupt data or larger than declared"));
+    } else {
+        return fail(QStringLiteral("compression method %1 is not supported").arg(e.method));
+    }
+    if (bytes.size() != e.size || crc32(bytes) != e.crc)
+        return fail(QStringLiteral("checksum mismatch"));
+    // Empty but not null, so an empty entry still reads as a success
+    if (bytes.isNull()) bytes = QByteArray("");
+    return bytes;
+}
+
+static constexpr std::array<quint32, 256> makeCrcTable() {
+    std::array<quint32, 256> t{};
+    for (quint32 i = 0; i < 256; ++i) {
+        quint32 c = i;
+        for (int k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        t[i] = c;
+    }
+    return t;
+}
+static constexpr std::array<quint32, 256> CrcTable = makeCrcTable();
+
+quint32 ZipReader::crc32(QByteArrayView data, quint32 crc) {
+    crc = ~crc;
+    for (char c : data) crc = CrcTable[(crc ^ uchar(c)) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
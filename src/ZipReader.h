@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+// Read-only access to the entries of a ZIP archive, such as a .docx. The
+// file is memory-mapped (read whole if it cannot be), so entries can be
+// read from several threads at once and nothing is extracted to disk.
+// Stored and deflated entries are supported; ZIP64 and encryption are not.
+class ZipReader {
+public:
+    explicit ZipReader(const QString &path);
+
+    // Reads the central directory; false with errorString() set on failure.
+    bool open();
+    QString errorString() const { return _error; }
+
+    QStringList entries() const { return _entries.keys(); }
+    bool contains(const QString &name) const { return _entries.contains(name); }
+    // Size of the entry once decompressed, -1 if there is none.
+    qint64 size(const QString &name) const;
+
+    // Decompressed and checked against its CRC-32; null on failure, with
+    // the reason in error if given. Safe to call from several threads.
+    QByteArray read(const QString &name, QString *error = nullptr) const;
+
+    static quint32 crc32(QByteArrayView data, quint32 crc = 0);
+
+private:
+    struct Entry {
+        qint64  headerOffset = 0;
+        qint64  compressedSize = 0;
+        qint64  size = 0;
+        quint32 crc = 0;
+        quint16 method = 0;
+    };
+
+    QFile               _file;
+    const uchar        *_data = nullptr;
+    qint64              _size = 0;
+    QByteArray          _buffer;  // when the file could not be mapped
+    QHash<QString, Entry> _entries;
+    QString             _error;
+};
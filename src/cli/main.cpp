@@ -0,0 +1,353 @@
+// convertrt-cli: batch conversion of exported HTML without the GUI.
+//
+//   convertrt-cli [-f inline|masked|rtf] [-o dir] [-j n] [--no-clean] [--optimize] [--upload]
+//                 [--rehost] [--trace file] <path>...
+//
+// Directories are searched recursively for .htm/.html and .docx files; a
+// .docx is read directly, its images taken from the package. Documents are
+// converted in parallel; with --upload they are converted and uploaded one
+// at a time, each with its images in parallel. --rehost also copies images
+// linked from other hosts to OSS, at the same time as the uploads.
+
+#include "Config.h"
+#include "Converter.h"
+#include "DocxReader.h"
+#include "ImageStore.h"
+#include "RemoteRehoster.h"
+#include "RtfWriter.h"
+#include "StsCache.h"
+#include "Trace.h"
+#include "UploadCache.h"
+#include "UploadJournal.h"
+#include "UploadQueue.h"
+#include "WordCleaner.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QStringDecoder>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtNetwork/QNetworkAccessManager>
+#include <atomic>
+#include <cstdio>
+
+struct Job {
+    QString input;
+    QString output;
+};
+
+struct Result {
+    qint64  inBytes = 0;
+    qint64  outBytes = 0;
+    int     images = 0;
+    ImageOptimizer::Report optimized;
+    QString error;
+};
+
+// Set once from the command line before any document is converted
+static bool Clean = true;
+static WordCleaner::Options CleanOptions;
+static bool Optimize = false;
+static ImageOptimizer::Options OptimizeOptions;
+
+static const QStringList Formats = { "inline", "masked", "rtf" };
+
+static QString outputPath(const QString &input, const QString &root, const QString &outDir,
+                          const QString &format) {
+    QFileInfo fi(input);
+    const QString name = format == "rtf" ? fi.completeBaseName() + ".rtf"
+                                         : fi.completeBaseName() + "." + format + ".html";
+    if (outDir.isEmpty())
+        return fi.dir().filePath(name);
+    const QString rel = QDir(root).relativeFilePath(fi.absolutePath());
+    return QDir(outDir).filePath(QDir::cleanPath(rel + "/" + name));
+}
+
+static QList<Job> collectJobs(const QStringList &paths, const QString &outDir, const QString &format) {
+    QList<Job> jobs;
+    for (const QString &path : paths) {
+        QFileInfo fi(path);
+        if (fi.isDir()) {
+            QDirIterator it(fi.absoluteFilePath(), { "*.htm", "*.html", "*.docx" }, QDir::Files,
+                            QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                const QString file = it.next();
+                // Skip our own output from an earlier run, and Word's lock files
+                const QString base = QFileInfo(file).completeBaseName();
+                bool generated = base.startsWith("~$");
+                for (const QString &f : Formats)
+                    generated = generated || base.endsWith("." + f);
+                if (generated) continue;
+                jobs << Job{ file, outputPath(file, fi.absoluteFilePath(), outDir, format) };
+            }
+        } else {
+            jobs << Job{ fi.absoluteFilePath(),
+                         outputPath(fi.absoluteFilePath(), fi.absolutePath(), outDir, format) };
+        }
+    }
+    return jobs;
+}
+
+static QString readHtml(const QString &path, ImageStore &store, qint64 &size, QString &error) {
+    if (path.endsWith(".docx", Qt::CaseInsensitive)) {
+        size = QFileInfo(path).size();
+        DocxReader::Result docx = DocxReader::read(path, store);
+        error = docx.error;
+        return docx.html;
+    }
+    QFile in(path);
+    if (!in.open(QIODevice::ReadOnly)) {
+        error = in.errorString();
+        return {};
+    }
+    const QByteArray bytes = in.readAll();
+    size = bytes.size();
+    QStringDecoder decoder(QStringConverter::encodingForHtml(bytes).value_or(QStringConverter::Utf8));
+    const QString html = decoder(bytes);
+    if (!Clean) return html;
+    const Trace::Scope trace("clean");
+    return WordCleaner::clean(html, CleanOptions);
+}
+
+// Sets error and returns false unless the whole document reached the file.
+static bool writeOutput(const QString &path, const Converter::Document &doc, const ImageStore &store,
+                        const QString &format, qint64 &size, QString &error) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile out(path);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        error = out.errorString();
+        return false;
+    }
+    bool ok;
+    if (format == "rtf") {
+        // Written to the file as it is produced, images straight from the store
+        const Trace::Scope trace("rtf");
+        ok = RtfWriter(&out, &store).write(doc.html);
+    } else {
+        const QByteArray bytes = (format == "masked" ? doc.masked : store.toDataUris(doc.html)).toUtf8();
+        ok = out.write(bytes) == bytes.size();
+    }
+    // A full disk may only show when the buffer is flushed
+    ok = ok && out.flush();
+    size = out.size();
+    if (!ok) {
+        error = out.error() != QFileDevice::NoError ? out.errorString() : QString("Write failed");
+        return false;
+    }
+    return true;
+}
+
+static Result convert(const Job &job, const QString &format) {
+    const Trace::Scope trace("document");
+    Result r;
+    ImageStore store;
+    const QString html = readHtml(job.input, store, r.inBytes, r.error);
+    if (!r.error.isEmpty()) return r;
+
+    Converter::Document doc = Converter::inlineAndMask(html, store, QFileInfo(job.input).absolutePath());
+    r.images = doc.images;
+    if (Optimize)
+        r.optimized = Converter::optimizeImages(doc, store, OptimizeOptions);
+    if (!writeOutput(job.output, doc, store, format, r.outBytes, r.error))
+        QFile::remove(job.output);
+    return r;
+}
+
+static Result convertAndUpload(const Job &job, const QString &format, UploadQueue &uploads,
+                               RemoteRehoster *rehost) {
+    const Trace::Scope trace("document");
+    Result r;
+    ImageStore store;
+    const QString html = readHtml(job.input, store, r.inBytes, r.error);
+    if (!r.error.isEmpty()) return r;
+
+    Converter::Document doc = Converter::inlineAndMask(html, store, QFileInfo(job.input).absolutePath());
+    r.images = doc.images;
+    if (Optimize)
+        r.optimized = Converter::optimizeImages(doc, store, OptimizeOptions);
+
+    const QStringList handles = Converter::imageHandles(doc.html);
+    const QStringList remote = rehost ? RemoteRehoster::remoteSources(doc.html) : QStringList();
+    if (!handles.isEmpty() || !remote.isEmpty()) {
+        // Uploads and copies run at once; the loop ends with the later one
+        QEventLoop loop;
+        int running = 0;
+        auto batchFinished = [&loop, &running]() {
+            if (--running == 0) loop.quit();
+        };
+        if (!handles.isEmpty()) {
+            ++running;
+            QObject::connect(&uploads, &UploadQueue::finished, &loop, batchFinished);
+            uploads.start(handles, store);
+        }
+        if (!remote.isEmpty()) {
+            ++running;
+            QObject::connect(rehost, &RemoteRehoster::finished, &loop, batchFinished);
+            rehost->start(remote);
+        }
+        loop.exec();
+        if (!handles.isEmpty()) {
+            doc.html = Converter::replaceHandles(doc.html, uploads.urls());
+            const int failed = uploads.urls().count(QString());
+            if (failed)
+                std::fprintf(stderr, "  %d of %d images failed to upload\n", failed, int(handles.size()));
+        }
+        if (!remote.isEmpty()) {
+            doc.html = rehost->rewrite(doc.html);
+            const int failed = rehost->urls().count(QString());
+            if (failed)
+                std::fprintf(stderr, "  %d of %d remote images failed to copy\n", failed, int(remote.size()));
+        }
+        doc.masked = Converter::inlineAndMask(doc.html, store).masked;
+    }
+    if (!writeOutput(job.output, doc, store, format, r.outBytes, r.error))
+        QFile::remove(job.output);
+    return r;
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("convertrt-cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Convert exported Word HTML or .docx files into inlined or masked HTML, or RTF.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("paths", "HTML or .docx files, or directories, to convert.", "<path>...");
+    QCommandLineOption formatOpt({ "f", "format" }, "Output format: inline (default), masked or rtf.",
+                                 "format", "inline");
+    QCommandLineOption outOpt({ "o", "output" }, "Output directory (default: next to each input).",
+                              "dir");
+    QCommandLineOption jobsOpt({ "j", "jobs" }, "Documents converted in parallel (default: all cores).",
+                               "n", QString::number(QThread::idealThreadCount()));
+    QCommandLineOption uploadOpt("upload", "Upload images to OSS and link them by URL.");
+    QCommandLineOption rehostOpt("rehost", "With --upload: also copy images linked from other hosts to OSS.");
+    QCommandLineOption noCleanOpt("no-clean", "Keep Word-only markup (conditional comments, mso-* styles, ...).");
+    QCommandLineOption optimizeOpt("optimize", "Downscale images to their displayed size and re-encode them.");
+    QCommandLineOption imageFormatOpt("image-format", "With --optimize: keep, jpeg or png.", "format");
+    QCommandLineOption qualityOpt("quality", "With --optimize: JPEG quality, 1-100.", "n");
+    QCommandLineOption traceOpt("trace", "Write stage timings as Chrome trace JSON to this file "
+                                "and print a summary.", "file");
+    parser.addOptions({ formatOpt, outOpt, jobsOpt, uploadOpt, rehostOpt, noCleanOpt, optimizeOpt,
+                        imageFormatOpt, qualityOpt, traceOpt });
+    parser.process(app);
+
+    const QString format = parser.value(formatOpt);
+    if (!Formats.contains(format)) {
+        std::fprintf(stderr, "Unknown format: %s\n", qPrintable(format));
+        return 2;
+    }
+    if (parser.positionalArguments().isEmpty())
+        parser.showHelp(2);
+
+    Clean = !parser.isSet(noCleanOpt) && Config::cleanWordHtml();
+    CleanOptions = WordCleaner::configured();
+    Optimize = parser.isSet(optimizeOpt) || Config::optimizeImages();
+    OptimizeOptions = ImageOptimizer::configured();
+    if (parser.isSet(imageFormatOpt)) {
+        const QString f = parser.value(imageFormatOpt).toLower();
+        if (f != "keep" && f != "jpeg" && f != "png") {
+            std::fprintf(stderr, "Unknown image format: %s\n", qPrintable(f));
+            return 2;
+        }
+        OptimizeOptions.format = f == "jpeg" ? ImageOptimizer::Format::Jpeg
+                               : f == "png"  ? ImageOptimizer::Format::Png
+                                             : ImageOptimizer::Format::Keep;
+    }
+    if (parser.isSet(qualityOpt))
+        OptimizeOptions.quality = qBound(1, parser.value(qualityOpt).toInt(), 100);
+
+    const QString outDir = parser.isSet(outOpt) ? QDir(parser.value(outOpt)).absolutePath() : QString();
+    const QList<Job> jobs = collectJobs(parser.positionalArguments(), outDir, format);
+    if (jobs.isEmpty()) {
+        std::fprintf(stderr, "No HTML or .docx files found.\n");
+        return 1;
+    }
+
+    QMutex printLock;
+    std::atomic<int> done{ 0 };
+    auto report = [&](const Job &job, const Result &r) {
+        QMutexLocker locker(&printLock);
+        const int n = ++done;
+        if (r.error.isEmpty() && Optimize)
+            std::fprintf(stderr, "[%d/%d] %s (%d images, %d optimized, %lld KiB saved)\n", n,
+                         int(jobs.size()), qPrintable(job.input), r.images, r.optimized.optimized,
+                         r.optimized.saved() / 1024);
+        else if (r.error.isEmpty())
+            std::fprintf(stderr, "[%d/%d] %s (%d images)\n", n, int(jobs.size()),
+                         qPrintable(job.input), r.images);
+        else
+            std::fprintf(stderr, "[%d/%d] %s: %s\n", n, int(jobs.size()),
+                         qPrintable(job.input), qPrintable(r.error));
+    };
+
+    if (parser.isSet(traceOpt))
+        Trace::start(QFileInfo(parser.value(traceOpt)).absoluteFilePath());
+    else if (Config::traceEnabled())
+        Trace::start(Config::traceFile());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<Result> results;
+    if (parser.isSet(uploadOpt)) {
+        QNetworkAccessManager network;
+        StsCache sts(&network);
+        UploadCache cache;
+        UploadJournal journal;
+        UploadQueue uploads(&network, &sts);
+        RemoteRehoster rehost(&network, &sts);
+        if (Config::uploadCacheEnabled())
+            uploads.setCache(&cache);
+        if (Config::uploadJournalEnabled())
+            uploads.setJournal(&journal);
+        auto reportRetry = [](int index, int attempt, int delayMs, const QString &error) {
+            std::fprintf(stderr, "  image %d: %s; retry %d in %d ms\n", index + 1,
+                         qPrintable(error), attempt, delayMs);
+        };
+        QObject::connect(&uploads, &UploadQueue::imageRetrying, reportRetry);
+        QObject::connect(&rehost, &RemoteRehoster::imageRetrying, reportRetry);
+        const bool rehostRemote = parser.isSet(rehostOpt) || Config::rehostRemoteImages();
+        for (const Job &job : jobs) {
+            results << convertAndUpload(job, format, uploads, rehostRemote ? &rehost : nullptr);
+            report(job, results.last());
+        }
+    } else {
+        QThreadPool pool;
+        pool.setMaxThreadCount(qMax(1, parser.value(jobsOpt).toInt()));
+        results = QtConcurrent::blockingMapped<QList<Result>>(&pool, jobs, [&](const Job &job) {
+            Result r = convert(job, format);
+            report(job, r);
+            return r;
+        });
+    }
+
+    const double secs = qMax<qint64>(1, timer.elapsed()) / 1000.0;
+    Trace::finish();
+    int failed = 0, images = 0;
+    qint64 inBytes = 0, outBytes = 0, saved = 0;
+    for (const Result &r : results) {
+        if (!r.error.isEmpty()) ++failed;
+        images += r.images;
+        saved += r.optimized.saved();
+        inBytes += r.inBytes;
+        outBytes += r.outBytes;
+    }
+    const double inMiB = inBytes / (1024.0 * 1024.0);
+    const double outMiB = outBytes / (1024.0 * 1024.0);
+    std::printf("%d documents (%d failed), %d images in %.2f s\n",
+                int(results.size()), failed, images, secs);
+    std::printf("read %.1f MiB, wrote %.1f MiB\n", inMiB, outMiB);
+    if (Optimize)
+        std::printf("image optimization saved %.1f MiB\n", saved / (1024.0 * 1024.0));
+    std::printf("%.1f documents/s, %.1f images/s, %.1f MiB/s in, %.1f MiB/s out\n",
+                results.size() / secs, images / secs, inMiB / secs, outMiB / secs);
+    return failed ? 1 : 0;
+}
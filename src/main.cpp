@@ -1,10 +1,52 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include "Config.h"
+#include "ConvertServer.h"
 #include "MainWindow.h"
+#include "Trace.h"
+#include <cstdio>
+
+// convertrt --serve [--port n] [--workers n]: the conversion service on
+// localhost instead of the window.
+static int serve(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Serve conversions to local tools over HTTP.");
+    parser.addHelpOption();
+    QCommandLineOption serveOpt("serve", "Run the conversion service instead of the window.");
+    QCommandLineOption portOpt("port", "Port on 127.0.0.1 (default: server/port in config.ini).", "n");
+    QCommandLineOption workersOpt("workers", "Documents converted at once (default: server/workers).", "n");
+    parser.addOptions({ serveOpt, portOpt, workersOpt });
+    parser.process(app);
+
+    ConvertServer server;
+    if (parser.isSet(workersOpt))
+        server.setWorkers(parser.value(workersOpt).toInt());
+    const quint16 port = parser.isSet(portOpt) ? quint16(parser.value(portOpt).toUInt()) : Config::serverPort();
+    if (!server.start(port)) {
+        std::fprintf(stderr, "Cannot listen on 127.0.0.1:%u: %s\n", unsigned(port),
+                     qPrintable(server.errorString()));
+        return 1;
+    }
+    std::fprintf(stderr, "Serving on http://127.0.0.1:%u (%d workers, %d queued at most)\n",
+                 unsigned(server.serverPort()), server.workers(), server.queueLimit());
+    return app.exec();
+}
 
 int main(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--serve") == 0)
+            return serve(argc, argv);
+    }
+
     QApplication app(argc, argv);
+    if (Config::traceEnabled())
+        Trace::start(Config::traceFile());
     MainWindow w;
     w.resize(1000, 700);
     w.show();
-    return app.exec();
-}
\ No newline at end of file
+    const int status = app.exec();
+    Trace::finish();
+    return status;
+}